@@ -0,0 +1,137 @@
+#include "AssetManager.h"
+#include <iostream>
+#include <iomanip>
+
+namespace dae
+{
+	AssetManager& AssetManager::GetInstance()
+	{
+		static AssetManager instance{};
+		return instance;
+	}
+
+	std::shared_ptr<Texture> AssetManager::GetTexture(const std::string& path, TextureFormat format)
+	{
+		return GetTextureAsync(path, format).get();
+	}
+
+	std::shared_future<std::shared_ptr<Texture>> AssetManager::GetTextureAsync(const std::string& path, TextureFormat format)
+	{
+		const std::string key{ path + '|' + std::to_string(int(format)) };
+
+		std::lock_guard lock{ m_Mutex };
+		TextureEntry& entry{ m_Textures[key] };
+		if (std::shared_ptr<Texture> pTexture{ entry.pTexture.lock() })
+		{
+			std::promise<std::shared_ptr<Texture>> loaded{};
+			loaded.set_value(pTexture);
+			return loaded.get_future().share();
+		}
+		if (entry.pendingTexture.valid())
+			return entry.pendingTexture;
+
+		//The job registers its result under the lock, which is held until the pending future is stored
+		entry.path           = path;
+		entry.format         = format;
+		const bool streamed{ m_pTextureStreamer != nullptr };
+		entry.pendingTexture = m_ThreadPool.Submit([this, key, path, format, streamed]()
+			{
+				std::shared_ptr<Texture> pTexture{ streamed ? Texture::LoadStreamed(path, format) : Texture::LoadFromFile(path, format) };
+
+				std::lock_guard lock{ m_Mutex };
+				if (pTexture == nullptr)
+				{
+					m_Textures.erase(key);
+					return pTexture;
+				}
+
+				TextureEntry& entry{ m_Textures[key] };
+				entry.pTexture       = pTexture;
+				entry.pendingTexture = {};
+				if (pTexture->IsStreamed())
+					m_pTextureStreamer->Register(pTexture);
+				return pTexture;
+			}).share();
+		return entry.pendingTexture;
+	}
+
+	void AssetManager::EnableTextureStreaming(size_t budget)
+	{
+		std::lock_guard lock{ m_Mutex };
+		if (m_pTextureStreamer == nullptr)
+			m_pTextureStreamer = std::make_unique<TextureStreamer>(m_ThreadPool, budget);
+	}
+
+	bool AssetManager::UpdateTextureStreaming(bool frameRendered)
+	{
+		//The streamer is never replaced once created, so it can be updated without holding the cache lock
+		TextureStreamer* pTextureStreamer{};
+		{
+			std::lock_guard lock{ m_Mutex };
+			pTextureStreamer = m_pTextureStreamer.get();
+		}
+		return pTextureStreamer != nullptr && pTextureStreamer->Update(frameRendered);
+	}
+
+	void AssetManager::PrintMemoryReport()
+	{
+		const char* formatNames[]{ "RGBA8", "R8", "Normal", "BC1", "BC4", "BC5" };
+
+		std::lock_guard lock{ m_Mutex };
+		RemoveExpired();
+
+		size_t totalSize{};
+		std::cout << "Resident textures:" << std::endl;
+		for (const auto& [key, entry] : m_Textures)
+		{
+			const std::shared_ptr<Texture> pTexture{ entry.pTexture.lock() };
+			if (pTexture == nullptr)
+				continue;
+
+			totalSize += pTexture->GetMemorySize();
+			std::cout << "  " << std::left << std::setw(36) << entry.path << std::right
+				<< std::setw(7) << formatNames[int(entry.format)]
+				<< std::setw(6) << pTexture->GetWidth() << 'x' << std::setw(5) << std::left << pTexture->GetHeight() << std::right
+				<< std::setw(9) << pTexture->GetMemorySize() / 1024 << " KB"
+				<< "  owners: " << pTexture.use_count() - 1;
+			if (pTexture->IsStreamed())
+				std::cout << "  resident from mip " << pTexture->GetResidentLevel();
+			std::cout << std::endl;
+		}
+		std::cout << "  total: " << totalSize / 1024 << " KB" << std::endl;
+		if (m_pTextureStreamer != nullptr)
+		{
+			std::cout << "  streamed levels: " << m_pTextureStreamer->GetStreamedSize() / 1024 << " KB off the " << m_pTextureStreamer->GetBudget() / 1024
+				<< " KB budget, " << m_pTextureStreamer->GetPendingCount() << " loading" << std::endl;
+		}
+	}
+
+	void AssetManager::RemoveExpired()
+	{
+		std::erase_if(m_Textures, [](const auto& keyEntry) { return keyEntry.second.pTexture.expired() && !keyEntry.second.pendingTexture.valid(); });
+	}
+
+	TextureHandle::TextureHandle(const std::string& path, TextureFormat format) :
+		m_Path{ path },
+		m_Format{ format }
+	{
+	}
+
+	void TextureHandle::Prefetch()
+	{
+		if (!m_LoadRequested && !m_PendingTexture.valid())
+			m_PendingTexture = AssetManager::GetInstance().GetTextureAsync(m_Path, m_Format);
+	}
+
+	Texture* TextureHandle::Get() const
+	{
+		//A failed load is not retried on every fetch
+		if (!m_LoadRequested)
+		{
+			m_LoadRequested = true;
+			m_pTexture      = m_PendingTexture.valid() ? m_PendingTexture.get() : AssetManager::GetInstance().GetTexture(m_Path, m_Format);
+			m_PendingTexture = {};
+		}
+		return m_pTexture.get();
+	}
+}
@@ -0,0 +1,82 @@
+#pragma once
+#include <memory>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include "Texture.h"
+#include "TextureStreamer.h"
+#include "ThreadPool.h"
+
+namespace dae
+{
+	//Path keyed cache off loaded assets, every user off the same path and format shares one copy
+	//The cache only holds weak references, an asset stays resident while someone still owns it
+	class AssetManager final
+	{
+	public:
+		static AssetManager& GetInstance();
+
+		AssetManager(const AssetManager&) = delete;
+		AssetManager(AssetManager&&) noexcept = delete;
+		AssetManager& operator=(const AssetManager&) = delete;
+		AssetManager& operator=(AssetManager&&) noexcept = delete;
+
+		//Returns nullptr when the file could not be loaded
+		std::shared_ptr<Texture> GetTexture(const std::string& path, TextureFormat format = TextureFormat::RGBA8);
+		//Loads on the worker pool, requests for a texture that is already loading share its future
+		std::shared_future<std::shared_ptr<Texture>> GetTextureAsync(const std::string& path, TextureFormat format = TextureFormat::RGBA8);
+
+		//Block compressed textures loaded after this keep only their coarse mip levels resident and stream the rest
+		//budget is the memory for the streamed levels off all textures together, in bytes
+		void EnableTextureStreaming(size_t budget);
+		//Between frames, returns true when streaming changed a texture and the frame has to be drawn again
+		bool UpdateTextureStreaming(bool frameRendered);
+
+		//Workers for asset jobs, also used for loading non cached assets such as meshes
+		ThreadPool& GetThreadPool() { return m_ThreadPool; }
+
+		//Resident assets with their size and owner count
+		void PrintMemoryReport();
+
+	private:
+		struct TextureEntry
+		{
+			std::string path{};
+			TextureFormat format{};
+			std::weak_ptr<Texture> pTexture{};
+			std::shared_future<std::shared_ptr<Texture>> pendingTexture{}; //only valid while loading
+		};
+
+		AssetManager() = default;
+		~AssetManager() = default;
+
+		void RemoveExpired();
+
+		std::mutex m_Mutex{};
+		std::unordered_map<std::string, TextureEntry> m_Textures{};
+		std::unique_ptr<TextureStreamer> m_pTextureStreamer{};
+		//Last member, so the workers are joined before the cache they write to is destroyed
+		ThreadPool m_ThreadPool{};
+	};
+
+	//Texture that is requested from the AssetManager the first time it is used
+	class TextureHandle final
+	{
+	public:
+		TextureHandle() = default;
+		TextureHandle(const std::string& path, TextureFormat format = TextureFormat::RGBA8);
+
+		//Starts loading in the background, Get waits for it
+		void Prefetch();
+		Texture* Get() const;
+		Texture* operator->() const { return Get(); }
+		bool IsLoaded() const { return m_pTexture != nullptr; }
+
+	private:
+		std::string m_Path{};
+		TextureFormat m_Format{};
+		mutable bool m_LoadRequested{ false };
+		mutable std::shared_ptr<Texture> m_pTexture{};
+		mutable std::shared_future<std::shared_ptr<Texture>> m_PendingTexture{};
+	};
+}
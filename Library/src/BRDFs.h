@@ -2,6 +2,7 @@
 #include <cassert>
 #include <iostream>
 #include "Maths.h"
+#include "PhongLut.h"
 
 namespace dae
 {
@@ -19,9 +20,7 @@ namespace dae
 
 		static ColorRGB Lambert(const ColorRGB& kd, const ColorRGB& cd)
 		{
-			//todo: W3
-
-			return {};
+			return { (kd * cd) / dae::PI };
 		}
 
 		/**
@@ -51,6 +50,40 @@ namespace dae
 			return value;
 		}
 
+		/**
+		 * \brief Phong with the power from a lookup table, differs from Phong by at most the measured error off lut times ks
+		 * \param ks Specular Reflection Coefficient
+		 * \param exp Phong Exponent, up to the maximum exponent off lut
+		 * \param l Incoming (incident) Light Direction
+		 * \param v View Direction
+		 * \param n Normal of the Surface
+		 * \param lut Table for pow(cosAlpha, exp)
+		 * \return Phong Specular Color
+		 */
+		static ColorRGB Phong(const ColorRGB& ks, float exp, const Vector3& l, const Vector3& v, const Vector3& n, const PhongLut& lut)
+		{
+			//Dividing the dot by the length saves normalizing the whole reflection
+			const Vector3 reflect{ Vector3::Reflect(l, n) };
+			const float cosAlp{ Vector3::Dot(reflect, v) / reflect.Magnitude() };
+			return ks * lut.Evaluate(cosAlp, exp);
+		}
+
+		/**
+		 * \brief Blinn-Phong, the half vector replaces the reflection, needs about 4 times the Phong exponent for the same highlight size
+		 * \param ks Specular Reflection Coefficient
+		 * \param exp Blinn-Phong Exponent, up to the maximum exponent off lut
+		 * \param l Incoming (incident) Light Direction
+		 * \param v View Direction
+		 * \param n Normal of the Surface
+		 * \param lut Table for pow(cosAlpha, exp)
+		 * \return Blinn-Phong Specular Color
+		 */
+		static ColorRGB BlinnPhong(const ColorRGB& ks, float exp, const Vector3& l, const Vector3& v, const Vector3& n, const PhongLut& lut)
+		{
+			const Vector3 halfVector{ v - l };
+			return ks * lut.Evaluate(Vector3::Dot(n, halfVector) / halfVector.Magnitude(), exp);
+		}
+
 		/**
 		 * \brief BRDF Fresnel Function >> Schlick
 		 * \param h Normalized Halfvector between View and Light directions
@@ -84,10 +117,10 @@ namespace dae
 
 
 		/**
-		 * \brief BRDF Geometry Function >> Schlick GGX (Direct Lighting + UE4 implementation - squared(roughness))
+		 * \brief BRDF Geometry Function >> Schlick GGX (Direct Lighting + UE4 implementation - k = (roughness + 1)^2 / 8)
 		 * \param n Normal of the surface
 		 * \param v Normalized view direction
-		 * \param roughness Roughness of the material
+		 * \param roughness Perceptual roughness of the material, not squared
 		 * \return BRDF Geometry Term using SchlickGGX
 		 */
 		static const float GeometryFunction_SchlickGGX(const Vector3& n, const Vector3& v, float roughness)
@@ -102,7 +135,7 @@ namespace dae
 		 * \param n Normal of the surface
 		 * \param v Normalized view direction
 		 * \param l Normalized light direction
-		 * \param roughness Roughness of the material
+		 * \param roughness Perceptual roughness of the material, not squared
 		 * \return BRDF Geometry Term using Smith (> SchlickGGX(n,v,roughness) * SchlickGGX(n,l,roughness))
 		 */
 		static float GeometryFunction_Smith(const Vector3& n, const Vector3& v, const Vector3& l, float roughness)
@@ -112,5 +145,32 @@ namespace dae
 			return { (dotNL / (dotNL * (1.f - kDirect) + kDirect)) * GeometryFunction_SchlickGGX(n, v, roughness)};
 		}
 
+		/**
+		 * \brief Cook-Torrance, Lambert diffuse off what the Fresnel term does not reflect plus the GGX specular lobe
+		 * \param albedo Base color, the diffuse color for dielectrics and f0 for metals
+		 * \param metalness 0 for dielectrics (f0 0.04), 1 for metals
+		 * \param roughness Perceptual roughness, squared for the distribution term, the geometry term takes it as is
+		 * \param l Normalized direction towards the light
+		 * \param v Normalized direction towards the viewer
+		 * \param n Normal of the Surface
+		 * \return BRDF, still to be multiplied by the radiance and n.l
+		 */
+		static ColorRGB CookTorrance(const ColorRGB& albedo, float metalness, float roughness, const Vector3& l, const Vector3& v, const Vector3& n)
+		{
+			const float alpha{ std::max(roughness * roughness, 0.001f) };
+			const Vector3 h{ (v + l).Normalized() };
+			const ColorRGB dielectricF0{ 0.04f, 0.04f, 0.04f };
+			const ColorRGB f0{ dielectricF0 + (albedo - dielectricF0) * metalness };
+
+			const ColorRGB fresnel{ FresnelFunction_Schlick(h, v, f0) };
+			const float distribution{ NormalDistribution_GGX(n, h, alpha) };
+			const float geometry{ GeometryFunction_Smith(n, v, l, roughness) };
+			const float denominator{ 4.f * std::max(Vector3::Dot(n, v), 0.0001f) * std::max(Vector3::Dot(n, l), 0.0001f) };
+
+			const ColorRGB one{ 1.f, 1.f, 1.f };
+			const ColorRGB kd{ (one - fresnel) * (1.f - metalness) };
+			return Lambert(kd, albedo) + fresnel * (distribution * geometry / denominator);
+		}
+
 	}
 }
\ No newline at end of file
@@ -0,0 +1,227 @@
+#include "BlockCompression.h"
+#include <algorithm>
+#include <cfloat>
+#include <cmath>
+
+namespace dae
+{
+	namespace BlockCompression
+	{
+		namespace
+		{
+			struct Color
+			{
+				float r{};
+				float g{};
+				float b{};
+			};
+
+			Color ToColor(uint32_t texel)
+			{
+				return Color{ float(texel & 0xFF), float((texel >> 8) & 0xFF), float((texel >> 16) & 0xFF) };
+			}
+
+			uint16_t To565(const Color& color)
+			{
+				const uint32_t r{ uint32_t(std::clamp(std::lround(color.r * 31.0f / 255.0f), 0l, 31l)) };
+				const uint32_t g{ uint32_t(std::clamp(std::lround(color.g * 63.0f / 255.0f), 0l, 63l)) };
+				const uint32_t b{ uint32_t(std::clamp(std::lround(color.b * 31.0f / 255.0f), 0l, 31l)) };
+				return uint16_t((r << 11) | (g << 5) | b);
+			}
+
+			//Expanded to 8 bits by replicating the high bits
+			uint32_t From565(uint32_t color)
+			{
+				const uint32_t r{ (color >> 11) & 31 };
+				const uint32_t g{ (color >> 5) & 63 };
+				const uint32_t b{ color & 31 };
+				return ((r << 3) | (r >> 2)) | (((g << 2) | (g >> 4)) << 8) | (((b << 3) | (b >> 2)) << 16) | 0xFF000000;
+			}
+
+			uint32_t MixColors(uint32_t a, uint32_t b, uint32_t weightA, uint32_t weightB)
+			{
+				uint32_t color{ 0xFF000000 };
+				for (int shift{}; shift < 24; shift += 8)
+				{
+					const uint32_t channel{ (((a >> shift) & 0xFF) * weightA + ((b >> shift) & 0xFF) * weightB) / (weightA + weightB) };
+					color |= channel << shift;
+				}
+				return color;
+			}
+
+			void BuildBC1Palette(uint16_t color0, uint16_t color1, uint32_t palette[4])
+			{
+				palette[0] = From565(color0);
+				palette[1] = From565(color1);
+				if (color0 > color1)
+				{
+					palette[2] = MixColors(palette[0], palette[1], 2, 1);
+					palette[3] = MixColors(palette[0], palette[1], 1, 2);
+				}
+				else
+				{
+					palette[2] = MixColors(palette[0], palette[1], 1, 1);
+					palette[3] = 0; //black
+				}
+			}
+
+			void BuildBC4Palette(uint8_t value0, uint8_t value1, uint8_t palette[8])
+			{
+				palette[0] = value0;
+				palette[1] = value1;
+				if (value0 > value1)
+				{
+					for (int i{ 1 }; i < 7; ++i)
+						palette[i + 1] = uint8_t(((7 - i) * value0 + i * value1) / 7);
+				}
+				else
+				{
+					for (int i{ 1 }; i < 5; ++i)
+						palette[i + 1] = uint8_t(((5 - i) * value0 + i * value1) / 5);
+					palette[6] = 0;
+					palette[7] = 255;
+				}
+			}
+		}
+
+		uint64_t EncodeBC1(const uint32_t texels[16])
+		{
+			//Endpoints at the extremes off the block along its principal color axis
+			Color mean{};
+			for (int i{}; i < 16; ++i)
+			{
+				const Color color{ ToColor(texels[i]) };
+				mean.r += color.r / 16.0f;
+				mean.g += color.g / 16.0f;
+				mean.b += color.b / 16.0f;
+			}
+
+			float covariance[6]{};
+			for (int i{}; i < 16; ++i)
+			{
+				const Color color{ ToColor(texels[i]) };
+				const float r{ color.r - mean.r }, g{ color.g - mean.g }, b{ color.b - mean.b };
+				covariance[0] += r * r;
+				covariance[1] += r * g;
+				covariance[2] += r * b;
+				covariance[3] += g * g;
+				covariance[4] += g * b;
+				covariance[5] += b * b;
+			}
+
+			//Power iteration from the texel furthest from the mean, which never starts orthogonal to the dominant axis
+			Color axis{};
+			float maxDistance{ -1.0f };
+			for (int i{}; i < 16; ++i)
+			{
+				const Color color{ ToColor(texels[i]) };
+				const Color offset{ color.r - mean.r, color.g - mean.g, color.b - mean.b };
+				const float distance{ offset.r * offset.r + offset.g * offset.g + offset.b * offset.b };
+				if (distance > maxDistance)
+				{
+					maxDistance = distance;
+					axis        = offset;
+				}
+			}
+			for (int iteration{}; iteration < 8; ++iteration)
+			{
+				const Color next{
+					covariance[0] * axis.r + covariance[1] * axis.g + covariance[2] * axis.b,
+					covariance[1] * axis.r + covariance[3] * axis.g + covariance[4] * axis.b,
+					covariance[2] * axis.r + covariance[4] * axis.g + covariance[5] * axis.b };
+				const float length{ std::max({ std::abs(next.r), std::abs(next.g), std::abs(next.b) }) };
+				if (length <= 0.0f)
+					break;
+				axis = { next.r / length, next.g / length, next.b / length };
+			}
+
+			float minProjection{ FLT_MAX }, maxProjection{ -FLT_MAX };
+			Color minColor{}, maxColor{};
+			for (int i{}; i < 16; ++i)
+			{
+				const Color color{ ToColor(texels[i]) };
+				const float projection{ color.r * axis.r + color.g * axis.g + color.b * axis.b };
+				if (projection < minProjection) { minProjection = projection; minColor = color; }
+				if (projection > maxProjection) { maxProjection = projection; maxColor = color; }
+			}
+
+			uint16_t color0{ To565(maxColor) };
+			uint16_t color1{ To565(minColor) };
+			if (color0 < color1)
+				std::swap(color0, color1);
+
+			//Equal endpoints would select the 3 color mode, every texel then uses index 0
+			uint64_t indices{};
+			if (color0 != color1)
+			{
+				uint32_t palette[4]{};
+				BuildBC1Palette(color0, color1, palette);
+				for (int i{}; i < 16; ++i)
+				{
+					const Color color{ ToColor(texels[i]) };
+					uint64_t bestIndex{};
+					float bestDistance{ FLT_MAX };
+					for (uint64_t index{}; index < 4; ++index)
+					{
+						const Color entry{ ToColor(palette[index]) };
+						const float distance{ (color.r - entry.r) * (color.r - entry.r) + (color.g - entry.g) * (color.g - entry.g) + (color.b - entry.b) * (color.b - entry.b) };
+						if (distance < bestDistance)
+						{
+							bestDistance = distance;
+							bestIndex    = index;
+						}
+					}
+					indices |= bestIndex << (2 * i);
+				}
+			}
+
+			return uint64_t(color0) | (uint64_t(color1) << 16) | (indices << 32);
+		}
+
+		void DecodeBC1(uint64_t block, uint32_t texels[16])
+		{
+			uint32_t palette[4]{};
+			BuildBC1Palette(uint16_t(block), uint16_t(block >> 16), palette);
+			for (int i{}; i < 16; ++i)
+				texels[i] = palette[(block >> (32 + 2 * i)) & 3];
+		}
+
+		uint64_t EncodeBC4(const uint8_t values[16])
+		{
+			//Min/max endpoints in the 8 value mode
+			const auto [minValue, maxValue] { std::minmax_element(values, values + 16) };
+			const uint8_t value0{ *maxValue };
+			const uint8_t value1{ *minValue };
+
+			uint8_t palette[8]{};
+			BuildBC4Palette(value0, value1, palette);
+
+			uint64_t indices{};
+			for (int i{}; i < 16; ++i)
+			{
+				uint64_t bestIndex{};
+				int bestDistance{ 256 };
+				for (uint64_t index{}; index < 8; ++index)
+				{
+					const int distance{ std::abs(int(values[i]) - int(palette[index])) };
+					if (distance < bestDistance)
+					{
+						bestDistance = distance;
+						bestIndex    = index;
+					}
+				}
+				indices |= bestIndex << (3 * i);
+			}
+
+			return uint64_t(value0) | (uint64_t(value1) << 8) | (indices << 16);
+		}
+
+		void DecodeBC4(uint64_t block, uint8_t values[16])
+		{
+			uint8_t palette[8]{};
+			BuildBC4Palette(uint8_t(block), uint8_t(block >> 8), palette);
+			for (int i{}; i < 16; ++i)
+				values[i] = palette[(block >> (16 + 3 * i)) & 7];
+		}
+	}
+}
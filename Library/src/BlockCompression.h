@@ -0,0 +1,17 @@
+#pragma once
+#include <cstdint>
+
+namespace dae
+{
+	//4x4 texel block codecs, texels are in row order inside the block
+	namespace BlockCompression
+	{
+		//Colors are packed RGBA8 (r | g << 8 | b << 16 | a << 24), alpha is dropped
+		uint64_t EncodeBC1(const uint32_t texels[16]);
+		void DecodeBC1(uint64_t block, uint32_t texels[16]);
+
+		//Single 8 bit channel
+		uint64_t EncodeBC4(const uint8_t values[16]);
+		void DecodeBC4(uint64_t block, uint8_t values[16]);
+	}
+}
@@ -9,6 +9,13 @@
 
 namespace dae
 {
+	enum class DepthMode
+	{
+		Standard,          //near = 0, far = 1
+		ReversedZ,         //near = 1, far = 0
+		ReversedZInfinite  //near = 1, far plane at infinity
+	};
+
 	struct Camera
 	{
 		Camera() = default;
@@ -26,6 +33,7 @@ namespace dae
 		float ar{ 1};
 		float nearPlane{ 0.1f };
 		float farPlane{ 100.0f };
+		DepthMode depthMode{ DepthMode::Standard };
 
 		Vector3 forward{Vector3::UnitZ};
 		Vector3 up{Vector3::UnitY};
@@ -39,6 +47,8 @@ namespace dae
 		Matrix projectionMatrix{};
 
 		void SetAspectRatio(float value) { ar = value; }
+		void SetDepthMode(DepthMode mode) { depthMode = mode; }
+		bool IsReversedZ() const { return depthMode != DepthMode::Standard; }
 
 		void Initialize(float _fovAngle = 90.f, Vector3 _origin = {0.f,0.f,0.f})
 		{
@@ -93,7 +103,18 @@ namespace dae
 		{
 			//TODO W3
 
-			projectionMatrix = Matrix::CreatePerspectiveFovLH(fov, ar, nearPlane, farPlane);
+			switch (depthMode)
+			{
+			case DepthMode::ReversedZ:
+				projectionMatrix = Matrix::CreateReversedPerspectiveFovLH(fov, ar, nearPlane, farPlane);
+				break;
+			case DepthMode::ReversedZInfinite:
+				projectionMatrix = Matrix::CreateInfiniteReversedPerspectiveFovLH(fov, ar, nearPlane);
+				break;
+			default:
+				projectionMatrix = Matrix::CreatePerspectiveFovLH(fov, ar, nearPlane, farPlane);
+				break;
+			}
 			//ProjectionMatrix => Matrix::CreatePerspectiveFovLH(...) [not implemented yet]
 			//DirectX Implementation => https://learn.microsoft.com/en-us/windows/win32/direct3d9/d3dxmatrixperspectivefovlh
 		}
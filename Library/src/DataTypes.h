@@ -17,11 +17,14 @@ namespace dae
 	struct Vertex_Out
 	{
 		Vector4 position{};
-		ColorRGB color{ colors::White };
+		ColorRGB color{ colors::White }; //lit color when lighting per vertex
 		Vector2 uv{};
 		Vector3 normal{};
 		Vector3 tangent{};
 		Vector3 viewDirection{};
+		Vector3 worldPosition{}; //only interpolated for local lights and shadows
+		Vector2 uvDdx{}; //uv change per screen pixel, used for mip selection
+		Vector2 uvDdy{};
 	};
 
 	enum class PrimitiveTopology
@@ -37,6 +40,8 @@ namespace dae
 		PrimitiveTopology primitiveTopology{ PrimitiveTopology::TriangleStrip };
 
 		std::vector<Vertex_Out> vertices_out{};
+		Vector3 minBounds{};
+		Vector3 maxBounds{};
 		Matrix worldMatrix{ {1,0,0,0},
 							 {0, 1, 0, 0},
 							 {0, 0, 1, 0},
@@ -0,0 +1,36 @@
+#include "FrameTracker.h"
+#include <cfloat>
+
+namespace dae
+{
+	ScreenRect CalculateScreenRect(const Mesh& mesh, const Matrix& modelToNDC, float nearPlane, int width, int height)
+	{
+		const ScreenRect fullRect{ 0, 0, width, height };
+
+		//Project the corners off the object space bounding box
+		float left{ FLT_MAX }, top{ FLT_MAX }, right{ -FLT_MAX }, bottom{ -FLT_MAX };
+		for (int corner{}; corner < 8; ++corner)
+		{
+			const Vector3 point{ (corner & 1) ? mesh.maxBounds.x : mesh.minBounds.x,
+								 (corner & 2) ? mesh.maxBounds.y : mesh.minBounds.y,
+								 (corner & 4) ? mesh.maxBounds.z : mesh.minBounds.z };
+			const Vector4 projected{ modelToNDC.TransformPoint(point.ToPoint4()) };
+
+			//A corner behind the camera has no meaningful projection
+			if (projected.w <= nearPlane)
+				return fullRect;
+
+			const float x{ ((projected.x / projected.w + 1) / 2.0f) * static_cast<float>(width) };
+			const float y{ ((1 - projected.y / projected.w) / 2.0f) * static_cast<float>(height) };
+			left   = std::min(left, x);
+			right  = std::max(right, x);
+			top    = std::min(top, y);
+			bottom = std::max(bottom, y);
+		}
+
+		//Same margin as the triangle bounding boxes
+		return ScreenRect{
+			Clamp(int(left) - 2, 0, width), Clamp(int(top) - 2, 0, height),
+			Clamp(int(right) + 2, 0, width), Clamp(int(bottom) + 2, 0, height) };
+	}
+}
@@ -0,0 +1,88 @@
+#pragma once
+#include <algorithm>
+#include <vector>
+#include "DataTypes.h"
+#include "Light.h"
+
+namespace dae
+{
+	//Pixel region, right and bottom are exclusive
+	struct ScreenRect
+	{
+		int left{};
+		int top{};
+		int right{};
+		int bottom{};
+
+		bool IsEmpty() const { return left >= right || top >= bottom; }
+		ScreenRect Union(const ScreenRect& other) const
+		{
+			if (IsEmpty()) return other;
+			if (other.IsEmpty()) return *this;
+			return { std::min(left, other.left), std::min(top, other.top), std::max(right, other.right), std::max(bottom, other.bottom) };
+		}
+		bool operator==(const ScreenRect& other) const = default;
+	};
+
+	//Bounding box off the mesh projected by modelToNDC with a 2 pixel margin, the whole screen when a corner is behind the near plane
+	ScreenRect CalculateScreenRect(const Mesh& mesh, const Matrix& modelToNDC, float nearPlane, int width, int height);
+
+	//Change tracking for incremental rendering
+	//FrameState holds everything that affects every pixel, a moved mesh only dirties the area it covered and the area it covers now
+	template<typename FrameState>
+	class FrameTracker final
+	{
+	public:
+		//The rect to draw this frame, empty when nothing changed
+		//movesAffectAllMeshes widens a dirty rect over every mesh, for when a moved mesh can change the others (shadows)
+		ScreenRect Update(const FrameState& state, const std::vector<Light>& lights, const std::vector<Mesh>& meshes,
+			const Matrix& viewProjection, float nearPlane, int width, int height, bool forceFullFrame, bool movesAffectAllMeshes)
+		{
+			const auto getScreenRect = [&](const Mesh& mesh) { return CalculateScreenRect(mesh, mesh.worldMatrix * viewProjection, nearPlane, width, height); };
+
+			if (forceFullFrame || m_FullFrameRequested || state != m_PreviousState || lights != m_PreviousLights || m_PreviousWorldMatrices.size() != meshes.size())
+			{
+				m_FullFrameRequested = false;
+				m_PreviousState  = state;
+				m_PreviousLights = lights;
+				m_PreviousWorldMatrices.clear();
+				m_PreviousMeshRects.clear();
+				for (const Mesh& mesh : meshes)
+				{
+					m_PreviousWorldMatrices.push_back(mesh.worldMatrix);
+					m_PreviousMeshRects.push_back(getScreenRect(mesh));
+				}
+				return ScreenRect{ 0, 0, width, height };
+			}
+
+			ScreenRect dirtyRect{};
+			for (size_t i{}; i < meshes.size(); ++i)
+			{
+				if (meshes[i].worldMatrix == m_PreviousWorldMatrices[i])
+					continue;
+
+				const ScreenRect meshRect{ getScreenRect(meshes[i]) };
+				dirtyRect = dirtyRect.Union(m_PreviousMeshRects[i]).Union(meshRect);
+				m_PreviousWorldMatrices[i] = meshes[i].worldMatrix;
+				m_PreviousMeshRects[i]     = meshRect;
+			}
+
+			if (movesAffectAllMeshes && !dirtyRect.IsEmpty())
+			{
+				for (const ScreenRect& meshRect : m_PreviousMeshRects)
+					dirtyRect = dirtyRect.Union(meshRect);
+			}
+			return dirtyRect;
+		}
+
+		//The next Update returns the whole screen
+		void RequestFullFrame() { m_FullFrameRequested = true; }
+
+	private:
+		bool m_FullFrameRequested{ true };
+		FrameState m_PreviousState{};
+		std::vector<Light> m_PreviousLights{};
+		std::vector<Matrix> m_PreviousWorldMatrices{};
+		std::vector<ScreenRect> m_PreviousMeshRects{};
+	};
+}
@@ -0,0 +1,52 @@
+#pragma once
+#include <cmath>
+#include "Maths.h"
+
+namespace dae
+{
+	enum class LightType
+	{
+		Directional, //lights every pixel, never culled
+		Point,
+		Spot
+	};
+
+	//World space light, point and spot lights fade out to 0 at range
+	struct Light
+	{
+		LightType type{ LightType::Point };
+		Vector3 position{};
+		Vector3 direction{ 0.f, -1.f, 0.f }; //direction the light travels, directional and spot lights only
+		ColorRGB color{ colors::White };
+		float intensity{ 1.f };
+		float range{ 10.f };
+		float cosInnerCone{ 0.9f }; //spot lights only, full intensity inside the inner cone
+		float cosOuterCone{ 0.8f };
+
+		bool operator==(const Light& other) const
+		{
+			return type == other.type && position == other.position && direction == other.direction
+				&& color.r == other.color.r && color.g == other.color.g && color.b == other.color.b
+				&& intensity == other.intensity && range == other.range
+				&& cosInnerCone == other.cosInnerCone && cosOuterCone == other.cosOuterCone;
+		}
+	};
+
+	//Fraction off the intensity off a point or spot light that reaches position, 0 outside its range and cone
+	//Windowed falloff that reaches 0 at the range, so culling by range drops nothing visible
+	//lightDirection is set to the direction the light travels towards position
+	inline float CalculateAttenuation(const Light& light, const Vector3& position, Vector3& lightDirection)
+	{
+		const Vector3 toSurface{ position - light.position };
+		const float distanceSquared{ toSurface.SqrMagnitude() };
+		const float rangeSquared{ Square(light.range) };
+		if (distanceSquared >= rangeSquared || distanceSquared <= 0.0f)
+			return 0.0f;
+
+		lightDirection = toSurface / std::sqrt(distanceSquared);
+		float attenuation{ Square(1.0f - distanceSquared / rangeSquared) };
+		if (light.type == LightType::Spot)
+			attenuation *= Saturate((Vector3::Dot(lightDirection, light.direction) - light.cosOuterCone) / (light.cosInnerCone - light.cosOuterCone));
+		return attenuation;
+	}
+}
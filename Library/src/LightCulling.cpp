@@ -0,0 +1,179 @@
+#include "LightCulling.h"
+#include <algorithm>
+#include <cmath>
+#include <limits>
+
+namespace dae
+{
+	TileFrustum LightCulling::CreateTileFrustum(const Matrix& projection, int left, int top, int right, int bottom, int width, int height, float minDepth, float maxDepth)
+	{
+		//A view space point projects to ndc x = (x * m00 + z * m20) / z, so every ndc x is a plane through the camera
+		const float scaleX{ projection[0].x }, offsetX{ projection[2].x };
+		const float scaleY{ projection[1].y }, offsetY{ projection[2].y };
+		const float ndcLeft{ 2.0f * left / width - 1.0f };
+		const float ndcRight{ 2.0f * right / width - 1.0f };
+		const float ndcTop{ 1.0f - 2.0f * top / height };
+		const float ndcBottom{ 1.0f - 2.0f * bottom / height };
+
+		TileFrustum tile{};
+		tile.sideNormals[0] = Vector3{ scaleX, 0.0f, offsetX - ndcLeft }.Normalized();
+		tile.sideNormals[1] = Vector3{ -scaleX, 0.0f, ndcRight - offsetX }.Normalized();
+		tile.sideNormals[2] = Vector3{ 0.0f, -scaleY, ndcTop - offsetY }.Normalized();
+		tile.sideNormals[3] = Vector3{ 0.0f, scaleY, offsetY - ndcBottom }.Normalized();
+		tile.minDepth = minDepth;
+		tile.maxDepth = maxDepth;
+
+		if (minDepth > maxDepth || maxDepth == std::numeric_limits<float>::max())
+		{
+			tile.boundsRadius = std::numeric_limits<float>::max();
+			return tile;
+		}
+
+		//Corners off the tile at both ends off the depth range
+		Vector3 corners[8]{};
+		for (int corner{}; corner < 8; ++corner)
+		{
+			const float depth{ (corner & 4) ? maxDepth : minDepth };
+			const float ndcX{ (corner & 1) ? ndcRight : ndcLeft };
+			const float ndcY{ (corner & 2) ? ndcBottom : ndcTop };
+			corners[corner] = Vector3{ depth * (ndcX - offsetX) / scaleX, depth * (ndcY - offsetY) / scaleY, depth };
+			tile.boundsCenter += corners[corner] / 8.0f;
+		}
+		for (const Vector3& corner : corners)
+			tile.boundsRadius = std::max(tile.boundsRadius, (corner - tile.boundsCenter).Magnitude());
+		return tile;
+	}
+
+	bool LightCulling::IntersectsTile(const Light& viewLight, const TileFrustum& tile)
+	{
+		//Sphere off the range against the depth range and the side planes
+		const Vector3& center{ viewLight.position };
+		if (center.z + viewLight.range < tile.minDepth || center.z - viewLight.range > tile.maxDepth)
+			return false;
+		for (const Vector3& normal : tile.sideNormals)
+		{
+			if (Vector3::Dot(normal, center) < -viewLight.range)
+				return false;
+		}
+
+		//Spot cone against the sphere around the tile: outside when the sphere lies behind the apex or further from the cone than its radius
+		if (viewLight.type != LightType::Spot || viewLight.cosOuterCone <= 0.0f || tile.boundsRadius == std::numeric_limits<float>::max())
+			return true;
+
+		const Vector3 toBounds{ tile.boundsCenter - center };
+		const float alongAxis{ Vector3::Dot(toBounds, viewLight.direction.Normalized()) };
+		const float fromAxis{ std::sqrt(std::max(toBounds.SqrMagnitude() - alongAxis * alongAxis, 0.0f)) };
+		const float sinOuterCone{ std::sqrt(1.0f - viewLight.cosOuterCone * viewLight.cosOuterCone) };
+		const float distanceToCone{ viewLight.cosOuterCone * fromAxis - sinOuterCone * alongAxis };
+		return distanceToCone <= tile.boundsRadius && alongAxis >= -tile.boundsRadius;
+	}
+
+	void TileLightGrid::Cull(const std::vector<Light>& lights, const Matrix& view, const Matrix& projection, float nearPlane,
+		const float* pDepth, int width, int height, const ScreenRect& dirtyRect)
+	{
+		m_DirectionalLights.clear();
+		m_LocalLights.clear();
+		m_TilesX = (width + m_TileSize - 1) / m_TileSize;
+		m_TilesY = (height + m_TileSize - 1) / m_TileSize;
+		m_TileLights.resize(size_t(m_TilesX) * m_TilesY);
+
+		for (int i{}; i < int(lights.size()); ++i)
+			(lights[i].type == LightType::Directional ? m_DirectionalLights : m_LocalLights).push_back(i);
+		if (m_LocalLights.empty())
+			return;
+
+		//Only the tiles touching the dirty rect are shaded this frame
+		const int firstTileX{ dirtyRect.left / m_TileSize };
+		const int firstTileY{ dirtyRect.top / m_TileSize };
+		const int endTileX{ (dirtyRect.right + m_TileSize - 1) / m_TileSize };
+		const int endTileY{ (dirtyRect.bottom + m_TileSize - 1) / m_TileSize };
+
+		//View depth range off the visible surfaces per tile, empty tiles keep an inverted range and get no lights
+		std::vector<float> tileMinDepth(m_TileLights.size(), pDepth == nullptr ? 0.0f : std::numeric_limits<float>::max());
+		std::vector<float> tileMaxDepth(m_TileLights.size(), pDepth == nullptr ? std::numeric_limits<float>::max() : 0.0f);
+		if (pDepth != nullptr)
+		{
+			for (int py{ dirtyRect.top }; py < dirtyRect.bottom; ++py)
+			{
+				for (int px{ dirtyRect.left }; px < dirtyRect.right; ++px)
+				{
+					const float depth{ pDepth[px + py * width] };
+					if (depth == std::numeric_limits<float>::max())
+						continue;
+
+					const size_t tile{ size_t(px / m_TileSize) + size_t(py / m_TileSize) * m_TilesX };
+					tileMinDepth[tile] = std::min(tileMinDepth[tile], depth);
+					tileMaxDepth[tile] = std::max(tileMaxDepth[tile], depth);
+				}
+			}
+		}
+
+		std::vector<TileFrustum> tileFrustums(m_TileLights.size());
+		for (int tileY{ firstTileY }; tileY < endTileY; ++tileY)
+		{
+			for (int tileX{ firstTileX }; tileX < endTileX; ++tileX)
+			{
+				const int tile{ tileX + tileY * m_TilesX };
+				m_TileLights[tile].clear();
+				tileFrustums[tile] = LightCulling::CreateTileFrustum(projection,
+					tileX * m_TileSize, tileY * m_TileSize, std::min((tileX + 1) * m_TileSize, width), std::min((tileY + 1) * m_TileSize, height),
+					width, height, tileMinDepth[tile], tileMaxDepth[tile]);
+			}
+		}
+
+		//Every light only visits the tiles under its screen bounds, so the cost follows the light density
+		for (const int lightIndex : m_LocalLights)
+		{
+			const Light& light{ lights[lightIndex] };
+			Light viewLight{ light };
+			viewLight.position  = view.TransformPoint(light.position);
+			viewLight.direction = view.TransformVector(light.direction);
+			const Vector3& center{ viewLight.position };
+			if (center.z + light.range < nearPlane)
+				continue;
+
+			//Projected corners off the box around the sphere, a sphere through the near plane can cover the whole screen
+			int left{ firstTileX }, top{ firstTileY }, right{ endTileX }, bottom{ endTileY };
+			if (center.z - light.range > nearPlane)
+			{
+				float minX{ std::numeric_limits<float>::max() }, minY{ std::numeric_limits<float>::max() };
+				float maxX{ -std::numeric_limits<float>::max() }, maxY{ -std::numeric_limits<float>::max() };
+				for (int corner{}; corner < 8; ++corner)
+				{
+					const Vector4 clip{ projection.TransformPoint(Vector4{
+						center.x + ((corner & 1) ? light.range : -light.range),
+						center.y + ((corner & 2) ? light.range : -light.range),
+						center.z + ((corner & 4) ? light.range : -light.range), 1.0f }) };
+					const float screenX{ (clip.x / clip.w + 1.0f) * 0.5f * width };
+					const float screenY{ (1.0f - clip.y / clip.w) * 0.5f * height };
+					minX = std::min(minX, screenX);
+					maxX = std::max(maxX, screenX);
+					minY = std::min(minY, screenY);
+					maxY = std::max(maxY, screenY);
+				}
+				left   = std::max(left, int(std::floor(minX)) / m_TileSize);
+				top    = std::max(top, int(std::floor(minY)) / m_TileSize);
+				right  = std::min(right, int(std::ceil(maxX)) / m_TileSize + 1);
+				bottom = std::min(bottom, int(std::ceil(maxY)) / m_TileSize + 1);
+			}
+
+			for (int tileY{ top }; tileY < bottom; ++tileY)
+			{
+				for (int tileX{ left }; tileX < right; ++tileX)
+				{
+					const int tile{ tileX + tileY * m_TilesX };
+					if (LightCulling::IntersectsTile(viewLight, tileFrustums[tile]))
+						m_TileLights[tile].push_back(lightIndex);
+				}
+			}
+		}
+	}
+
+	const std::vector<int>& TileLightGrid::GetPixelLights(float x, float y) const
+	{
+		//Only the lights that can reach the depth range off the tile are in its list
+		const int tileX{ Clamp(int(x) / m_TileSize, 0, m_TilesX - 1) };
+		const int tileY{ Clamp(int(y) / m_TileSize, 0, m_TilesY - 1) };
+		return m_TileLights[tileX + tileY * m_TilesX];
+	}
+}
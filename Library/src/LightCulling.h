@@ -0,0 +1,55 @@
+#pragma once
+#include <vector>
+#include "Light.h"
+#include "FrameTracker.h"
+
+namespace dae
+{
+	//View space volume off one screen tile, between the depth range off the surfaces visible in it
+	struct TileFrustum
+	{
+		Vector3 sideNormals[4]{}; //pointing inside, the side planes pass through the camera
+		float minDepth{};
+		float maxDepth{};
+		//Sphere around the volume for the spot cone test, radius is max float for an unbounded depth range
+		Vector3 boundsCenter{};
+		float boundsRadius{};
+	};
+
+	namespace LightCulling
+	{
+		//Tile from left/top to right/bottom in pixels off a width x height screen, projection is a left handed perspective
+		//minDepth > maxDepth marks a tile without visible surfaces, no light reaches it
+		TileFrustum CreateTileFrustum(const Matrix& projection, int left, int top, int right, int bottom, int width, int height, float minDepth, float maxDepth);
+		//Conservative, false only when the light cannot reach any point off the tile
+		//viewLight has its position and direction in view space
+		bool IntersectsTile(const Light& viewLight, const TileFrustum& tile);
+	}
+
+	//Forward+ light lists, point and spot lights are culled against the depth range off every tile off the screen
+	class TileLightGrid final
+	{
+	public:
+		explicit TileLightGrid(int tileSize) : m_TileSize{ tileSize } {}
+
+		//Splits lights into directional and local ones and culls the local ones against the tiles touching dirtyRect, the other tiles keep their lists
+		//pDepth holds the view depth off the nearest surface per pixel in rows off width, max float where there is none
+		//nullptr culls against the full depth range
+		void Cull(const std::vector<Light>& lights, const Matrix& view, const Matrix& projection, float nearPlane,
+			const float* pDepth, int width, int height, const ScreenRect& dirtyRect);
+
+		const std::vector<int>& GetDirectionalLights() const { return m_DirectionalLights; }
+		//Local lights that can reach the surface visible at pixel x, y
+		const std::vector<int>& GetPixelLights(float x, float y) const;
+		//Every local light, a vertex can be hidden, off screen or outside the redrawn tiles and still light the visible pixels next to it
+		const std::vector<int>& GetVertexLights() const { return m_LocalLights; }
+
+	private:
+		const int m_TileSize{};
+		int m_TilesX{};
+		int m_TilesY{};
+		std::vector<std::vector<int>> m_TileLights{};
+		std::vector<int> m_DirectionalLights{};
+		std::vector<int> m_LocalLights{};
+	};
+}
@@ -0,0 +1,76 @@
+#include "MappedFile.h"
+
+#ifdef _WIN32
+#define WIN32_LEAN_AND_MEAN
+#define NOMINMAX
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+namespace dae
+{
+#ifdef _WIN32
+	MappedFile::MappedFile(const std::string& path)
+	{
+		m_File = CreateFileA(path.c_str(), GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING, FILE_FLAG_SEQUENTIAL_SCAN, nullptr);
+		if (m_File == INVALID_HANDLE_VALUE)
+		{
+			m_File = nullptr;
+			return;
+		}
+
+		//A mapping off an empty file fails, it is reported as not open
+		LARGE_INTEGER size{};
+		if (!GetFileSizeEx(m_File, &size) || size.QuadPart == 0)
+			return;
+
+		m_Mapping = CreateFileMappingA(m_File, nullptr, PAGE_READONLY, 0, 0, nullptr);
+		if (m_Mapping == nullptr)
+			return;
+
+		m_pData = static_cast<const char*>(MapViewOfFile(m_Mapping, FILE_MAP_READ, 0, 0, 0));
+		if (m_pData != nullptr)
+			m_Size = size_t(size.QuadPart);
+	}
+
+	MappedFile::~MappedFile()
+	{
+		if (m_pData != nullptr)
+			UnmapViewOfFile(m_pData);
+		if (m_Mapping != nullptr)
+			CloseHandle(m_Mapping);
+		if (m_File != nullptr)
+			CloseHandle(m_File);
+	}
+#else
+	MappedFile::MappedFile(const std::string& path)
+	{
+		const int file{ open(path.c_str(), O_RDONLY) };
+		if (file < 0)
+			return;
+
+		//The mapping keeps the file alive, the descriptor is not needed after it
+		struct stat status{};
+		if (fstat(file, &status) == 0 && status.st_size > 0)
+		{
+			void* pData{ mmap(nullptr, size_t(status.st_size), PROT_READ, MAP_PRIVATE, file, 0) };
+			if (pData != MAP_FAILED)
+			{
+				m_pData = static_cast<const char*>(pData);
+				m_Size  = size_t(status.st_size);
+			}
+		}
+		close(file);
+	}
+
+	MappedFile::~MappedFile()
+	{
+		if (m_pData != nullptr)
+			munmap(const_cast<char*>(m_pData), m_Size);
+	}
+#endif
+}
@@ -0,0 +1,177 @@
+#include "Material.h"
+#include "Texture.h"
+#include "Vector2.h"
+#include "MathHelpers.h"
+#include <algorithm>
+
+namespace dae
+{
+	namespace
+	{
+		uint32_t ToByte(float value)
+		{
+			return uint32_t(Saturate(value) * 255.0f + 0.5f);
+		}
+
+		int16_t ToSnorm16(float value)
+		{
+			return int16_t(std::lround(Clamp(value, -1.0f, 1.0f) * 32767.0f));
+		}
+
+		void Accumulate(MaterialSample& sum, const MaterialSample& sample, float weight)
+		{
+			sum.diffuse  += sample.diffuse * weight;
+			sum.specular += sample.specular * weight;
+			sum.gloss    += sample.gloss * weight;
+			sum.normal   += sample.normal * weight;
+		}
+	}
+
+	Material* Material::CreateFromTextures(const Texture* pDiffuse, const Texture* pSpecular, const Texture* pGloss, const Texture* pNormal)
+	{
+		for (const Texture* pTexture : { pSpecular, pGloss, pNormal })
+		{
+			if (pTexture->GetWidth() != pDiffuse->GetWidth() || pTexture->GetHeight() != pDiffuse->GetHeight())
+				return nullptr;
+		}
+
+		//The maps share their size, so they also share their mip chain; texel centers read every level exactly
+		Material* pMaterial{ new Material() };
+		for (int levelIndex{}; levelIndex < pDiffuse->GetLevelCount(); ++levelIndex)
+		{
+			Level& level{ pMaterial->m_Levels.emplace_back() };
+			level.width  = std::max(pDiffuse->GetWidth() >> levelIndex, 1);
+			level.height = std::max(pDiffuse->GetHeight() >> levelIndex, 1);
+			level.texels.resize(size_t(level.width) * level.height);
+
+			const float lod{ float(levelIndex) };
+			for (int v{}; v < level.height; ++v)
+			{
+				for (int u{}; u < level.width; ++u)
+				{
+					const Vector2 uv{ (u + 0.5f) / level.width, (v + 0.5f) / level.height };
+					const ColorRGB diffuse{ pDiffuse->SampleNearestMip(uv, lod) };
+					const ColorRGB specular{ pSpecular->SampleNearestMip(uv, lod) };
+					const Vector3 normal{ pNormal->SampleNormalNearestMip(uv, lod) };
+
+					Texel& texel{ level.texels[u + size_t(v) * level.width] };
+					texel.diffuse       = ToByte(diffuse.r) | (ToByte(diffuse.g) << 8) | (ToByte(diffuse.b) << 16) | (0xFFu << 24);
+					texel.specularGloss = ToByte(specular.r) | (ToByte(specular.g) << 8) | (ToByte(specular.b) << 16) | (ToByte(pGloss->SampleFloatNearestMip(uv, lod)) << 24);
+					texel.normal[0]     = ToSnorm16(normal.x);
+					texel.normal[1]     = ToSnorm16(normal.y);
+					texel.normal[2]     = ToSnorm16(normal.z);
+				}
+			}
+		}
+
+		return pMaterial;
+	}
+
+	size_t Material::GetMemorySize() const
+	{
+		size_t memorySize{};
+		for (const Level& level : m_Levels)
+			memorySize += level.texels.size() * sizeof(Texel);
+		return memorySize;
+	}
+
+	MaterialSample Material::Decode(const Texel& texel)
+	{
+		constexpr float toFloat{ 1.0f / 255.0f };
+		constexpr float fromSnorm{ 1.0f / 32767.0f };
+		return MaterialSample{
+			{ float(texel.diffuse & 0xFF) * toFloat, float((texel.diffuse >> 8) & 0xFF) * toFloat, float((texel.diffuse >> 16) & 0xFF) * toFloat },
+			{ float(texel.specularGloss & 0xFF) * toFloat, float((texel.specularGloss >> 8) & 0xFF) * toFloat, float((texel.specularGloss >> 16) & 0xFF) * toFloat },
+			float(texel.specularGloss >> 24) * toFloat,
+			{ texel.normal[0] * fromSnorm, texel.normal[1] * fromSnorm, texel.normal[2] * fromSnorm } };
+	}
+
+	uint32_t Material::GetTexelIndex(const Level& level, const Vector2& uv) const
+	{
+		const uint32_t u{ std::min(uint32_t(std::clamp(uv.x, 0.f, 1.f) * level.width), uint32_t(level.width - 1)) };
+		const uint32_t v{ std::min(uint32_t(std::clamp(uv.y, 0.f, 1.f) * level.height), uint32_t(level.height - 1)) };
+		return u + v * level.width;
+	}
+
+	int Material::GetNearestLevel(float lod) const
+	{
+		return Clamp(int(lod + 0.5f), 0, int(m_Levels.size()) - 1);
+	}
+
+	float Material::CalculateLod(const Vector2& uvDdx, const Vector2& uvDdy) const
+	{
+		const float width{ float(GetWidth()) };
+		const float height{ float(GetHeight()) };
+		const float lengthX{ Square(uvDdx.x * width) + Square(uvDdx.y * height) };
+		const float lengthY{ Square(uvDdy.x * width) + Square(uvDdy.y * height) };
+		const float maxLength{ std::max(lengthX, lengthY) };
+		if (maxLength <= 1.0f)
+			return 0.0f;
+
+		return std::min(0.5f * std::log2(maxLength), float(m_Levels.size() - 1));
+	}
+
+	MaterialSample Material::Sample(const Vector2& uv) const
+	{
+		return Decode(m_Levels[0].texels[GetTexelIndex(m_Levels[0], uv)]);
+	}
+
+	MaterialSample Material::SampleNearestMip(const Vector2& uv, float lod) const
+	{
+		const Level& level{ m_Levels[GetNearestLevel(lod)] };
+		return Decode(level.texels[GetTexelIndex(level, uv)]);
+	}
+
+	MaterialSample Material::SampleTrilinear(const Vector2& uv, float lod) const
+	{
+		const int levelCount{ int(m_Levels.size()) };
+		const int level0{ Clamp(int(lod), 0, levelCount - 1) };
+		const int level1{ std::min(level0 + 1, levelCount - 1) };
+		const float blend{ Saturate(lod - level0) };
+
+		MaterialSample sample{ SampleBilinear(m_Levels[level0], uv) };
+		if (blend > 0.0f && level0 != level1)
+		{
+			MaterialSample blended{};
+			Accumulate(blended, sample, 1.0f - blend);
+			Accumulate(blended, SampleBilinear(m_Levels[level1], uv), blend);
+			sample = blended;
+		}
+		sample.normal.Normalize();
+		return sample;
+	}
+
+	void Material::SampleBilinearBatch(const Vector2* pUvs, MaterialSample* pSamples, int count, float lod) const
+	{
+		const Level& level{ m_Levels[GetNearestLevel(lod)] };
+		for (int i{}; i < count; ++i)
+		{
+			pSamples[i] = SampleBilinear(level, pUvs[i]);
+			pSamples[i].normal.Normalize();
+		}
+	}
+
+	MaterialSample Material::SampleBilinear(const Level& level, const Vector2& uv) const
+	{
+		//Texel centers sit at +0.5, the footprint is clamped to the edge
+		const float x{ std::clamp(uv.x, 0.f, 1.f) * level.width - 0.5f };
+		const float y{ std::clamp(uv.y, 0.f, 1.f) * level.height - 0.5f };
+		const float floorX{ std::floor(x) };
+		const float floorY{ std::floor(y) };
+		const float weightU{ Saturate(x - floorX) };
+		const float weightV{ Saturate(y - floorY) };
+
+		const int u0{ Clamp(int(floorX), 0, level.width - 1) };
+		const int v0{ Clamp(int(floorY), 0, level.height - 1) };
+		const int u1{ Clamp(int(floorX) + 1, 0, level.width - 1) };
+		const int v1{ Clamp(int(floorY) + 1, 0, level.height - 1) };
+
+		MaterialSample sample{};
+		sample.normal = {};
+		Accumulate(sample, Decode(level.texels[u0 + v0 * level.width]), (1.0f - weightU) * (1.0f - weightV));
+		Accumulate(sample, Decode(level.texels[u1 + v0 * level.width]), weightU * (1.0f - weightV));
+		Accumulate(sample, Decode(level.texels[u0 + v1 * level.width]), (1.0f - weightU) * weightV);
+		Accumulate(sample, Decode(level.texels[u1 + v1 * level.width]), weightU * weightV);
+		return sample;
+	}
+}
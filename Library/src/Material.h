@@ -0,0 +1,71 @@
+#pragma once
+#include <cstdint>
+#include <vector>
+#include "ColorRGB.h"
+#include "Vector3.h"
+
+namespace dae
+{
+	struct Vector2;
+	class Texture;
+
+	//Every map off a material at one uv
+	struct MaterialSample
+	{
+		ColorRGB diffuse{};
+		ColorRGB specular{};
+		float gloss{};
+		Vector3 normal{ 0.0f, 0.0f, 1.0f }; //tangent space, [-1, 1]
+	};
+
+	//Diffuse, specular, gloss and normal maps interleaved into one 16 byte record per texel,
+	//so every map at a uv is served by one address computation and one cache line
+	class Material
+	{
+	public:
+		~Material() = default;
+
+		//Returns nullptr when the maps do not share the same resolution
+		static Material* CreateFromTextures(const Texture* pDiffuse, const Texture* pSpecular, const Texture* pGloss, const Texture* pNormal);
+
+		MaterialSample Sample(const Vector2& uv) const;
+		MaterialSample SampleNearestMip(const Vector2& uv, float lod) const;
+		MaterialSample SampleTrilinear(const Vector2& uv, float lod) const;
+		//Bilinear filter off count uvs in the level closest to lod, every map comes from the same texel records
+		void SampleBilinearBatch(const Vector2* pUvs, MaterialSample* pSamples, int count, float lod) const;
+
+		//Mip level for the screen space uv derivatives, clamped to the available levels
+		float CalculateLod(const Vector2& uvDdx, const Vector2& uvDdy) const;
+
+		int GetWidth() const { return m_Levels[0].width; }
+		int GetHeight() const { return m_Levels[0].height; }
+		size_t GetMemorySize() const;
+
+	private:
+		//Diffuse rgba8, specular rgb8 with gloss in the 4th byte, normal as 3 snorm16
+		struct alignas(16) Texel
+		{
+			uint32_t diffuse{};
+			uint32_t specularGloss{};
+			int16_t normal[3]{};
+			uint16_t padding{};
+		};
+		static_assert(sizeof(Texel) == 16);
+
+		struct Level
+		{
+			int width{};
+			int height{};
+			std::vector<Texel> texels{};
+		};
+
+		Material() = default;
+
+		static MaterialSample Decode(const Texel& texel);
+		uint32_t GetTexelIndex(const Level& level, const Vector2& uv) const;
+		int GetNearestLevel(float lod) const;
+		MaterialSample SampleBilinear(const Level& level, const Vector2& uv) const;
+
+		std::vector<Level> m_Levels{};
+	};
+}
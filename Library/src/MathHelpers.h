@@ -1,6 +1,7 @@
 #pragma once
 #include <cfloat>
 #include <cmath>
+#include <cstdint>
 
 namespace dae
 {
@@ -57,4 +58,21 @@ namespace dae
 		if (v > 1.f) return 1.f;
 		return v;
 	}
+
+	//Spreads the lower 16 bits so a zero bit sits between each of them
+	inline uint32_t SpreadBits(uint32_t v)
+	{
+		v &= 0x0000FFFF;
+		v = (v | (v << 8)) & 0x00FF00FF;
+		v = (v | (v << 4)) & 0x0F0F0F0F;
+		v = (v | (v << 2)) & 0x33333333;
+		v = (v | (v << 1)) & 0x55555555;
+		return v;
+	}
+
+	//Z-order index, x in the even bits and y in the odd bits
+	inline uint32_t MortonEncode(uint32_t x, uint32_t y)
+	{
+		return SpreadBits(x) | (SpreadBits(y) << 1);
+	}
 }
\ No newline at end of file
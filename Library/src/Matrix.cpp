@@ -176,6 +176,28 @@ namespace dae {
 		};
 	}
 
+	Matrix Matrix::CreateReversedPerspectiveFovLH(float fov, float aspect, float zn, float zf)
+	{
+		//Same as CreatePerspectiveFovLH, but maps the near plane to 1 and the far plane to 0
+		return {
+			{1.f / (aspect * fov), 0.f        ,0.f                    ,0.f},
+			{0.f                 , 1.f / fov  ,0.f                    ,0.f},
+			{0.f                 , 0.f        , zn / (zn - zf)        ,1.f},
+			{0.f                 , 0.f        , (zf * zn) / (zf - zn) ,0.f},
+		};
+	}
+
+	Matrix Matrix::CreateInfiniteReversedPerspectiveFovLH(float fov, float aspect, float zn)
+	{
+		//Limit of the reversed projection for zf -> infinity, depth becomes zn / z
+		return {
+			{1.f / (aspect * fov), 0.f        ,0.f ,0.f},
+			{0.f                 , 1.f / fov  ,0.f ,0.f},
+			{0.f                 , 0.f        ,0.f ,1.f},
+			{0.f                 , 0.f        ,zn  ,0.f},
+		};
+	}
+
 	Vector3 Matrix::GetAxisX() const
 	{
 		return data[0];
@@ -50,6 +50,8 @@ namespace dae {
 
 		static Matrix CreateLookAtLH(const Vector3& origin, const Vector3& forward, const Vector3& up);
 		static Matrix CreatePerspectiveFovLH(float fovy, float aspect, float zn, float zf);
+		static Matrix CreateReversedPerspectiveFovLH(float fovy, float aspect, float zn, float zf);
+		static Matrix CreateInfiniteReversedPerspectiveFovLH(float fovy, float aspect, float zn);
 
 		Vector4& operator[](int index);
 		Vector4 operator[](int index) const;
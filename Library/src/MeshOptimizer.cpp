@@ -0,0 +1,413 @@
+#include "MeshOptimizer.h"
+#include <algorithm>
+#include <cfloat>
+#include <cmath>
+#include <cstddef>
+#include <numeric>
+#include <string_view>
+#include <unordered_map>
+
+namespace dae
+{
+	namespace
+	{
+		//Tangents off the OBJ corners are per triangle, corners within about 8 degrees share a vertex with their average
+		constexpr float TangentWeldCosine{ 0.99f };
+		//Modelled cache for the triangle order, larger than the one the ACMR is reported for so the order holds up on both
+		constexpr int ForsythCacheSize{ 32 };
+		//A cluster may cost this much more vertex transforms than the whole mesh before it is split off
+		constexpr float OverdrawClusterThreshold{ 1.05f };
+
+		void WeldVertices(Mesh& mesh)
+		{
+			//Everything in front off the tangent has to match exactly
+			constexpr size_t keySize{ offsetof(Vertex, tangent) };
+			const std::vector<Vertex>& corners{ mesh.vertices };
+			std::unordered_map<std::string_view, std::vector<uint32_t>> candidates{};
+			candidates.reserve(corners.size());
+
+			std::vector<Vertex> vertices{};
+			std::vector<Vector3> tangentSums{};
+			std::vector<uint32_t> cornerCounts{};
+			std::vector<uint32_t> remap(corners.size());
+			for (size_t i{}; i < corners.size(); ++i)
+			{
+				const Vertex& corner{ corners[i] };
+				std::vector<uint32_t>& sameKey{ candidates[std::string_view{ reinterpret_cast<const char*>(&corner), keySize }] };
+				const auto match{ std::ranges::find_if(sameKey, [&](uint32_t vertex) { return Vector3::Dot(vertices[vertex].tangent, corner.tangent) > TangentWeldCosine; }) };
+				if (match != sameKey.end())
+				{
+					remap[i] = *match;
+					tangentSums[*match] += corner.tangent;
+					++cornerCounts[*match];
+					continue;
+				}
+
+				remap[i] = uint32_t(vertices.size());
+				sameKey.push_back(remap[i]);
+				vertices.push_back(corner);
+				tangentSums.push_back(corner.tangent);
+				cornerCounts.push_back(1);
+			}
+
+			for (size_t i{}; i < vertices.size(); ++i)
+			{
+				if (cornerCounts[i] > 1)
+					vertices[i].tangent = Vector3::Reject(tangentSums[i], vertices[i].normal).Normalized();
+			}
+			for (uint32_t& index : mesh.indices)
+				index = remap[index];
+			mesh.vertices = std::move(vertices);
+		}
+
+		float CalculateForsythScore(int cachePosition, uint32_t remainingTriangles)
+		{
+			if (remainingTriangles == 0)
+				return -1.0f;
+
+			//The vertices off the last triangle get a fixed score, so the next one does not strip along the same edge forever
+			float score{};
+			if (cachePosition >= 0)
+				score = cachePosition < 3 ? 0.75f : std::pow(1.0f - float(cachePosition - 3) / (ForsythCacheSize - 3), 1.5f);
+
+			//Vertices with few triangles left are finished first, otherwise they stay behind as isolated triangles
+			return score + 2.0f * std::pow(float(remainingTriangles), -0.5f);
+		}
+
+		//Greedy, always the best scored triangle off the vertices in a modelled LRU cache
+		std::vector<uint32_t> OrderForVertexCache(const std::vector<uint32_t>& indices, size_t vertexCount)
+		{
+			const size_t triangleCount{ indices.size() / 3 };
+
+			//Triangles per vertex, the first remaining[v] ones are the ones not emitted yet
+			std::vector<uint32_t> remaining(vertexCount);
+			for (const uint32_t index : indices)
+				++remaining[index];
+			std::vector<uint32_t> offsets(vertexCount + 1);
+			std::inclusive_scan(remaining.begin(), remaining.end(), offsets.begin() + 1);
+			std::vector<uint32_t> adjacency(indices.size());
+			{
+				std::vector<uint32_t> fill(offsets.begin(), offsets.end() - 1);
+				for (size_t i{}; i < indices.size(); ++i)
+					adjacency[fill[indices[i]]++] = uint32_t(i / 3);
+			}
+
+			std::vector<int> cachePositions(vertexCount, -1);
+			std::vector<float> vertexScores(vertexCount);
+			for (size_t v{}; v < vertexCount; ++v)
+				vertexScores[v] = CalculateForsythScore(-1, remaining[v]);
+
+			std::vector<float> triangleScores(triangleCount);
+			std::vector<bool> emitted(triangleCount);
+			int bestTriangle{ -1 };
+			for (size_t t{}; t < triangleCount; ++t)
+			{
+				triangleScores[t] = vertexScores[indices[t * 3]] + vertexScores[indices[t * 3 + 1]] + vertexScores[indices[t * 3 + 2]];
+				if (bestTriangle < 0 || triangleScores[t] > triangleScores[bestTriangle])
+					bestTriangle = int(t);
+			}
+
+			std::vector<uint32_t> ordered{};
+			ordered.reserve(indices.size());
+			std::vector<uint32_t> cache{}, nextCache{};
+			size_t scanPosition{};
+			while (ordered.size() < indices.size())
+			{
+				//Nothing in the cache has triangles left, continue at the next triangle not emitted yet
+				if (bestTriangle < 0)
+				{
+					while (emitted[scanPosition])
+						++scanPosition;
+					bestTriangle = int(scanPosition);
+				}
+
+				const uint32_t* pCorners{ &indices[size_t(bestTriangle) * 3] };
+				ordered.insert(ordered.end(), pCorners, pCorners + 3);
+				emitted[bestTriangle] = true;
+				for (int i{}; i < 3; ++i)
+				{
+					const uint32_t vertex{ pCorners[i] };
+					uint32_t* pTriangles{ &adjacency[offsets[vertex]] };
+					std::iter_swap(std::find(pTriangles, pTriangles + remaining[vertex], uint32_t(bestTriangle)), pTriangles + remaining[vertex] - 1);
+					--remaining[vertex];
+				}
+
+				//Least recently used, the corners move to the front
+				nextCache.assign(pCorners, pCorners + 3);
+				for (const uint32_t vertex : cache)
+				{
+					if (vertex != pCorners[0] && vertex != pCorners[1] && vertex != pCorners[2])
+						nextCache.push_back(vertex);
+				}
+				for (size_t i{ ForsythCacheSize }; i < nextCache.size(); ++i)
+				{
+					cachePositions[nextCache[i]] = -1;
+					vertexScores[nextCache[i]]   = CalculateForsythScore(-1, remaining[nextCache[i]]);
+				}
+				nextCache.resize(std::min(nextCache.size(), size_t(ForsythCacheSize)));
+				std::swap(cache, nextCache);
+
+				for (size_t i{}; i < cache.size(); ++i)
+				{
+					cachePositions[cache[i]] = int(i);
+					vertexScores[cache[i]]   = CalculateForsythScore(int(i), remaining[cache[i]]);
+				}
+
+				//Only the triangles around the cache changed score
+				bestTriangle = -1;
+				float bestScore{ -FLT_MAX };
+				for (const uint32_t vertex : cache)
+				{
+					for (uint32_t i{}; i < remaining[vertex]; ++i)
+					{
+						const uint32_t triangle{ adjacency[offsets[vertex] + i] };
+						const float score{ vertexScores[indices[triangle * 3]] + vertexScores[indices[triangle * 3 + 1]] + vertexScores[indices[triangle * 3 + 2]] };
+						triangleScores[triangle] = score;
+						if (score > bestScore)
+						{
+							bestScore    = score;
+							bestTriangle = int(triangle);
+						}
+					}
+				}
+			}
+			return ordered;
+		}
+
+		//Clusters are as short as they can be without costing more than the threshold in vertex transforms, every jump in the
+		//cache order starts one, then the clusters facing away from the center are drawn first so they occlude the rest
+		std::vector<uint32_t> SortClustersForOverdraw(const std::vector<Vertex>& vertices, const std::vector<uint32_t>& indices, int cacheSize)
+		{
+			const size_t triangleCount{ indices.size() / 3 };
+			const float meshAcmr{ MeshOptimizer::CalculateAcmr(indices, vertices.size(), cacheSize) };
+
+			std::vector<size_t> clusterStarts{ 0 };
+			std::vector<uint32_t> insertTimes(vertices.size());
+			uint32_t time{ uint32_t(cacheSize) + 1 };
+			uint32_t clusterMisses{}, clusterTriangles{};
+			const auto countMisses = [&](size_t triangle)
+				{
+					uint32_t misses{};
+					for (int i{}; i < 3; ++i)
+					{
+						uint32_t& insertTime{ insertTimes[indices[triangle * 3 + i]] };
+						if (time - insertTime > uint32_t(cacheSize))
+						{
+							insertTime = time++;
+							++misses;
+						}
+					}
+					return misses;
+				};
+			for (size_t t{}; t < triangleCount; ++t)
+			{
+				uint32_t misses{ countMisses(t) };
+				const bool isJump{ misses == 3 };
+				if (clusterTriangles > 0 && (isJump || clusterMisses <= OverdrawClusterThreshold * meshAcmr * clusterTriangles))
+				{
+					//The cluster can end up anywhere, so the next one starts with an empty cache
+					clusterStarts.push_back(t);
+					time += uint32_t(cacheSize) + 1;
+					misses = countMisses(t);
+					clusterMisses = clusterTriangles = 0;
+				}
+				clusterMisses += misses;
+				++clusterTriangles;
+			}
+			clusterStarts.push_back(triangleCount);
+
+			//Area weighted centers and normals, the vertex normals decide which side a triangle faces
+			struct Cluster
+			{
+				size_t first{};
+				size_t end{};
+				Vector3 center{};
+				Vector3 normal{};
+				float area{};
+			};
+			std::vector<Cluster> clusters(clusterStarts.size() - 1);
+			Vector3 meshCenter{};
+			float meshArea{};
+			for (size_t c{}; c < clusters.size(); ++c)
+			{
+				Cluster& cluster{ clusters[c] };
+				cluster.first = clusterStarts[c];
+				cluster.end   = clusterStarts[c + 1];
+				for (size_t t{ cluster.first }; t < cluster.end; ++t)
+				{
+					const Vertex& v0{ vertices[indices[t * 3]] };
+					const Vertex& v1{ vertices[indices[t * 3 + 1]] };
+					const Vertex& v2{ vertices[indices[t * 3 + 2]] };
+					const float area{ Vector3::Cross(v1.position - v0.position, v2.position - v0.position).Magnitude() * 0.5f };
+					cluster.center += (v0.position + v1.position + v2.position) * (area / 3.0f);
+					cluster.normal += (v0.normal + v1.normal + v2.normal) * area;
+					cluster.area   += area;
+				}
+				meshCenter += cluster.center;
+				meshArea   += cluster.area;
+				if (cluster.area > 0.0f)
+					cluster.center = cluster.center / cluster.area;
+			}
+			if (meshArea > 0.0f)
+				meshCenter = meshCenter / meshArea;
+
+			std::vector<float> sortKeys(clusters.size());
+			for (size_t c{}; c < clusters.size(); ++c)
+			{
+				const float normalLength{ clusters[c].normal.Magnitude() };
+				sortKeys[c] = normalLength > 0.0f ? Vector3::Dot(clusters[c].center - meshCenter, clusters[c].normal / normalLength) : -FLT_MAX;
+			}
+			std::vector<size_t> order(clusters.size());
+			std::iota(order.begin(), order.end(), size_t{});
+			std::ranges::stable_sort(order, [&sortKeys](size_t a, size_t b) { return sortKeys[a] > sortKeys[b]; });
+
+			std::vector<uint32_t> sorted{};
+			sorted.reserve(indices.size());
+			for (const size_t c : order)
+				sorted.insert(sorted.end(), indices.begin() + clusters[c].first * 3, indices.begin() + clusters[c].end * 3);
+			return sorted;
+		}
+
+		//Vertices numbered in the order the triangles first use them, so the vertex fetches walk forward through memory
+		void RemapInFirstUseOrder(Mesh& mesh)
+		{
+			constexpr uint32_t unused{ UINT32_MAX };
+			std::vector<uint32_t> remap(mesh.vertices.size(), unused);
+			std::vector<Vertex> vertices{};
+			vertices.reserve(mesh.vertices.size());
+			for (uint32_t& index : mesh.indices)
+			{
+				if (remap[index] == unused)
+				{
+					remap[index] = uint32_t(vertices.size());
+					vertices.push_back(mesh.vertices[index]);
+				}
+				index = remap[index];
+			}
+			mesh.vertices = std::move(vertices);
+		}
+
+		void RasterizeDepth(const Vector3 (&points)[3], int resolution, std::vector<float>& depth, size_t& shadedPixels)
+		{
+			const float area{ Vector2::Cross({ points[1].x - points[0].x, points[1].y - points[0].y }, { points[2].x - points[0].x, points[2].y - points[0].y }) };
+			if (std::abs(area) < FLT_EPSILON)
+				return;
+
+			const int left{ std::max(int(std::floor(std::min({ points[0].x, points[1].x, points[2].x }))), 0) };
+			const int top{ std::max(int(std::floor(std::min({ points[0].y, points[1].y, points[2].y }))), 0) };
+			const int right{ std::min(int(std::ceil(std::max({ points[0].x, points[1].x, points[2].x }))), resolution - 1) };
+			const int bottom{ std::min(int(std::ceil(std::max({ points[0].y, points[1].y, points[2].y }))), resolution - 1) };
+			for (int y{ top }; y <= bottom; ++y)
+			{
+				for (int x{ left }; x <= right; ++x)
+				{
+					const Vector2 center{ x + 0.5f, y + 0.5f };
+					const float W0{ Vector2::Cross({ points[2].x - points[1].x, points[2].y - points[1].y }, { center.x - points[1].x, center.y - points[1].y }) / area };
+					const float W1{ Vector2::Cross({ points[0].x - points[2].x, points[0].y - points[2].y }, { center.x - points[2].x, center.y - points[2].y }) / area };
+					const float W2{ 1.0f - W0 - W1 };
+					if (W0 < 0.0f || W1 < 0.0f || W2 < 0.0f)
+						continue;
+
+					float& pixelDepth{ depth[size_t(y) * resolution + x] };
+					const float pointDepth{ points[0].z * W0 + points[1].z * W1 + points[2].z * W2 };
+					if (pointDepth < pixelDepth)
+					{
+						pixelDepth = pointDepth;
+						++shadedPixels;
+					}
+				}
+			}
+		}
+	}
+
+	void MeshOptimizer::Optimize(Mesh& mesh, Report* pReport)
+	{
+		if (mesh.primitiveTopology != PrimitiveTopology::TriangleList || mesh.indices.size() < 3)
+			return;
+
+		const int reportCacheSize{ 16 };
+		if (pReport)
+		{
+			pReport->vertexCountBefore = mesh.vertices.size();
+			pReport->acmrBefore        = CalculateAcmr(mesh.indices, mesh.vertices.size(), reportCacheSize);
+			pReport->overdrawBefore    = CalculateOverdraw(mesh);
+		}
+
+		WeldVertices(mesh);
+		mesh.indices = OrderForVertexCache(mesh.indices, mesh.vertices.size());
+		mesh.indices = SortClustersForOverdraw(mesh.vertices, mesh.indices, reportCacheSize);
+		RemapInFirstUseOrder(mesh);
+
+		if (pReport)
+		{
+			pReport->vertexCountAfter = mesh.vertices.size();
+			pReport->acmrAfter        = CalculateAcmr(mesh.indices, mesh.vertices.size(), reportCacheSize);
+			pReport->overdrawAfter    = CalculateOverdraw(mesh);
+		}
+	}
+
+	float MeshOptimizer::CalculateAcmr(const std::vector<uint32_t>& indices, size_t vertexCount, int cacheSize)
+	{
+		if (indices.size() < 3)
+			return 0.0f;
+
+		//FIFO, a vertex is still cached while fewer than cacheSize misses came after it
+		std::vector<uint32_t> insertTimes(vertexCount);
+		uint32_t time{ uint32_t(cacheSize) + 1 };
+		size_t misses{};
+		for (const uint32_t index : indices)
+		{
+			if (time - insertTimes[index] > uint32_t(cacheSize))
+			{
+				insertTimes[index] = time++;
+				++misses;
+			}
+		}
+		return float(misses) / (indices.size() / 3);
+	}
+
+	float MeshOptimizer::CalculateOverdraw(const Mesh& mesh, int resolution)
+	{
+		std::vector<Vector3> directions{ Vector3::UnitX, -Vector3::UnitX, Vector3::UnitY, -Vector3::UnitY, Vector3::UnitZ, -Vector3::UnitZ };
+		for (int corner{}; corner < 8; ++corner)
+			directions.push_back(Vector3{ (corner & 1) ? 1.0f : -1.0f, (corner & 2) ? 1.0f : -1.0f, (corner & 4) ? 1.0f : -1.0f }.Normalized());
+
+		size_t shadedPixels{}, coveredPixels{};
+		std::vector<float> depth(size_t(resolution) * resolution);
+		std::vector<Vector3> projected(mesh.vertices.size());
+		for (const Vector3& direction : directions)
+		{
+			//Orthographic, x and y across the view fitted to the grid, z along it
+			const Vector3 up{ std::abs(direction.y) > 0.99f ? Vector3::UnitZ : Vector3::UnitY };
+			const Vector3 right{ Vector3::Cross(up, direction).Normalized() };
+			const Vector3 viewUp{ Vector3::Cross(direction, right) };
+			float minX{ FLT_MAX }, minY{ FLT_MAX }, maxX{ -FLT_MAX }, maxY{ -FLT_MAX };
+			for (size_t i{}; i < mesh.vertices.size(); ++i)
+			{
+				const Vector3& position{ mesh.vertices[i].position };
+				projected[i] = { Vector3::Dot(position, right), Vector3::Dot(position, viewUp), Vector3::Dot(position, direction) };
+				minX = std::min(minX, projected[i].x);
+				minY = std::min(minY, projected[i].y);
+				maxX = std::max(maxX, projected[i].x);
+				maxY = std::max(maxY, projected[i].y);
+			}
+			const float scale{ resolution / std::max(std::max(maxX - minX, maxY - minY), FLT_EPSILON) };
+
+			std::ranges::fill(depth, FLT_MAX);
+			for (size_t t{}; t + 2 < mesh.indices.size(); t += 3)
+			{
+				const uint32_t corners[3]{ mesh.indices[t], mesh.indices[t + 1], mesh.indices[t + 2] };
+				const Vector3 normal{ mesh.vertices[corners[0]].normal + mesh.vertices[corners[1]].normal + mesh.vertices[corners[2]].normal };
+				if (Vector3::Dot(normal, direction) >= 0.0f)
+					continue;
+
+				Vector3 points[3]{};
+				for (int i{}; i < 3; ++i)
+					points[i] = { (projected[corners[i]].x - minX) * scale, (projected[corners[i]].y - minY) * scale, projected[corners[i]].z };
+				RasterizeDepth(points, resolution, depth, shadedPixels);
+			}
+			coveredPixels += std::ranges::count_if(depth, [](float value) { return value < FLT_MAX; });
+		}
+		return coveredPixels > 0 ? float(shadedPixels) / coveredPixels : 0.0f;
+	}
+}
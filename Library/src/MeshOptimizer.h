@@ -0,0 +1,33 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+#include "DataTypes.h"
+
+namespace dae
+{
+	//Load time reordering off triangle lists, strips are left as they are
+	//Welds the vertices the OBJ corners share, orders the triangles for the vertex cache (Forsyth), sorts clusters off them
+	//so the outward facing ones come first (Tipsify style), and finally numbers the vertices in first use order
+	namespace MeshOptimizer
+	{
+		struct Report
+		{
+			size_t vertexCountBefore{};
+			size_t vertexCountAfter{};
+			float acmrBefore{};
+			float acmrAfter{};
+			float overdrawBefore{};
+			float overdrawAfter{};
+		};
+
+		//pReport costs an overdraw measurement before and after
+		void Optimize(Mesh& mesh, Report* pReport = nullptr);
+
+		//Average cache miss ratio, vertices transformed per triangle with a FIFO post-transform cache, 0.5 to 3
+		float CalculateAcmr(const std::vector<uint32_t>& indices, size_t vertexCount, int cacheSize = 16);
+		//Shaded pixels per covered pixel with depth test and back face culling, averaged over orthographic views
+		//from the 6 axes and the 8 diagonals around the mesh, 1 is no overdraw
+		float CalculateOverdraw(const Mesh& mesh, int resolution = 256);
+	}
+}
@@ -0,0 +1,164 @@
+#include "MeshPack.h"
+#include <algorithm>
+#include <cstdio>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include "Utils.h"
+
+namespace dae
+{
+	namespace
+	{
+		struct MeshPackHeader
+		{
+			char magic[4]{ 'M', 'P', 'A', 'K' };
+			uint32_t version{ 2 }; //2: meshes are welded and reordered
+			uint32_t vertexSize{ sizeof(Vertex) }; //a pack only matches the Vertex layout it was written with
+			uint32_t meshCount{};
+			uint32_t flippedAxisAndWinding{};
+		};
+
+		//Buffers start on a 16 byte boundary inside the mapping
+		constexpr uint64_t BufferAlignment{ 16 };
+
+		uint64_t AlignOffset(uint64_t offset)
+		{
+			return (offset + BufferAlignment - 1) / BufferAlignment * BufferAlignment;
+		}
+	}
+
+	bool MeshPack::Write(const std::string& path, const std::vector<Mesh>& meshes, bool flippedAxisAndWinding)
+	{
+		//Header, entry table, then every vertex and index buffer
+		MeshPackHeader header{};
+		header.meshCount             = uint32_t(meshes.size());
+		header.flippedAxisAndWinding = flippedAxisAndWinding;
+
+		std::vector<Entry> entries(meshes.size());
+		uint64_t offset{ sizeof(MeshPackHeader) + entries.size() * sizeof(Entry) };
+		for (size_t i{}; i < meshes.size(); ++i)
+		{
+			Entry& entry{ entries[i] };
+			entry.vertexOffset      = AlignOffset(offset);
+			entry.vertexCount       = meshes[i].vertices.size();
+			entry.indexOffset       = AlignOffset(entry.vertexOffset + entry.vertexCount * sizeof(Vertex));
+			entry.indexCount        = meshes[i].indices.size();
+			entry.primitiveTopology = uint32_t(meshes[i].primitiveTopology);
+			entry.minBounds         = meshes[i].minBounds;
+			entry.maxBounds         = meshes[i].maxBounds;
+			offset = entry.indexOffset + entry.indexCount * sizeof(uint32_t);
+		}
+
+		std::ofstream file{ path, std::ios::binary };
+		if (!file)
+		{
+			printf("Unable to write mesh pack %s\n", path.c_str());
+			return false;
+		}
+
+		const auto writePadded = [&file](uint64_t offset, const void* pData, size_t size)
+			{
+				const char padding[BufferAlignment]{};
+				file.write(padding, std::streamsize(offset - uint64_t(file.tellp())));
+				file.write(static_cast<const char*>(pData), std::streamsize(size));
+			};
+		file.write(reinterpret_cast<const char*>(&header), sizeof(header));
+		file.write(reinterpret_cast<const char*>(entries.data()), std::streamsize(entries.size() * sizeof(Entry)));
+		for (size_t i{}; i < meshes.size(); ++i)
+		{
+			writePadded(entries[i].vertexOffset, meshes[i].vertices.data(), meshes[i].vertices.size() * sizeof(Vertex));
+			writePadded(entries[i].indexOffset, meshes[i].indices.data(), meshes[i].indices.size() * sizeof(uint32_t));
+		}
+		return bool(file);
+	}
+
+	bool MeshPack::LoadObj(const std::string& objPath, Mesh& mesh, bool flipAxisAndWinding, ConversionReport* pReport)
+	{
+		//Same staleness rule as the texture caches, a pack older than its OBJ is converted again
+		const std::string packPath{ objPath + ".pack" };
+		std::error_code error{};
+		const auto packTime{ std::filesystem::last_write_time(packPath, error) };
+		if (!error && !(packTime < std::filesystem::last_write_time(objPath, error)) && !error)
+		{
+			const MeshPack pack{ packPath };
+			if (pack.IsLoaded() && pack.GetMeshCount() == 1 && pack.IsFlippedAxisAndWinding() == flipAxisAndWinding)
+			{
+				mesh = pack.GetMesh(0);
+				return true;
+			}
+		}
+
+		Mesh parsedMesh{};
+		if (!ObjParser::Parse(objPath, parsedMesh.vertices, parsedMesh.indices, flipAxisAndWinding, pReport ? &pReport->parsing : nullptr))
+			return false;
+		parsedMesh.primitiveTopology = PrimitiveTopology::TriangleList;
+		Utils::CalculateBounds(parsedMesh.vertices, parsedMesh.minBounds, parsedMesh.maxBounds);
+		MeshOptimizer::Optimize(parsedMesh, pReport ? &pReport->optimization : nullptr);
+
+		//A pack that can not be written only costs the next run a parse
+		Write(packPath, { parsedMesh }, flipAxisAndWinding);
+		mesh = std::move(parsedMesh);
+		return true;
+	}
+
+	MeshPack::MeshPack(const std::string& path) :
+		m_File{ path }
+	{
+		MeshPackHeader header{};
+		const MeshPackHeader expected{};
+		const size_t size{ m_File.GetSize() };
+		if (!m_File.IsOpen() || size < sizeof(header))
+			return;
+
+		std::memcpy(&header, m_File.GetData(), sizeof(header));
+		if (!std::equal(header.magic, header.magic + 4, expected.magic)
+			|| header.version != expected.version
+			|| header.vertexSize != expected.vertexSize
+			|| size < sizeof(header) + uint64_t(header.meshCount) * sizeof(Entry))
+			return;
+
+		std::vector<Entry> entries(header.meshCount);
+		std::memcpy(entries.data(), m_File.GetData() + sizeof(header), entries.size() * sizeof(Entry));
+
+		//Every buffer has to lie inside the file and be aligned for its type
+		const bool isValid{ std::ranges::all_of(entries, [size](const Entry& entry)
+			{
+				return entry.vertexOffset % BufferAlignment == 0 && entry.indexOffset % BufferAlignment == 0
+					&& entry.vertexCount <= (size - std::min<uint64_t>(entry.vertexOffset, size)) / sizeof(Vertex)
+					&& entry.indexCount <= (size - std::min<uint64_t>(entry.indexOffset, size)) / sizeof(uint32_t);
+			}) };
+		if (!isValid)
+			return;
+
+		m_Entries               = std::move(entries);
+		m_FlippedAxisAndWinding = header.flippedAxisAndWinding != 0;
+	}
+
+	std::span<const Vertex> MeshPack::GetVertices(size_t mesh) const
+	{
+		const Entry& entry{ m_Entries[mesh] };
+		return { reinterpret_cast<const Vertex*>(m_File.GetData() + entry.vertexOffset), size_t(entry.vertexCount) };
+	}
+
+	std::span<const uint32_t> MeshPack::GetIndices(size_t mesh) const
+	{
+		const Entry& entry{ m_Entries[mesh] };
+		return { reinterpret_cast<const uint32_t*>(m_File.GetData() + entry.indexOffset), size_t(entry.indexCount) };
+	}
+
+	Mesh MeshPack::GetMesh(size_t mesh) const
+	{
+		const Entry& entry{ m_Entries[mesh] };
+		const std::span<const Vertex> vertices{ GetVertices(mesh) };
+		const std::span<const uint32_t> indices{ GetIndices(mesh) };
+
+		Mesh result{};
+		result.vertices.assign(vertices.begin(), vertices.end());
+		result.indices.assign(indices.begin(), indices.end());
+		result.primitiveTopology = PrimitiveTopology(entry.primitiveTopology);
+		result.minBounds         = entry.minBounds;
+		result.maxBounds         = entry.maxBounds;
+		return result;
+	}
+}
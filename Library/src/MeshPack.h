@@ -0,0 +1,69 @@
+#pragma once
+#include <cstddef>
+#include <span>
+#include <string>
+#include <vector>
+#include "DataTypes.h"
+#include "MappedFile.h"
+#include "MeshOptimizer.h"
+#include "ObjParser.h"
+
+namespace dae
+{
+	//Versioned binary pack off meshes in the in-memory layout off Mesh: vertices with their tangents, indices, topology and bounds
+	//A pack is mapped on load, the buffers are read straight from the mapping without parsing anything
+	//The mapping only saves the parse: Mesh owns its buffers, so GetMesh and LoadObj still copy every vertex and index once,
+	//only GetVertices and GetIndices read without a copy
+	class MeshPack final
+	{
+	public:
+		//What the OBJ conversion measured, only filled in when the OBJ had to be parsed
+		struct ConversionReport
+		{
+			ObjParser::Statistics parsing{};
+			MeshOptimizer::Report optimization{};
+		};
+
+		//Returns false when the file can not be written
+		static bool Write(const std::string& path, const std::vector<Mesh>& meshes, bool flippedAxisAndWinding = true);
+		//Mesh from the pack at objPath + ".pack", the pack is converted from the OBJ first when it is missing or older
+		//A mesh read from the pack is copied out off the mapping, which is closed again before this returns
+		//Converted meshes are welded and reordered by MeshOptimizer before they are written
+		static bool LoadObj(const std::string& objPath, Mesh& mesh, bool flipAxisAndWinding = true, ConversionReport* pReport = nullptr);
+
+		explicit MeshPack(const std::string& path);
+		~MeshPack() = default;
+
+		MeshPack(const MeshPack&) = delete;
+		MeshPack(MeshPack&&) noexcept = delete;
+		MeshPack& operator=(const MeshPack&) = delete;
+		MeshPack& operator=(MeshPack&&) noexcept = delete;
+
+		//False when the file is missing or truncated, or was written by another version or for another Vertex layout
+		bool IsLoaded() const { return !m_Entries.empty(); }
+		bool IsFlippedAxisAndWinding() const { return m_FlippedAxisAndWinding; }
+		size_t GetMeshCount() const { return m_Entries.size(); }
+
+		//Views into the mapping, valid as long as the pack
+		std::span<const Vertex> GetVertices(size_t mesh) const;
+		std::span<const uint32_t> GetIndices(size_t mesh) const;
+		//Copies the buffers out off the mapping, one block copy each, for users that keep the mesh after the pack is gone
+		Mesh GetMesh(size_t mesh) const;
+
+	private:
+		struct Entry
+		{
+			uint64_t vertexOffset{};
+			uint64_t vertexCount{};
+			uint64_t indexOffset{};
+			uint64_t indexCount{};
+			uint32_t primitiveTopology{};
+			Vector3 minBounds{};
+			Vector3 maxBounds{};
+		};
+
+		MappedFile m_File;
+		std::vector<Entry> m_Entries{};
+		bool m_FlippedAxisAndWinding{};
+	};
+}
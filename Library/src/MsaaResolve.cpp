@@ -0,0 +1,44 @@
+#include "MsaaResolve.h"
+#include <emmintrin.h>
+
+namespace dae
+{
+	uint32_t MsaaResolve::ResolveEdgePixel(const MsaaEdgePixel& edge)
+	{
+		//Widen every channel to 16 bit, sum, round and divide by 4
+		const __m128i zero{ _mm_setzero_si128() };
+		const __m128i samples{ _mm_loadu_si128(reinterpret_cast<const __m128i*>(edge.samples)) };
+		__m128i sum{ _mm_add_epi16(_mm_unpacklo_epi8(samples, zero), _mm_unpackhi_epi8(samples, zero)) };
+		sum = _mm_add_epi16(sum, _mm_srli_si128(sum, 8));
+		sum = _mm_srli_epi16(_mm_add_epi16(sum, _mm_set1_epi16(2)), 2);
+
+		return uint32_t(_mm_cvtsi128_si32(_mm_packus_epi16(sum, zero)));
+	}
+
+	void MsaaResolve::ResolveRow(const uint32_t* pColors, const uint32_t* pEdgeIndices, const MsaaEdgePixel* pEdges, uint32_t* pDestination, int count)
+	{
+		const auto resolvePixel = [=](int pxl)
+			{
+				const uint32_t edgeIndex{ pEdgeIndices[pxl] };
+				return edgeIndex == NoEdge ? pColors[pxl] : ResolveEdgePixel(pEdges[edgeIndex]);
+			};
+
+		const __m128i noEdge{ _mm_set1_epi32(int(NoEdge)) };
+		int pxl{};
+		for (; pxl + 4 <= count; pxl += 4)
+		{
+			const __m128i edgeIndices{ _mm_loadu_si128(reinterpret_cast<const __m128i*>(&pEdgeIndices[pxl])) };
+			if (_mm_movemask_epi8(_mm_cmpeq_epi32(edgeIndices, noEdge)) == 0xFFFF)
+			{
+				_mm_storeu_si128(reinterpret_cast<__m128i*>(&pDestination[pxl]), _mm_loadu_si128(reinterpret_cast<const __m128i*>(&pColors[pxl])));
+				continue;
+			}
+
+			for (int i{}; i < 4; ++i)
+				pDestination[pxl + i] = resolvePixel(pxl + i);
+		}
+
+		for (; pxl < count; ++pxl)
+			pDestination[pxl] = resolvePixel(pxl);
+	}
+}
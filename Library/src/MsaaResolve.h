@@ -0,0 +1,24 @@
+#pragma once
+#include <cstdint>
+
+namespace dae
+{
+	//Per sample colors off a pixel that is only partially covered by its last triangle
+	struct MsaaEdgePixel
+	{
+		uint32_t samples[4]{};
+	};
+
+	//4x MSAA resolve, fully covered pixels store one color and only edge pixels point into a pool off sample colors
+	namespace MsaaResolve
+	{
+		//Edge index off a pixel without its own samples
+		constexpr uint32_t NoEdge{ 0xFFFFFFFF };
+
+		//Box filters the 4 samples, every 8 bit channel rounded to nearest
+		uint32_t ResolveEdgePixel(const MsaaEdgePixel& edge);
+
+		//Resolves count pixels off one row, 4 pixels without edges at a time are copied straight through
+		void ResolveRow(const uint32_t* pColors, const uint32_t* pEdgeIndices, const MsaaEdgePixel* pEdges, uint32_t* pDestination, int count);
+	}
+}
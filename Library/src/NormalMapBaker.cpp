@@ -0,0 +1,119 @@
+#include "NormalMapBaker.h"
+#include <algorithm>
+#include <cmath>
+#include "Texture.h"
+
+namespace dae
+{
+	namespace
+	{
+		uint32_t EncodeNormal(const Vector3& normal)
+		{
+			const auto toByte = [](float value) { return uint32_t(std::lround(Saturate(value * 0.5f + 0.5f) * 255.0f)); };
+			return toByte(normal.x) | (toByte(normal.y) << 8) | (toByte(normal.z) << 16) | 0xFF000000u;
+		}
+	}
+
+	Texture* NormalMapBaker::BakeObjectSpace(const Texture& tangentSpaceMap, const Mesh& mesh, Report* pReport)
+	{
+		const int width{ tangentSpaceMap.GetWidth() };
+		const int height{ tangentSpaceMap.GetHeight() };
+		std::vector<Vector3> normals(size_t(width) * height);
+		std::vector<bool> covered(normals.size());
+		//Triangles with the texel center strictly inside, texels on an edge shared by 2 triangles are not an overlap
+		std::vector<uint8_t> claims(normals.size());
+		constexpr float edgeTolerance{ 1e-4f };
+
+		const bool isStrip{ mesh.primitiveTopology == PrimitiveTopology::TriangleStrip };
+		const size_t increment{ isStrip ? 1u : 3u };
+		bool hasTriangles{ false };
+		for (size_t indc{}; indc + 2 < mesh.indices.size(); indc += increment)
+		{
+			const Vertex* pVertices[3]{ &mesh.vertices[mesh.indices[indc]], &mesh.vertices[mesh.indices[indc + 1]], &mesh.vertices[mesh.indices[indc + 2]] };
+			Vector2 texels[3]{};
+			for (int i{}; i < 3; ++i)
+				texels[i] = { pVertices[i]->uv.x * width, pVertices[i]->uv.y * height };
+
+			//Either winding, uv islands can be mirrored
+			const float area{ Vector2::Cross(texels[1] - texels[0], texels[2] - texels[0]) };
+			if (std::abs(area) < FLT_EPSILON)
+				continue;
+			hasTriangles = true;
+
+			const int left{ Clamp(int(std::floor(std::min({ texels[0].x, texels[1].x, texels[2].x }))), 0, width) };
+			const int top{ Clamp(int(std::floor(std::min({ texels[0].y, texels[1].y, texels[2].y }))), 0, height) };
+			const int right{ Clamp(int(std::ceil(std::max({ texels[0].x, texels[1].x, texels[2].x }))), 0, width) };
+			const int bottom{ Clamp(int(std::ceil(std::max({ texels[0].y, texels[1].y, texels[2].y }))), 0, height) };
+			for (int v{ top }; v < bottom; ++v)
+			{
+				for (int u{ left }; u < right; ++u)
+				{
+					const Vector2 center{ u + 0.5f, v + 0.5f };
+					const float W0{ Vector2::Cross(texels[2] - texels[1], center - texels[1]) / area };
+					const float W1{ Vector2::Cross(texels[0] - texels[2], center - texels[2]) / area };
+					const float W2{ 1.0f - W0 - W1 };
+					if (W0 < 0.0f || W1 < 0.0f || W2 < 0.0f)
+						continue;
+
+					//Same frame as the tangent space shading, interpolated and normalized, bitangent from their cross
+					const Vector3 normal{ (pVertices[0]->normal * W0 + pVertices[1]->normal * W1 + pVertices[2]->normal * W2).Normalized() };
+					const Vector3 tangent{ (pVertices[0]->tangent * W0 + pVertices[1]->tangent * W1 + pVertices[2]->tangent * W2).Normalized() };
+					const Vector3 biNormal{ Vector3::Cross(normal, tangent) };
+					const Vector3 sampled{ tangentSpaceMap.SampleNormal({ center.x / width, center.y / height }) };
+
+					const size_t index{ size_t(v) * width + u };
+					normals[index] = (tangent * sampled.x + biNormal * sampled.y + normal * sampled.z).Normalized();
+					covered[index] = true;
+					if (W0 > edgeTolerance && W1 > edgeTolerance && W2 > edgeTolerance)
+						claims[index] = uint8_t(std::min(claims[index] + 1, 2));
+				}
+			}
+		}
+
+		if (!hasTriangles)
+			return nullptr;
+		if (pReport != nullptr)
+		{
+			pReport->coveredTexels     = size_t(std::ranges::count(covered, true));
+			pReport->overlappingTexels = size_t(std::ranges::count(claims, uint8_t(2)));
+		}
+
+		//Grow the islands a few texels, the mip levels average across their borders
+		const int dilationSteps{ 8 };
+		for (int step{}; step < dilationSteps; ++step)
+		{
+			std::vector<bool> grown{ covered };
+			for (int v{}; v < height; ++v)
+			{
+				for (int u{}; u < width; ++u)
+				{
+					const size_t index{ size_t(v) * width + u };
+					if (covered[index])
+						continue;
+
+					Vector3 sum{};
+					for (int dv{ -1 }; dv <= 1; ++dv)
+					{
+						for (int du{ -1 }; du <= 1; ++du)
+						{
+							const int nu{ u + du }, nv{ v + dv };
+							if (nu >= 0 && nv >= 0 && nu < width && nv < height && covered[size_t(nv) * width + nu])
+								sum += normals[size_t(nv) * width + nu];
+						}
+					}
+					if (sum.SqrMagnitude() > 0.0f)
+					{
+						normals[index] = sum.Normalized();
+						grown[index]   = true;
+					}
+				}
+			}
+			covered = std::move(grown);
+		}
+
+		std::vector<uint32_t> texels(normals.size());
+		for (size_t i{}; i < normals.size(); ++i)
+			texels[i] = covered[i] ? EncodeNormal(normals[i]) : EncodeNormal({ 0.0f, 0.0f, 1.0f });
+		return Texture::CreateFromPixels(width, height, texels.data());
+	}
+}
@@ -0,0 +1,31 @@
+#pragma once
+#include "Maths.h"
+#include "DataTypes.h"
+
+namespace dae
+{
+	class Texture;
+
+	//Turns a tangent space normal map into an object space one for a rigid mesh, so shading needs no tangent frame
+	//The result is an RGBA8 texture with xyz encoded to [0, 1], decode it with DecodeNormal
+	namespace NormalMapBaker
+	{
+		struct Report
+		{
+			size_t coveredTexels{};
+			//Texels inside more than one triangle, from overlapping or mirrored uv islands
+			//Such a texel only holds the normal off the last triangle, so the map is wrong for the others
+			size_t overlappingTexels{};
+		};
+
+		//Every texel covered by a triangle gets the tangent space normal rotated by the interpolated frame off that triangle,
+		//uncovered texels around the uv islands are filled from their neighbours so filtering does not pull in garbage
+		//Returns nullptr when the mesh has no triangles
+		Texture* BakeObjectSpace(const Texture& tangentSpaceMap, const Mesh& mesh, Report* pReport = nullptr);
+
+		inline Vector3 DecodeNormal(const ColorRGB& encoded)
+		{
+			return { encoded.r * 2.0f - 1.0f, encoded.g * 2.0f - 1.0f, encoded.b * 2.0f - 1.0f };
+		}
+	}
+}
@@ -0,0 +1,317 @@
+#include "ObjParser.h"
+#include <algorithm>
+#include <array>
+#include <charconv>
+#include <chrono>
+#include <cstring>
+#include <thread>
+#include "MappedFile.h"
+
+namespace dae
+{
+	namespace
+	{
+		//Smaller chunks are not worth a thread
+		constexpr size_t MinChunkSize{ 256 * 1024 };
+
+		enum class RecordType
+		{
+			Other,
+			Position,
+			TexCoord,
+			Normal,
+			Face
+		};
+
+		//0 based, -1 when the face does not have it
+		struct Corner
+		{
+			int position{ -1 };
+			int texCoord{ -1 };
+			int normal{ -1 };
+		};
+		using Face = std::array<Corner, 3>;
+
+		struct Chunk
+		{
+			const char* pBegin{};
+			const char* pEnd{};
+			//Records in the chunk, then where its first record goes in the merged arrays
+			size_t positionCount{}, texCoordCount{}, normalCount{}, faceCount{};
+			size_t firstPosition{}, firstTexCoord{}, firstNormal{}, firstFace{};
+			bool isValid{ true };
+		};
+
+		bool IsSpace(char c)
+		{
+			return c == ' ' || c == '\t';
+		}
+
+		const char* SkipSpaces(const char* p, const char* pEnd)
+		{
+			while (p < pEnd && IsSpace(*p))
+				++p;
+			return p;
+		}
+
+		const char* NextLine(const char* p, const char* pEnd)
+		{
+			const void* pNewLine{ std::memchr(p, '\n', size_t(pEnd - p)) };
+			return pNewLine ? static_cast<const char*>(pNewLine) + 1 : pEnd;
+		}
+
+		//Moves p past the keyword off the line
+		RecordType ReadRecordType(const char*& p, const char* pEnd)
+		{
+			p = SkipSpaces(p, pEnd);
+			const size_t length{ size_t(pEnd - p) };
+			if (length >= 2 && p[0] == 'v' && IsSpace(p[1]))
+			{
+				p += 2;
+				return RecordType::Position;
+			}
+			if (length >= 3 && p[0] == 'v' && (p[1] == 't' || p[1] == 'n') && IsSpace(p[2]))
+			{
+				p += 3;
+				return p[-2] == 't' ? RecordType::TexCoord : RecordType::Normal;
+			}
+			if (length >= 2 && p[0] == 'f' && IsSpace(p[1]))
+			{
+				p += 2;
+				return RecordType::Face;
+			}
+			return RecordType::Other;
+		}
+
+		bool ReadFloat(const char*& p, const char* pEnd, float& value)
+		{
+			p = SkipSpaces(p, pEnd);
+			//from_chars does not take a plus sign
+			if (p < pEnd && *p == '+')
+				++p;
+			const auto [pNext, error] { std::from_chars(p, pEnd, value) };
+			p = pNext;
+			return error == std::errc{};
+		}
+
+		bool ReadIndex(const char*& p, const char* pEnd, int& value)
+		{
+			p = SkipSpaces(p, pEnd);
+			const auto [pNext, error] { std::from_chars(p, pEnd, value) };
+			p = pNext;
+			return error == std::errc{} && value != 0;
+		}
+
+		//OBJ counts from 1, negative indices count back from the last record read
+		int ResolveIndex(int index, size_t recordsRead)
+		{
+			return index > 0 ? index - 1 : int(recordsRead) + index;
+		}
+
+		void CountRecords(Chunk& chunk)
+		{
+			for (const char* pLine{ chunk.pBegin }; pLine < chunk.pEnd; pLine = NextLine(pLine, chunk.pEnd))
+			{
+				const char* p{ pLine };
+				switch (ReadRecordType(p, chunk.pEnd))
+				{
+				case RecordType::Position: ++chunk.positionCount; break;
+				case RecordType::TexCoord: ++chunk.texCoordCount; break;
+				case RecordType::Normal:   ++chunk.normalCount;   break;
+				case RecordType::Face:     ++chunk.faceCount;     break;
+				default: break;
+				}
+			}
+		}
+
+		//Writes the records off the chunk at its offsets, faces keep resolved indices
+		void ParseRecords(Chunk& chunk, std::vector<Vector3>& positions, std::vector<Vector2>& texCoords, std::vector<Vector3>& normals, std::vector<Face>& faces)
+		{
+			size_t position{ chunk.firstPosition }, texCoord{ chunk.firstTexCoord }, normal{ chunk.firstNormal }, face{ chunk.firstFace };
+			for (const char* pLine{ chunk.pBegin }; pLine < chunk.pEnd && chunk.isValid; pLine = NextLine(pLine, chunk.pEnd))
+			{
+				const char* p{ pLine };
+				switch (ReadRecordType(p, chunk.pEnd))
+				{
+				case RecordType::Position:
+				{
+					Vector3& value{ positions[position++] };
+					chunk.isValid = ReadFloat(p, chunk.pEnd, value.x) && ReadFloat(p, chunk.pEnd, value.y) && ReadFloat(p, chunk.pEnd, value.z);
+					break;
+				}
+				case RecordType::TexCoord:
+				{
+					float u{}, v{};
+					chunk.isValid = ReadFloat(p, chunk.pEnd, u) && ReadFloat(p, chunk.pEnd, v);
+					texCoords[texCoord++] = { u, 1 - v };
+					break;
+				}
+				case RecordType::Normal:
+				{
+					Vector3& value{ normals[normal++] };
+					chunk.isValid = ReadFloat(p, chunk.pEnd, value.x) && ReadFloat(p, chunk.pEnd, value.y) && ReadFloat(p, chunk.pEnd, value.z);
+					break;
+				}
+				case RecordType::Face:
+				{
+					//position, position/uv, position//normal or position/uv/normal, corners after the third are ignored
+					for (Corner& corner : faces[face++])
+					{
+						int index{};
+						chunk.isValid = ReadIndex(p, chunk.pEnd, index);
+						if (!chunk.isValid)
+							break;
+						corner.position = ResolveIndex(index, position);
+
+						if (p < chunk.pEnd && *p == '/')
+						{
+							++p;
+							if (p < chunk.pEnd && *p != '/' && ReadIndex(p, chunk.pEnd, index))
+								corner.texCoord = ResolveIndex(index, texCoord);
+							if (p < chunk.pEnd && *p == '/' && ReadIndex(++p, chunk.pEnd, index))
+								corner.normal = ResolveIndex(index, normal);
+						}
+					}
+					break;
+				}
+				default:
+					break;
+				}
+			}
+		}
+
+		//One vertex per corner, a corner without uv or normal keeps the one off the corner before it
+		void MergeFaces(Chunk& chunk, const std::vector<Vector3>& positions, const std::vector<Vector2>& texCoords, const std::vector<Vector3>& normals,
+			const std::vector<Face>& faces, bool flipAxisAndWinding, std::vector<Vertex>& vertices, std::vector<uint32_t>& indices)
+		{
+			const auto isInRange = [](int index, size_t count) { return index >= 0 && size_t(index) < count; };
+			for (size_t face{ chunk.firstFace }; face < chunk.firstFace + chunk.faceCount && chunk.isValid; ++face)
+			{
+				const uint32_t firstVertex{ uint32_t(face * 3) };
+				Vertex vertex{};
+				for (uint32_t i{}; i < 3; ++i)
+				{
+					const Corner& corner{ faces[face][i] };
+					chunk.isValid = isInRange(corner.position, positions.size())
+						&& (corner.texCoord < 0 || isInRange(corner.texCoord, texCoords.size()))
+						&& (corner.normal < 0 || isInRange(corner.normal, normals.size()));
+					if (!chunk.isValid)
+						return;
+
+					vertex.position = positions[corner.position];
+					if (corner.texCoord >= 0)
+						vertex.uv = texCoords[corner.texCoord];
+					if (corner.normal >= 0)
+						vertex.normal = normals[corner.normal];
+					vertices[firstVertex + i] = vertex;
+				}
+
+				indices[face * 3]     = firstVertex;
+				indices[face * 3 + 1] = flipAxisAndWinding ? firstVertex + 2 : firstVertex + 1;
+				indices[face * 3 + 2] = flipAxisAndWinding ? firstVertex + 1 : firstVertex + 2;
+
+				//Cheap tangent, no vertex is shared so the one off its triangle is the whole sum
+				Vertex& v0{ vertices[indices[face * 3]] };
+				Vertex& v1{ vertices[indices[face * 3 + 1]] };
+				Vertex& v2{ vertices[indices[face * 3 + 2]] };
+				const Vector3 edge0{ v1.position - v0.position };
+				const Vector3 edge1{ v2.position - v0.position };
+				const Vector2 diffX{ v1.uv.x - v0.uv.x, v2.uv.x - v0.uv.x };
+				const Vector2 diffY{ v1.uv.y - v0.uv.y, v2.uv.y - v0.uv.y };
+				const float r{ 1.f / Vector2::Cross(diffX, diffY) };
+				const Vector3 tangent{ (edge0 * diffY.y - edge1 * diffY.x) * r };
+
+				for (Vertex* pVertex : { &v0, &v1, &v2 })
+				{
+					pVertex->tangent = Vector3::Reject(tangent, pVertex->normal).Normalized();
+					if (flipAxisAndWinding)
+					{
+						pVertex->position.z *= -1.f;
+						pVertex->normal.z   *= -1.f;
+						pVertex->tangent.z  *= -1.f;
+					}
+				}
+			}
+		}
+
+		//One thread per chunk, the first chunk runs on the calling thread
+		template<typename Function>
+		void ForEachChunk(std::vector<Chunk>& chunks, const Function& function)
+		{
+			std::vector<std::thread> threads{};
+			threads.reserve(chunks.size() - 1);
+			for (size_t i{ 1 }; i < chunks.size(); ++i)
+				threads.emplace_back([&function, &chunk = chunks[i]]() { function(chunk); });
+			function(chunks[0]);
+			for (std::thread& thread : threads)
+				thread.join();
+		}
+	}
+
+	bool ObjParser::Parse(const std::string& filename, std::vector<Vertex>& vertices, std::vector<uint32_t>& indices, bool flipAxisAndWinding, Statistics* pStatistics)
+	{
+		const MappedFile file{ filename };
+		if (!file.IsOpen())
+			return false;
+		return Parse(file.GetData(), file.GetSize(), vertices, indices, flipAxisAndWinding, pStatistics);
+	}
+
+	bool ObjParser::Parse(const char* pText, size_t size, std::vector<Vertex>& vertices, std::vector<uint32_t>& indices, bool flipAxisAndWinding, Statistics* pStatistics)
+	{
+		const auto start{ std::chrono::high_resolution_clock::now() };
+		vertices.clear();
+		indices.clear();
+
+		//Chunk borders are moved to the start off the next line
+		const size_t chunkCount{ std::clamp(size_t(std::thread::hardware_concurrency()), size_t(1), size / MinChunkSize + 1) };
+		const char* pEnd{ pText + size };
+		std::vector<Chunk> chunks(chunkCount);
+		for (size_t i{}; i < chunkCount; ++i)
+		{
+			chunks[i].pBegin = i == 0 ? pText : std::max(NextLine(pText + size * i / chunkCount - 1, pEnd), chunks[i - 1].pBegin);
+			if (i > 0)
+				chunks[i - 1].pEnd = chunks[i].pBegin;
+		}
+		chunks.back().pEnd = pEnd;
+
+		ForEachChunk(chunks, CountRecords);
+
+		Chunk total{};
+		for (Chunk& chunk : chunks)
+		{
+			chunk.firstPosition = total.positionCount;
+			chunk.firstTexCoord = total.texCoordCount;
+			chunk.firstNormal   = total.normalCount;
+			chunk.firstFace     = total.faceCount;
+			total.positionCount += chunk.positionCount;
+			total.texCoordCount += chunk.texCoordCount;
+			total.normalCount   += chunk.normalCount;
+			total.faceCount     += chunk.faceCount;
+		}
+
+		std::vector<Vector3> positions(total.positionCount);
+		std::vector<Vector2> texCoords(total.texCoordCount);
+		std::vector<Vector3> normals(total.normalCount);
+		std::vector<Face> faces(total.faceCount);
+		ForEachChunk(chunks, [&](Chunk& chunk) { ParseRecords(chunk, positions, texCoords, normals, faces); });
+
+		//Faces can point into every chunk, so they are only turned into vertices once all records are read
+		vertices.resize(total.faceCount * 3);
+		indices.resize(total.faceCount * 3);
+		ForEachChunk(chunks, [&](Chunk& chunk) { MergeFaces(chunk, positions, texCoords, normals, faces, flipAxisAndWinding, vertices, indices); });
+
+		if (pStatistics)
+		{
+			const std::chrono::duration<float, std::milli> duration{ std::chrono::high_resolution_clock::now() - start };
+			*pStatistics = { size, int(chunkCount), duration.count() };
+		}
+
+		if (std::ranges::any_of(chunks, [](const Chunk& chunk) { return !chunk.isValid; }))
+		{
+			vertices.clear();
+			indices.clear();
+			return false;
+		}
+		return true;
+	}
+}
@@ -0,0 +1,27 @@
+#pragma once
+#include <cstddef>
+#include <string>
+#include <vector>
+#include "DataTypes.h"
+
+namespace dae
+{
+	//Wavefront OBJ positions, uvs, normals and the first 3 corners off every face, every corner becomes its own vertex
+	//The text is split at line boundaries over the hardware threads, records are counted first so every array is allocated once
+	namespace ObjParser
+	{
+		struct Statistics
+		{
+			size_t size{};
+			int threadCount{};
+			float milliseconds{};
+
+			float GetMegabytesPerSecond() const { return milliseconds > 0.0f ? (size / (1024.0f * 1024.0f)) / (milliseconds / 1000.0f) : 0.0f; }
+		};
+
+		//flipAxisAndWinding mirrors z and reverses the winding, from right handed OBJ to the left handed renderer
+		//Returns false when the file can not be read, or a face is incomplete or points past the records
+		bool Parse(const std::string& filename, std::vector<Vertex>& vertices, std::vector<uint32_t>& indices, bool flipAxisAndWinding = true, Statistics* pStatistics = nullptr);
+		bool Parse(const char* pText, size_t size, std::vector<Vertex>& vertices, std::vector<uint32_t>& indices, bool flipAxisAndWinding = true, Statistics* pStatistics = nullptr);
+	}
+}
@@ -0,0 +1,46 @@
+#include "PhongLut.h"
+#include "MathHelpers.h"
+
+namespace dae
+{
+	PhongLut::PhongLut(float maxExponent, int cosSteps, int exponentSteps) :
+		m_MaxExponent{ std::max(maxExponent, 1.0f + FLT_EPSILON) },
+		m_CosSteps{ std::max(cosSteps, 2) },
+		m_ExponentSteps{ std::max(exponentSteps, 2) },
+		m_InverseExponentRange{ 1.0f / (m_MaxExponent - 1.0f) },
+		m_Values(size_t(m_CosSteps) * m_ExponentSteps)
+	{
+		for (int row{}; row < m_ExponentSteps; ++row)
+		{
+			const float t{ float(row) / (m_ExponentSteps - 1) };
+			const float exponent{ 1.0f + t * t * (m_MaxExponent - 1.0f) };
+			for (int column{}; column < m_CosSteps; ++column)
+				m_Values[size_t(row) * m_CosSteps + column] = std::pow(float(column) / (m_CosSteps - 1), exponent);
+		}
+
+		m_MaxError = MeasureMaxError();
+	}
+
+	float PhongLut::MeasureMaxError() const
+	{
+		//Bilinear error peaks between the samples, so the cell centers and edge midpoints are tested
+		float maxError{};
+		for (int row{}; row + 1 < m_ExponentSteps; ++row)
+		{
+			for (int column{}; column + 1 < m_CosSteps; ++column)
+			{
+				for (const float offsetY : { 0.0f, 0.5f })
+				{
+					const float t{ (row + offsetY) / (m_ExponentSteps - 1) };
+					const float exponent{ 1.0f + t * t * (m_MaxExponent - 1.0f) };
+					for (const float offsetX : { 0.0f, 0.5f })
+					{
+						const float cosAlpha{ (column + offsetX) / (m_CosSteps - 1) };
+						maxError = std::max(maxError, std::abs(Evaluate(cosAlpha, exponent) - std::pow(cosAlpha, exponent)));
+					}
+				}
+			}
+		}
+		return maxError;
+	}
+}
@@ -0,0 +1,54 @@
+#pragma once
+#include <algorithm>
+#include <cmath>
+#include <cstddef>
+#include <vector>
+
+namespace dae
+{
+	//pow(cosAlpha, exponent) for the Phong lobes, bilinear from a table built once
+	//Rows are spaced quadratically in the exponent, pow changes fastest for small exponents
+	class PhongLut final
+	{
+	public:
+		explicit PhongLut(float maxExponent, int cosSteps = 256, int exponentSteps = 32);
+
+		//Exponents below 1 fall back to std::pow, the lobe is too wide there to interpolate
+		//Inline, it runs once per shaded pixel
+		float Evaluate(float cosAlpha, float exponent) const
+		{
+			if (cosAlpha <= 0.0f)
+				return 0.0f;
+			if (exponent < 1.0f)
+				return std::pow(cosAlpha, exponent);
+
+			const float x{ std::min(cosAlpha, 1.0f) * (m_CosSteps - 1) };
+			const float y{ std::sqrt(std::min((exponent - 1.0f) * m_InverseExponentRange, 1.0f)) * (m_ExponentSteps - 1) };
+			const int column{ std::min(int(x), m_CosSteps - 2) };
+			const int row{ std::min(int(y), m_ExponentSteps - 2) };
+			const float weightX{ x - column };
+			const float weightY{ y - row };
+
+			const float* pRow0{ m_Values.data() + size_t(row) * m_CosSteps + column };
+			const float* pRow1{ pRow0 + m_CosSteps };
+			const float value0{ pRow0[0] + (pRow0[1] - pRow0[0]) * weightX };
+			const float value1{ pRow1[0] + (pRow1[1] - pRow1[0]) * weightX };
+			return value0 + (value1 - value0) * weightY;
+		}
+
+		//Largest absolute difference to std::pow in the table range, measured when it is built
+		float GetMaxError() const { return m_MaxError; }
+		float GetMaxExponent() const { return m_MaxExponent; }
+		size_t GetMemorySize() const { return m_Values.size() * sizeof(float); }
+
+	private:
+		float MeasureMaxError() const;
+
+		float m_MaxExponent{};
+		int m_CosSteps{};
+		int m_ExponentSteps{};
+		float m_InverseExponentRange{};
+		float m_MaxError{};
+		std::vector<float> m_Values{}; //one row off cosSteps per exponent
+	};
+}
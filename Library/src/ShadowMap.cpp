@@ -0,0 +1,149 @@
+#include "ShadowMap.h"
+#include <algorithm>
+#include <cmath>
+
+namespace dae
+{
+	ShadowMap::ShadowMap(int size) :
+		m_Size{ std::max(size, 4) }
+	{
+	}
+
+	bool ShadowMap::Update(const Vector3& lightDirection, const std::vector<Mesh>& casters)
+	{
+		bool changed{ !m_Valid || !(lightDirection == m_CachedDirection) || casters.size() != m_CachedWorldMatrices.size() };
+		for (size_t i{}; !changed && i < casters.size(); ++i)
+			changed = !(casters[i].worldMatrix == m_CachedWorldMatrices[i]);
+		if (!changed)
+			return false;
+
+		m_CachedDirection = lightDirection;
+		m_CachedWorldMatrices.clear();
+		for (const Mesh& mesh : casters)
+			m_CachedWorldMatrices.push_back(mesh.worldMatrix);
+
+		Render(casters);
+		m_Valid = true;
+		++m_RenderCount;
+		return true;
+	}
+
+	void ShadowMap::Render(const std::vector<Mesh>& casters)
+	{
+		const Vector3 up{ std::abs(m_CachedDirection.y) > 0.99f ? Vector3::UnitZ : Vector3::UnitY };
+		m_LightView = Matrix::CreateLookAtLH(Vector3::Zero, m_CachedDirection.Normalized(), up);
+
+		//Every caster goes to light space once, the map is fitted around all off them
+		std::vector<std::vector<Vector3>> lightSpace(casters.size());
+		float minX{ FLT_MAX }, minY{ FLT_MAX }, maxX{ -FLT_MAX }, maxY{ -FLT_MAX };
+		for (size_t i{}; i < casters.size(); ++i)
+		{
+			const Matrix modelToLight{ casters[i].worldMatrix * m_LightView };
+			lightSpace[i].reserve(casters[i].vertices.size());
+			for (const Vertex& vertex : casters[i].vertices)
+			{
+				const Vector3 point{ modelToLight.TransformPoint(vertex.position) };
+				minX = std::min(minX, point.x);
+				minY = std::min(minY, point.y);
+				maxX = std::max(maxX, point.x);
+				maxY = std::max(maxY, point.y);
+				lightSpace[i].push_back(point);
+			}
+		}
+
+		m_Depth.assign(size_t(m_Size) * m_Size, FLT_MAX);
+		if (minX > maxX)
+			return;
+
+		//One texel border so the PCF taps at the edge off a caster stay on the map
+		const float extent{ std::max(std::max(maxX - minX, maxY - minY), FLT_EPSILON) };
+		m_TexelsPerUnit = (m_Size - 2) / extent;
+		m_Offset        = { minX, minY };
+		m_Bias          = 1.5f / m_TexelsPerUnit;
+		for (std::vector<Vector3>& points : lightSpace)
+		{
+			for (Vector3& point : points)
+			{
+				point.x = (point.x - m_Offset.x) * m_TexelsPerUnit + 1.0f;
+				point.y = (point.y - m_Offset.y) * m_TexelsPerUnit + 1.0f;
+			}
+		}
+
+		//Both windings are rasterized, back faces cast shadows as well
+		for (size_t i{}; i < casters.size(); ++i)
+		{
+			const std::vector<uint32_t>& indices{ casters[i].indices };
+			const bool isStrip{ casters[i].primitiveTopology == PrimitiveTopology::TriangleStrip };
+			const size_t increment{ isStrip ? 1u : 3u };
+			for (size_t indc{}; indc + 2 < indices.size(); indc += increment)
+				RasterizeTriangle(lightSpace[i][indices[indc]], lightSpace[i][indices[indc + 1]], lightSpace[i][indices[indc + 2]]);
+		}
+	}
+
+	void ShadowMap::RasterizeTriangle(const Vector3& v0, const Vector3& v1, const Vector3& v2)
+	{
+		const float area{ (v1.x - v0.x) * (v2.y - v0.y) - (v1.y - v0.y) * (v2.x - v0.x) };
+		if (std::abs(area) < FLT_EPSILON)
+			return;
+
+		const int left{ Clamp(int(std::floor(std::min(std::min(v0.x, v1.x), v2.x))), 0, m_Size) };
+		const int top{ Clamp(int(std::floor(std::min(std::min(v0.y, v1.y), v2.y))), 0, m_Size) };
+		const int right{ Clamp(int(std::ceil(std::max(std::max(v0.x, v1.x), v2.x))), 0, m_Size) };
+		const int bottom{ Clamp(int(std::ceil(std::max(std::max(v0.y, v1.y), v2.y))), 0, m_Size) };
+
+		//Normalized edge functions, positive inside for both windings and linear in x, so a row only adds a step
+		const float inverseArea{ 1.0f / area };
+		const float stepX0{ -(v2.y - v1.y) * inverseArea };
+		const float stepX1{ -(v0.y - v2.y) * inverseArea };
+		const float stepX2{ -(v1.y - v0.y) * inverseArea };
+		for (int py{ top }; py < bottom; ++py)
+		{
+			const float x{ left + 0.5f }, y{ py + 0.5f };
+			float w0{ ((v2.x - v1.x) * (y - v1.y) - (v2.y - v1.y) * (x - v1.x)) * inverseArea };
+			float w1{ ((v0.x - v2.x) * (y - v2.y) - (v0.y - v2.y) * (x - v2.x)) * inverseArea };
+			float w2{ ((v1.x - v0.x) * (y - v0.y) - (v1.y - v0.y) * (x - v0.x)) * inverseArea };
+
+			float* pDepth{ m_Depth.data() + size_t(py) * m_Size };
+			for (int px{ left }; px < right; ++px, w0 += stepX0, w1 += stepX1, w2 += stepX2)
+			{
+				if (w0 < 0.0f || w1 < 0.0f || w2 < 0.0f)
+					continue;
+
+				//Orthographic, so the depth is linear in the map
+				const float depth{ w0 * v0.z + w1 * v1.z + w2 * v2.z };
+				pDepth[px] = std::min(pDepth[px], depth);
+			}
+		}
+	}
+
+	float ShadowMap::SampleVisibility(const Vector3& worldPosition, const Vector3& normal) const
+	{
+		if (!m_Valid || m_TexelsPerUnit <= 0.0f)
+			return 1.0f;
+
+		const Vector3 lightSpace{ m_LightView.TransformPoint(worldPosition + normal * m_Bias) };
+		const float x{ (lightSpace.x - m_Offset.x) * m_TexelsPerUnit + 0.5f };
+		const float y{ (lightSpace.y - m_Offset.y) * m_TexelsPerUnit + 0.5f };
+		if (x < 0.0f || y < 0.0f || x >= m_Size || y >= m_Size)
+			return 1.0f;
+
+		//4x4 compares, the outer ones weighted by the position inside the texel, gives a smooth 3x3 filter
+		const int baseX{ int(x) }, baseY{ int(y) };
+		const float fractionX{ x - baseX }, fractionY{ y - baseY };
+		const float weightsX[4]{ 1.0f - fractionX, 1.0f, 1.0f, fractionX };
+		const float weightsY[4]{ 1.0f - fractionY, 1.0f, 1.0f, fractionY };
+		const float depth{ lightSpace.z - m_Bias };
+
+		float visibility{};
+		for (int j{}; j < 4; ++j)
+		{
+			const float* pRow{ m_Depth.data() + size_t(Clamp(baseY + j - 1, 0, m_Size - 1)) * m_Size };
+			for (int i{}; i < 4; ++i)
+			{
+				if (depth <= pRow[Clamp(baseX + i - 1, 0, m_Size - 1)])
+					visibility += weightsX[i] * weightsY[j];
+			}
+		}
+		return visibility / 9.0f;
+	}
+}
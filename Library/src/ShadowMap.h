@@ -0,0 +1,46 @@
+#pragma once
+#include <cstddef>
+#include <vector>
+#include "Maths.h"
+#include "DataTypes.h"
+
+namespace dae
+{
+	//Depth off the casters as seen from a directional light, orthographic and fitted around every caster
+	//Kept between frames, it is only rendered again when the light or a caster moved
+	class ShadowMap final
+	{
+	public:
+		explicit ShadowMap(int size = 1024);
+
+		//Returns true when the map was rendered again
+		bool Update(const Vector3& lightDirection, const std::vector<Mesh>& casters);
+		void Invalidate() { m_Valid = false; }
+
+		//Fraction off the light that reaches the point, 3x3 PCF with bilinear weights, 1 outside the map
+		//The normal offsets the lookup by a texel so lit surfaces do not shadow themselves
+		float SampleVisibility(const Vector3& worldPosition, const Vector3& normal) const;
+
+		int GetSize() const { return m_Size; }
+		int GetRenderCount() const { return m_RenderCount; }
+		size_t GetMemorySize() const { return m_Depth.size() * sizeof(float); }
+
+	private:
+		void Render(const std::vector<Mesh>& casters);
+		//Depth only, nothing but the light space depth is interpolated
+		void RasterizeTriangle(const Vector3& v0, const Vector3& v1, const Vector3& v2);
+
+		int m_Size{};
+		std::vector<float> m_Depth{};
+		Matrix m_LightView{};
+		//Light space x and y to map texels
+		Vector2 m_Offset{};
+		float m_TexelsPerUnit{};
+		float m_Bias{};
+
+		bool m_Valid{ false };
+		int m_RenderCount{};
+		Vector3 m_CachedDirection{};
+		std::vector<Matrix> m_CachedWorldMatrices{};
+	};
+}
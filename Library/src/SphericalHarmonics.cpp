@@ -0,0 +1,152 @@
+#include "SphericalHarmonics.h"
+#include <cmath>
+#include <cstdint>
+#include <cstdio>
+#include <fstream>
+
+namespace dae
+{
+	namespace
+	{
+		//Basis constants per coefficient, Y = constant * polynomial in the direction
+		constexpr float BasisConstants[9]{ 0.282095f, 0.488603f, 0.488603f, 0.488603f, 1.092548f, 1.092548f, 0.315392f, 1.092548f, 0.546274f };
+		//Cosine lobe per band, divided by PI so irradiance / PI is the blurred radiance
+		constexpr float CosineBands[3]{ 1.0f, 2.0f / 3.0f, 0.25f };
+
+		int GetBand(int coefficient)
+		{
+			return coefficient == 0 ? 0 : coefficient < 4 ? 1 : 2;
+		}
+
+		ColorRGB DecodeRGBE(const uint8_t* pRGBE)
+		{
+			if (pRGBE[3] == 0)
+				return {};
+			const float scale{ std::ldexp(1.0f, int(pRGBE[3]) - (128 + 8)) };
+			return { pRGBE[0] * scale, pRGBE[1] * scale, pRGBE[2] * scale };
+		}
+
+		//Scanlines are either flat RGBE or run length encoded per channel
+		bool ReadScanline(std::ifstream& file, int width, std::vector<uint8_t>& scanline)
+		{
+			uint8_t start[4]{};
+			if (!file.read(reinterpret_cast<char*>(start), 4))
+				return false;
+
+			const bool runLengthEncoded{ start[0] == 2 && start[1] == 2 && ((start[2] << 8) | start[3]) == width && width >= 8 && width < 32768 };
+			if (!runLengthEncoded)
+			{
+				std::copy(start, start + 4, scanline.begin());
+				return bool(file.read(reinterpret_cast<char*>(scanline.data() + 4), std::streamsize(width - 1) * 4));
+			}
+
+			for (int channel{}; channel < 4; ++channel)
+			{
+				for (int x{}; x < width;)
+				{
+					uint8_t count{};
+					if (!file.read(reinterpret_cast<char*>(&count), 1))
+						return false;
+
+					//Above 128 is a run off one value, otherwise that many literal values
+					const bool run{ count > 128 };
+					const int length{ run ? count - 128 : count };
+					if (length == 0 || x + length > width)
+						return false;
+
+					uint8_t value{};
+					for (int i{}; i < length; ++i, ++x)
+					{
+						if ((!run || i == 0) && !file.read(reinterpret_cast<char*>(&value), 1))
+							return false;
+						scanline[size_t(x) * 4 + channel] = value;
+					}
+				}
+			}
+			return true;
+		}
+	}
+
+	bool SphericalHarmonics::LoadFromHdr(const std::string& path)
+	{
+		std::ifstream file{ path, std::ios::binary };
+		std::string line{};
+		if (!std::getline(file, line) || line.rfind("#?", 0) != 0)
+			return false;
+
+		//Header lines end at an empty line, the resolution line follows
+		bool isRGBE{ false };
+		while (std::getline(file, line) && !line.empty())
+			isRGBE |= line == "FORMAT=32-bit_rle_rgbe";
+
+		int width{}, height{};
+		if (!isRGBE || !std::getline(file, line) || std::sscanf(line.c_str(), "-Y %d +X %d", &height, &width) != 2 || width <= 0 || height <= 0)
+		{
+			printf("Unsupported hdr file %s\n", path.c_str());
+			return false;
+		}
+
+		std::vector<ColorRGB> radiance(size_t(width) * height);
+		std::vector<uint8_t> scanline(size_t(width) * 4);
+		for (int y{}; y < height; ++y)
+		{
+			if (!ReadScanline(file, width, scanline))
+			{
+				printf("Truncated hdr file %s\n", path.c_str());
+				return false;
+			}
+			for (int x{}; x < width; ++x)
+				radiance[size_t(y) * width + x] = DecodeRGBE(scanline.data() + size_t(x) * 4);
+		}
+
+		ProjectEquirectangular(radiance, width, height);
+		return true;
+	}
+
+	void SphericalHarmonics::ProjectEquirectangular(const std::vector<ColorRGB>& radiance, int width, int height)
+	{
+		ColorRGB coefficients[9]{};
+		float totalSolidAngle{};
+		for (int y{}; y < height; ++y)
+		{
+			const float theta{ PI * (y + 0.5f) / height };
+			const float sinTheta{ std::sin(theta) };
+			const float cosTheta{ std::cos(theta) };
+
+			//Rows near the poles cover less off the sphere
+			const float solidAngle{ (2.0f * PI / width) * (PI / height) * sinTheta };
+			for (int x{}; x < width; ++x)
+			{
+				const float phi{ 2.0f * PI * (x + 0.5f) / width };
+				const Vector3 n{ sinTheta * std::cos(phi), cosTheta, sinTheta * std::sin(phi) };
+				const float basis[9]{ 1.0f, n.y, n.z, n.x, n.x * n.y, n.y * n.z, 3.0f * n.z * n.z - 1.0f, n.x * n.z, n.x * n.x - n.y * n.y };
+
+				const ColorRGB weighted{ radiance[size_t(y) * width + x] * solidAngle };
+				for (int i{}; i < 9; ++i)
+					coefficients[i] += weighted * (basis[i] * BasisConstants[i]);
+				totalSolidAngle += solidAngle;
+			}
+		}
+
+		//The discrete solid angles do not add up to exactly 4 PI
+		const float normalization{ 4.0f * PI / totalSolidAngle };
+		for (int i{}; i < 9; ++i)
+		{
+			m_Coefficients[i]           = coefficients[i] * (normalization * BasisConstants[i]);
+			m_IrradianceCoefficients[i] = m_Coefficients[i] * (PI * CosineBands[GetBand(i)]);
+		}
+	}
+
+	ColorRGB SphericalHarmonics::EvaluateRadiance(const Vector3& direction, float roughness) const
+	{
+		//Every band is scaled towards its cosine lobe weight, which blurs the lighting without a new projection
+		const float blur{ Saturate(roughness * roughness) };
+		ColorRGB coefficients[9]{};
+		for (int i{}; i < 9; ++i)
+		{
+			const float bandWeight{ CosineBands[GetBand(i)] };
+			coefficients[i] = m_Coefficients[i] * (1.0f + (bandWeight - 1.0f) * blur);
+		}
+		return Evaluate(coefficients, direction);
+	}
+}
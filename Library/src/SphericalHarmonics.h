@@ -0,0 +1,40 @@
+#pragma once
+#include <string>
+#include <vector>
+#include "Maths.h"
+
+namespace dae
+{
+	//Low frequency lighting off an environment, 9 coefficients per channel (bands 0 to 2)
+	//Projected once, after that irradiance for a normal is a few multiply adds instead off a cubemap integral
+	class SphericalHarmonics final
+	{
+	public:
+		//Equirectangular Radiance .hdr (RGBE), returns false and keeps the coefficients when it can not be read
+		bool LoadFromHdr(const std::string& path);
+		//Rows go from straight up to straight down, columns once around the y axis
+		void ProjectEquirectangular(const std::vector<ColorRGB>& radiance, int width, int height);
+
+		//Irradiance, the cosine convolution is baked into the coefficients
+		ColorRGB EvaluateIrradiance(const Vector3& normal) const
+		{
+			return Evaluate(m_IrradianceCoefficients, normal);
+		}
+
+		//Radiance, blurred from the projected radiance at roughness 0 to irradiance / PI at roughness 1
+		ColorRGB EvaluateRadiance(const Vector3& direction, float roughness) const;
+
+	private:
+		static ColorRGB Evaluate(const ColorRGB (&coefficients)[9], const Vector3& n)
+		{
+			return coefficients[0]
+				+ coefficients[1] * n.y + coefficients[2] * n.z + coefficients[3] * n.x
+				+ coefficients[4] * (n.x * n.y) + coefficients[5] * (n.y * n.z) + coefficients[6] * (3.0f * n.z * n.z - 1.0f)
+				+ coefficients[7] * (n.x * n.z) + coefficients[8] * (n.x * n.x - n.y * n.y);
+		}
+
+		//Projected radiance and the irradiance version, both with the basis constants folded in
+		ColorRGB m_Coefficients[9]{};
+		ColorRGB m_IrradianceCoefficients[9]{};
+	};
+}
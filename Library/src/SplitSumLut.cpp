@@ -0,0 +1,119 @@
+#include "SplitSumLut.h"
+#include <cmath>
+#include <cstdint>
+#include <cstdio>
+#include <fstream>
+#include "MathHelpers.h"
+
+namespace dae
+{
+	namespace
+	{
+		struct SplitSumCacheHeader
+		{
+			char magic[4]{ 'S', 'S', 'L', 'T' };
+			uint32_t version{ 1 };
+			int32_t size{};
+			int32_t sampleCount{};
+		};
+
+		//Low discrepancy points, the radical inverse spreads the second coordinate evenly
+		float RadicalInverse(uint32_t bits)
+		{
+			bits = (bits << 16u) | (bits >> 16u);
+			bits = ((bits & 0x55555555u) << 1u) | ((bits & 0xAAAAAAAAu) >> 1u);
+			bits = ((bits & 0x33333333u) << 2u) | ((bits & 0xCCCCCCCCu) >> 2u);
+			bits = ((bits & 0x0F0F0F0Fu) << 4u) | ((bits & 0xF0F0F0F0u) >> 4u);
+			bits = ((bits & 0x00FF00FFu) << 8u) | ((bits & 0xFF00FF00u) >> 8u);
+			return float(bits) * 2.3283064365386963e-10f;
+		}
+	}
+
+	SplitSumLut::SplitSumLut(const std::string& cachePath, int size, int sampleCount) :
+		m_Size{ std::max(size, 2) },
+		m_SampleCount{ std::max(sampleCount, 1) }
+	{
+		m_LoadedFromCache = LoadCache(cachePath);
+		if (m_LoadedFromCache)
+			return;
+
+		Integrate();
+		SaveCache(cachePath);
+	}
+
+	void SplitSumLut::Integrate()
+	{
+		m_Values.assign(size_t(m_Size) * m_Size, Vector2{});
+		for (int row{}; row < m_Size; ++row)
+		{
+			//Same alpha as the direct lighting, the square off the perceptual roughness
+			const float roughness{ float(row) / (m_Size - 1) };
+			const float alpha{ std::max(roughness * roughness, 0.001f) };
+			const float alphaSquared{ alpha * alpha };
+			const float k{ alpha / 2.0f }; //Schlick-GGX k for image based lighting
+
+			for (int column{}; column < m_Size; ++column)
+			{
+				//Normal along z, view in the xz plane
+				const float dotNV{ std::max(float(column) / (m_Size - 1), 0.001f) };
+				const float viewX{ std::sqrt(1.0f - dotNV * dotNV) };
+
+				float scale{}, bias{};
+				for (int sample{}; sample < m_SampleCount; ++sample)
+				{
+					//Half vector importance sampled from the GGX distribution
+					const float phi{ 2.0f * PI * (sample + 0.5f) / m_SampleCount };
+					const float random{ RadicalInverse(uint32_t(sample)) };
+					const float cosTheta{ std::sqrt((1.0f - random) / (1.0f + (alphaSquared - 1.0f) * random)) };
+					const float sinTheta{ std::sqrt(1.0f - cosTheta * cosTheta) };
+					const float halfX{ sinTheta * std::cos(phi) };
+					const float halfZ{ cosTheta };
+
+					//Light is the view reflected around the half vector
+					const float dotVH{ viewX * halfX + dotNV * halfZ };
+					const float dotNL{ 2.0f * dotVH * halfZ - dotNV };
+					if (dotNL <= 0.0f || dotVH <= 0.0f)
+						continue;
+
+					const float geometry{ (dotNL / (dotNL * (1.0f - k) + k)) * (dotNV / (dotNV * (1.0f - k) + k)) };
+					const float visibility{ geometry * dotVH / (halfZ * dotNV) };
+					const float fresnel{ std::pow(1.0f - dotVH, 5.0f) };
+					scale += (1.0f - fresnel) * visibility;
+					bias  += fresnel * visibility;
+				}
+				m_Values[size_t(row) * m_Size + column] = { scale / m_SampleCount, bias / m_SampleCount };
+			}
+		}
+	}
+
+	bool SplitSumLut::LoadCache(const std::string& cachePath)
+	{
+		std::ifstream file{ cachePath, std::ios::binary };
+		SplitSumCacheHeader header{};
+		const SplitSumCacheHeader expected{};
+		if (!file.read(reinterpret_cast<char*>(&header), sizeof(header))
+			|| !std::equal(header.magic, header.magic + 4, expected.magic)
+			|| header.version != expected.version
+			|| header.size != m_Size || header.sampleCount != m_SampleCount)
+			return false;
+
+		m_Values.resize(size_t(m_Size) * m_Size);
+		return bool(file.read(reinterpret_cast<char*>(m_Values.data()), m_Values.size() * sizeof(Vector2)));
+	}
+
+	void SplitSumLut::SaveCache(const std::string& cachePath) const
+	{
+		std::ofstream file{ cachePath, std::ios::binary };
+		if (!file)
+		{
+			printf("Unable to write split-sum cache %s\n", cachePath.c_str());
+			return;
+		}
+
+		SplitSumCacheHeader header{};
+		header.size        = m_Size;
+		header.sampleCount = m_SampleCount;
+		file.write(reinterpret_cast<const char*>(&header), sizeof(header));
+		file.write(reinterpret_cast<const char*>(m_Values.data()), m_Values.size() * sizeof(Vector2));
+	}
+}
@@ -0,0 +1,49 @@
+#pragma once
+#include <algorithm>
+#include <cstddef>
+#include <string>
+#include <vector>
+#include "Vector2.h"
+
+namespace dae
+{
+	//Environment BRDF off the split-sum approximation, specular = prefiltered radiance * (f0 * x + y)
+	//Indexed by n.v and perceptual roughness, integrated once with GGX importance sampling and cached to disk
+	class SplitSumLut final
+	{
+	public:
+		//Loads the table from cachePath, integrates and saves it when the file is missing or off a different size
+		explicit SplitSumLut(const std::string& cachePath, int size = 64, int sampleCount = 512);
+
+		//Scale (x) and bias (y) on f0, bilinear
+		Vector2 Evaluate(float dotNV, float roughness) const
+		{
+			const float x{ std::clamp(dotNV, 0.0f, 1.0f) * (m_Size - 1) };
+			const float y{ std::clamp(roughness, 0.0f, 1.0f) * (m_Size - 1) };
+			const int column{ std::min(int(x), m_Size - 2) };
+			const int row{ std::min(int(y), m_Size - 2) };
+			const float weightX{ x - column };
+			const float weightY{ y - row };
+
+			const Vector2* pRow0{ m_Values.data() + size_t(row) * m_Size + column };
+			const Vector2* pRow1{ pRow0 + m_Size };
+			const Vector2 value0{ pRow0[0] + (pRow0[1] - pRow0[0]) * weightX };
+			const Vector2 value1{ pRow1[0] + (pRow1[1] - pRow1[0]) * weightX };
+			return value0 + (value1 - value0) * weightY;
+		}
+
+		bool IsLoadedFromCache() const { return m_LoadedFromCache; }
+		int GetSize() const { return m_Size; }
+		size_t GetMemorySize() const { return m_Values.size() * sizeof(Vector2); }
+
+	private:
+		void Integrate();
+		bool LoadCache(const std::string& cachePath);
+		void SaveCache(const std::string& cachePath) const;
+
+		int m_Size{};
+		int m_SampleCount{};
+		bool m_LoadedFromCache{ false };
+		std::vector<Vector2> m_Values{}; //one row off size n.v steps per roughness
+	};
+}
@@ -1,72 +1,927 @@
 #include "Texture.h"
 #include "Vector2.h"
 #include "Vector3.h"
+#include "MathHelpers.h"
+#include "BlockCompression.h"
 #include <SDL_image.h>
+#include <array>
+#include <atomic>
+#include <bit>
+#include <filesystem>
+#include <fstream>
+#include <thread>
+#include "TextureGather.h"
+#if defined(_MSC_VER)
+#include <intrin.h>
+#endif
 
 namespace dae
 {
-	Texture::Texture(SDL_Surface* pSurface) :
-		m_pSurface{ pSurface },
-		m_pSurfacePixels{ (uint32_t*)pSurface->pixels }
+	namespace
 	{
+		ColorRGB ToColor(uint32_t texel)
+		{
+			constexpr float toFloat{ 1.0f / 255.0f };
+			return ColorRGB{ float(texel & 0xFF) * toFloat, float((texel >> 8) & 0xFF) * toFloat, float((texel >> 16) & 0xFF) * toFloat };
+		}
+
+		//Splits the rows over the hardware threads, function(firstRow, endRow) handles one range
+		template<typename Function>
+		void ParallelForRows(int rowCount, const Function& function)
+		{
+			const int threadCount{ std::clamp(int(std::thread::hardware_concurrency()), 1, std::max(rowCount, 1)) };
+			if (threadCount == 1)
+			{
+				function(0, rowCount);
+				return;
+			}
+
+			std::vector<std::thread> threads{};
+			threads.reserve(threadCount);
+			for (int thread{}; thread < threadCount; ++thread)
+			{
+				threads.emplace_back(function, rowCount * thread / threadCount, rowCount * (thread + 1) / threadCount);
+			}
+			for (std::thread& thread : threads)
+			{
+				thread.join();
+			}
+		}
+
+		//Moves the texels off one level array from the old to the new addressing
+		template<typename Texel, typename OldAddress, typename NewAddress>
+		void Relayout(std::vector<Texel>& texels, size_t storageSize, int width, int height, const OldAddress& oldAddress, const NewAddress& newAddress)
+		{
+			if (texels.empty())
+				return;
+
+			std::vector<Texel> relaidTexels(storageSize);
+			for (int v{}; v < height; ++v)
+			{
+				for (int u{}; u < width; ++u)
+				{
+					relaidTexels[newAddress(u, v)] = texels[oldAddress(u, v)];
+				}
+			}
+			texels = std::move(relaidTexels);
+		}
+
+		bool IsBlockCompressedFormat(TextureFormat format)
+		{
+			return format == TextureFormat::BC1 || format == TextureFormat::BC4 || format == TextureFormat::BC5;
+		}
+
+		//Uncompressed format a block compressed texture is built from
+		TextureFormat GetSourceFormat(TextureFormat format)
+		{
+			switch (format)
+			{
+			case TextureFormat::BC1: return TextureFormat::RGBA8;
+			case TextureFormat::BC4: return TextureFormat::R8;
+			case TextureFormat::BC5: return TextureFormat::Normal;
+			default:                 return format;
+			}
+		}
+
+		int GetBlockWords(TextureFormat format)
+		{
+			return format == TextureFormat::BC5 ? 2 : 1;
+		}
+
+		uint8_t ToSnormByte(float value)
+		{
+			return uint8_t(std::lround((Clamp(value, -1.0f, 1.0f) * 0.5f + 0.5f) * 255.0f));
+		}
+
+		//Sidecar file with every compressed level, rebuilt when the source image is newer
+		struct CompressedCacheHeader
+		{
+			char magic[4]{ 'T', 'X', 'B', 'C' };
+			uint32_t version{ 1 };
+			uint32_t format{};
+			int32_t width{};
+			int32_t height{};
+			int32_t levelCount{};
+		};
+
+		std::atomic<uint32_t> g_NextTextureId{ 1 };
+
+		//Streamed textures keep every level up to this size resident
+		constexpr int StreamedPinnedSize{ 128 };
+
+		std::string GetCompressedCachePath(const std::string& path, TextureFormat format)
+		{
+			return path + (format == TextureFormat::BC1 ? ".bc1" : format == TextureFormat::BC4 ? ".bc4" : ".bc5");
+		}
+
+		//Texel coordinate off one axis for the address mode, wrapping power of two sizes is a mask
+		int AddressTexel(int texel, int size, TextureAddressMode addressMode)
+		{
+			if (addressMode == TextureAddressMode::Clamp)
+				return std::clamp(texel, 0, size - 1);
+			if (std::has_single_bit(uint32_t(size)))
+				return texel & (size - 1);
+
+			const int wrapped{ texel % size };
+			return wrapped < 0 ? wrapped + size : wrapped;
+		}
+
+		//Lerp off 2 packed RGBA8 texels with weight in [0, 256], red/blue and green/alpha are filtered in pairs
+		uint32_t LerpTexels(uint32_t a, uint32_t b, uint32_t weight)
+		{
+			const uint32_t redBlue{ (((a & 0x00FF00FF) * (256 - weight) + (b & 0x00FF00FF) * weight) >> 8) & 0x00FF00FF };
+			const uint32_t greenAlpha{ ((((a >> 8) & 0x00FF00FF) * (256 - weight) + ((b >> 8) & 0x00FF00FF) * weight) >> 8) & 0x00FF00FF };
+			return redBlue | (greenAlpha << 8);
+		}
+
+		//The gather kernel is the only code built with AVX2, the CPU and the OS saving the YMM registers are checked here
+		bool HasAvx2()
+		{
+#if defined(_MSC_VER)
+			int info[4]{};
+			__cpuid(info, 0);
+			if (info[0] < 7)
+				return false;
+			__cpuid(info, 1);
+			const bool hasOsXsave{ (info[2] & (1 << 27)) != 0 };
+			if (!hasOsXsave || (_xgetbv(0) & 0x6) != 0x6)
+				return false;
+			__cpuidex(info, 7, 0);
+			return (info[1] & (1 << 5)) != 0;
+#elif defined(__x86_64__) || defined(__i386__)
+			return __builtin_cpu_supports("avx2");
+#else
+			return false;
+#endif
+		}
 	}
 
-	Texture::~Texture()
+	Texture::Texture(SDL_Surface* pSurface, TextureFormat format) :
+		m_Format{ format }
 	{
-		if (m_pSurface)
+		Level& level{ m_Levels.emplace_back() };
+		level.width  = pSurface->w;
+		level.height = pSurface->h;
+		SetStorageSize(level, m_Layout);
+
+		//pSurface is RGBA32, so the bytes are r, g, b, a in memory
+		const size_t texelCount{ size_t(level.storageWidth) * level.storageHeight };
+		switch (m_Format)
 		{
-			SDL_FreeSurface(m_pSurface);
-			m_pSurface = nullptr;
+		case TextureFormat::RGBA8:
+			level.colorTexels.resize(texelCount);
+			break;
+		case TextureFormat::R8:
+			level.singleTexels.resize(texelCount);
+			break;
+		case TextureFormat::Normal:
+			level.normalTexels.resize(texelCount);
+			break;
+		default:
+			//Block compressed formats are built from their source format by Compress
+			break;
 		}
+
+		for (int v{}; v < level.height; ++v)
+		{
+			const Uint8* pRow{ static_cast<const Uint8*>(pSurface->pixels) + v * pSurface->pitch };
+			for (int u{}; u < level.width; ++u)
+			{
+				const Uint8* pTexel{ pRow + u * 4 };
+				const size_t index{ GetTexelAddress(level, u, v) };
+				switch (m_Format)
+				{
+				case TextureFormat::RGBA8:
+					level.colorTexels[index] = pTexel[0] | (pTexel[1] << 8) | (pTexel[2] << 16) | (Uint32(pTexel[3]) << 24);
+					break;
+				case TextureFormat::R8:
+					level.singleTexels[index] = pTexel[0];
+					break;
+				case TextureFormat::Normal:
+					level.normalTexels[index] = { pTexel[0] / 255.0f * 2.0f - 1.0f, pTexel[1] / 255.0f * 2.0f - 1.0f, pTexel[2] / 255.0f * 2.0f - 1.0f };
+					break;
+				default:
+					break;
+				}
+			}
+		}
+
+		GenerateMipLevels();
 	}
 
-	Texture* Texture::LoadFromFile(const std::string& path)
+	Texture* Texture::LoadFromFile(const std::string& path, TextureFormat format)
 	{
-		//TODO
-		//Load SDL_Surface using IMG_LOAD
-		//Create & Return a new Texture Object (using SDL_Surface)
+		if (IsBlockCompressedFormat(format))
+		{
+			const std::string cachePath{ GetCompressedCachePath(path, format) };
+			if (Texture* pCachedTexture{ LoadCompressedCache(path, cachePath, format) })
+				return pCachedTexture;
 
+			Texture* pTexture{ LoadFromFile(path, GetSourceFormat(format)) };
+			if (pTexture == nullptr)
+				return nullptr;
+
+			pTexture->Compress(format);
+			pTexture->SaveCompressedCache(cachePath);
+			return pTexture;
+		}
+
+		//Load SDL_Surface using IMG_LOAD and convert it once to the internal format
 		SDL_Surface* loadedSurface = IMG_Load(path.c_str());
 		if (loadedSurface == NULL)
 		{
 			printf("Unable to load image %s! SDL_image Error: %s\n", path.c_str(), IMG_GetError());
+			return nullptr;
 		}
 
-		return new Texture(loadedSurface);
+		SDL_Surface* pRGBASurface{ SDL_ConvertSurfaceFormat(loadedSurface, SDL_PIXELFORMAT_RGBA32, 0) };
+		SDL_FreeSurface(loadedSurface);
+		if (pRGBASurface == NULL)
+		{
+			printf("Unable to convert image %s! SDL Error: %s\n", path.c_str(), SDL_GetError());
+			return nullptr;
+		}
+
+		SDL_LockSurface(pRGBASurface);
+		Texture* pTexture{ new Texture(pRGBASurface, format) };
+		SDL_UnlockSurface(pRGBASurface);
+		SDL_FreeSurface(pRGBASurface);
 
+		return pTexture;
 	}
 
-	ColorRGB Texture::Sample(const Vector2& uv) const
+	Texture* Texture::CreateFromPixels(int width, int height, const uint32_t* pRGBA, TextureFormat format)
+	{
+		//The surface only wraps the texels, the constructor copies them into the internal format
+		SDL_Surface* pSurface{ SDL_CreateRGBSurfaceWithFormatFrom(const_cast<uint32_t*>(pRGBA), width, height, 32, width * 4, SDL_PIXELFORMAT_RGBA32) };
+		if (pSurface == NULL)
+		{
+			printf("Unable to create texture! SDL Error: %s\n", SDL_GetError());
+			return nullptr;
+		}
+
+		Texture* pTexture{ new Texture(pSurface, IsBlockCompressedFormat(format) ? GetSourceFormat(format) : format) };
+		SDL_FreeSurface(pSurface);
+		if (IsBlockCompressedFormat(format))
+			pTexture->Compress(format);
+		return pTexture;
+	}
+
+	Texture* Texture::LoadStreamed(const std::string& path, TextureFormat format)
+	{
+		//The compressed cache is the mip chain on disk, so only block compressed textures can stream
+		if (!IsBlockCompressedFormat(format))
+			return LoadFromFile(path, format);
+
+		const std::string cachePath{ GetCompressedCachePath(path, format) };
+		if (Texture* pStreamedTexture{ LoadCompressedCache(path, cachePath, format, true) })
+			return pStreamedTexture;
+
+		//Builds the cache once, a cache that could not be written leaves the texture fully resident
+		Texture* pTexture{ LoadFromFile(path, format) };
+		if (pTexture == nullptr)
+			return nullptr;
+
+		Texture* pStreamedTexture{ LoadCompressedCache(path, cachePath, format, true) };
+		if (pStreamedTexture == nullptr)
+			return pTexture;
+
+		delete pTexture;
+		return pStreamedTexture;
+	}
+
+	void Texture::GenerateMipLevels()
+	{
+		//2x2 box filter down to 1x1, odd sizes repeat their last row/column
+		while (m_Levels.back().width > 1 || m_Levels.back().height > 1)
+		{
+			const Level& source{ m_Levels.back() };
+			Level level{};
+			level.width  = std::max(source.width / 2, 1);
+			level.height = std::max(source.height / 2, 1);
+			SetStorageSize(level, m_Layout);
+			const size_t storageSize{ size_t(level.storageWidth) * level.storageHeight };
+			level.colorTexels.resize(source.colorTexels.empty() ? 0 : storageSize);
+			level.singleTexels.resize(source.singleTexels.empty() ? 0 : storageSize);
+			level.normalTexels.resize(source.normalTexels.empty() ? 0 : storageSize);
+
+			ParallelForRows(level.height, [&source, &level, this](int firstRow, int endRow)
+				{
+					for (int v{ firstRow }; v < endRow; ++v)
+					{
+						const int v0{ std::min(2 * v, source.height - 1) };
+						const int v1{ std::min(2 * v + 1, source.height - 1) };
+						for (int u{}; u < level.width; ++u)
+						{
+							const int u0{ std::min(2 * u, source.width - 1) };
+							const int u1{ std::min(2 * u + 1, source.width - 1) };
+							const uint32_t corners[4]{ GetTexelAddress(source, u0, v0), GetTexelAddress(source, u1, v0), GetTexelAddress(source, u0, v1), GetTexelAddress(source, u1, v1) };
+							const size_t index{ GetTexelAddress(level, u, v) };
+
+							switch (m_Format)
+							{
+							case TextureFormat::RGBA8:
+							{
+								uint32_t texel{};
+								for (int shift{}; shift < 32; shift += 8)
+								{
+									uint32_t sum{ 2 };
+									for (uint32_t corner : corners)
+										sum += (source.colorTexels[corner] >> shift) & 0xFF;
+									texel |= (sum / 4) << shift;
+								}
+								level.colorTexels[index] = texel;
+								break;
+							}
+							case TextureFormat::R8:
+							{
+								uint32_t sum{ 2 };
+								for (uint32_t corner : corners)
+									sum += source.singleTexels[corner];
+								level.singleTexels[index] = uint8_t(sum / 4);
+								break;
+							}
+							case TextureFormat::Normal:
+							{
+								Vector3 sum{};
+								for (uint32_t corner : corners)
+									sum += source.normalTexels[corner];
+								level.normalTexels[index] = sum.SqrMagnitude() > 0.0f ? sum.Normalized() : Vector3::UnitZ;
+								break;
+							}
+							default:
+								break;
+							}
+						}
+					}
+				});
+
+			m_Levels.push_back(std::move(level));
+		}
+	}
+
+	void Texture::SetStorageSize(Level& level, TextureLayout layout)
+	{
+		level.layout = layout;
+		switch (layout)
+		{
+		case TextureLayout::Linear:
+			level.storageWidth  = level.width;
+			level.storageHeight = level.height;
+			break;
+		case TextureLayout::Tiled4x4:
+			level.storageWidth  = (level.width + 3) & ~3;
+			level.storageHeight = (level.height + 3) & ~3;
+			break;
+		case TextureLayout::Morton:
+			level.storageWidth  = int(std::bit_ceil(uint32_t(level.width)));
+			level.storageHeight = int(std::bit_ceil(uint32_t(level.height)));
+			break;
+		}
+		level.mortonBits = std::countr_zero(uint32_t(std::min(level.storageWidth, level.storageHeight)));
+	}
+
+	uint32_t Texture::GetTexelAddress(const Level& level, uint32_t u, uint32_t v)
+	{
+		switch (level.layout)
+		{
+		case TextureLayout::Tiled4x4:
+		{
+			//Block index * 16 + offset inside the block
+			const uint32_t block{ (u >> 2) + (v >> 2) * (uint32_t(level.storageWidth) >> 2) };
+			return (block << 4) | ((v & 3) << 2) | (u & 3);
+		}
+		case TextureLayout::Morton:
+		{
+			//Interleave the bits off the square part, the longer side appends its remaining high bits
+			const uint32_t squareMask{ (1u << level.mortonBits) - 1 };
+			const uint32_t high{ (u >> level.mortonBits) | (v >> level.mortonBits) };
+			return MortonEncode(u & squareMask, v & squareMask) | (high << (2 * level.mortonBits));
+		}
+		default:
+			return u + v * uint32_t(level.width);
+		}
+	}
+
+	void Texture::SetLayout(TextureLayout layout)
+	{
+		if (layout == m_Layout || IsBlockCompressed())
+			return;
+
+		for (Level& level : m_Levels)
+		{
+			Level relaidLevel{ level };
+			SetStorageSize(relaidLevel, layout);
+			const size_t storageSize{ size_t(relaidLevel.storageWidth) * relaidLevel.storageHeight };
+
+			const auto oldAddress = [&level](int u, int v) { return GetTexelAddress(level, u, v); };
+			const auto newAddress = [&relaidLevel](int u, int v) { return GetTexelAddress(relaidLevel, u, v); };
+			Relayout(relaidLevel.colorTexels, storageSize, level.width, level.height, oldAddress, newAddress);
+			Relayout(relaidLevel.singleTexels, storageSize, level.width, level.height, oldAddress, newAddress);
+			Relayout(relaidLevel.normalTexels, storageSize, level.width, level.height, oldAddress, newAddress);
+
+			level = std::move(relaidLevel);
+		}
+		m_Layout = layout;
+	}
+
+	size_t Texture::GetMemorySize() const
+	{
+		size_t memorySize{};
+		for (const Level& level : m_Levels)
+		{
+			memorySize += level.colorTexels.size() * sizeof(uint32_t)
+				+ level.singleTexels.size() * sizeof(uint8_t)
+				+ level.normalTexels.size() * sizeof(Vector3)
+				+ level.blocks.size() * sizeof(uint64_t);
+		}
+		return memorySize;
+	}
+
+	bool Texture::IsBlockCompressed() const
+	{
+		return IsBlockCompressedFormat(m_Format);
+	}
+
+	void Texture::Compress(TextureFormat format)
+	{
+		for (Level& level : m_Levels)
+		{
+			Level compressedLevel{};
+			compressedLevel.width  = level.width;
+			compressedLevel.height = level.height;
+			SetStorageSize(compressedLevel, TextureLayout::Tiled4x4);
+
+			const int blocksX{ compressedLevel.storageWidth / 4 };
+			const int blocksY{ compressedLevel.storageHeight / 4 };
+			compressedLevel.blocks.resize(size_t(blocksX) * blocksY * GetBlockWords(format));
+
+			ParallelForRows(blocksY, [&level, &compressedLevel, blocksX, format](int firstRow, int endRow)
+				{
+					for (int blockY{ firstRow }; blockY < endRow; ++blockY)
+					{
+						for (int blockX{}; blockX < blocksX; ++blockX)
+						{
+							//Texels past the edge repeat the last row/column
+							uint32_t colors[16]{};
+							uint8_t valuesX[16]{};
+							uint8_t valuesY[16]{};
+							for (int i{}; i < 16; ++i)
+							{
+								const int u{ std::min(blockX * 4 + (i & 3), level.width - 1) };
+								const int v{ std::min(blockY * 4 + (i >> 2), level.height - 1) };
+								const uint32_t address{ GetTexelAddress(level, u, v) };
+								switch (format)
+								{
+								case TextureFormat::BC1:
+									colors[i] = level.colorTexels[address];
+									break;
+								case TextureFormat::BC4:
+									valuesX[i] = level.singleTexels[address];
+									break;
+								default:
+								{
+									//Only xy is stored, so it has to come from a unit normal for z to reconstruct
+									const Vector3 normal{ level.normalTexels[address].Normalized() };
+									valuesX[i] = ToSnormByte(normal.x);
+									valuesY[i] = ToSnormByte(normal.y);
+									break;
+								}
+								}
+							}
+
+							const size_t block{ size_t(blockX) + size_t(blockY) * blocksX };
+							switch (format)
+							{
+							case TextureFormat::BC1:
+								compressedLevel.blocks[block] = BlockCompression::EncodeBC1(colors);
+								break;
+							case TextureFormat::BC4:
+								compressedLevel.blocks[block] = BlockCompression::EncodeBC4(valuesX);
+								break;
+							default:
+								compressedLevel.blocks[2 * block]     = BlockCompression::EncodeBC4(valuesX);
+								compressedLevel.blocks[2 * block + 1] = BlockCompression::EncodeBC4(valuesY);
+								break;
+							}
+						}
+					}
+				});
+
+			level = std::move(compressedLevel);
+		}
+
+		m_Format = format;
+		m_Layout = TextureLayout::Tiled4x4;
+		m_Id     = g_NextTextureId++;
+	}
+
+	Texture* Texture::LoadCompressedCache(const std::string& path, const std::string& cachePath, TextureFormat format, bool streamed)
+	{
+		std::error_code error{};
+		const auto cacheTime{ std::filesystem::last_write_time(cachePath, error) };
+		if (error || cacheTime < std::filesystem::last_write_time(path, error) || error)
+			return nullptr;
+
+		std::ifstream file{ cachePath, std::ios::binary };
+		CompressedCacheHeader header{};
+		const CompressedCacheHeader expected{};
+		if (!file.read(reinterpret_cast<char*>(&header), sizeof(header))
+			|| !std::equal(header.magic, header.magic + 4, expected.magic)
+			|| header.version != expected.version
+			|| header.format != uint32_t(format)
+			|| header.width <= 0 || header.height <= 0 || header.levelCount <= 0)
+			return nullptr;
+
+		Texture* pTexture{ new Texture() };
+		pTexture->m_Format = format;
+		pTexture->m_Layout = TextureLayout::Tiled4x4;
+		pTexture->m_Id     = g_NextTextureId++;
+		int width{ header.width };
+		int height{ header.height };
+		for (int levelIndex{}; levelIndex < header.levelCount; ++levelIndex)
+		{
+			Level& level{ pTexture->m_Levels.emplace_back() };
+			level.width  = width;
+			level.height = height;
+			SetStorageSize(level, TextureLayout::Tiled4x4);
+			const size_t blockCount{ size_t(level.storageWidth / 4) * (level.storageHeight / 4) * GetBlockWords(format) };
+			pTexture->m_LevelOffsets.push_back(file.tellg());
+
+			//Streamed levels above the pinned size are only sized, their blocks stay on disk until requested
+			if (streamed && std::max(width, height) > StreamedPinnedSize)
+			{
+				pTexture->m_ResidentLevel = levelIndex + 1;
+				file.seekg(blockCount * sizeof(uint64_t), std::ios::cur);
+			}
+			else
+			{
+				level.blocks.resize(blockCount);
+				file.read(reinterpret_cast<char*>(level.blocks.data()), level.blocks.size() * sizeof(uint64_t));
+			}
+
+			if (!file)
+			{
+				delete pTexture;
+				return nullptr;
+			}
+
+			width  = std::max(width / 2, 1);
+			height = std::max(height / 2, 1);
+		}
+
+		if (streamed)
+		{
+			pTexture->m_StreamPath  = cachePath;
+			pTexture->m_PinnedLevel = pTexture->m_ResidentLevel;
+		}
+		return pTexture;
+	}
+
+	void Texture::SaveCompressedCache(const std::string& cachePath) const
+	{
+		std::ofstream file{ cachePath, std::ios::binary };
+		if (!file)
+		{
+			printf("Unable to write texture cache %s\n", cachePath.c_str());
+			return;
+		}
+
+		CompressedCacheHeader header{};
+		header.format     = uint32_t(m_Format);
+		header.width      = GetWidth();
+		header.height     = GetHeight();
+		header.levelCount = GetLevelCount();
+		file.write(reinterpret_cast<const char*>(&header), sizeof(header));
+		for (const Level& level : m_Levels)
+			file.write(reinterpret_cast<const char*>(level.blocks.data()), level.blocks.size() * sizeof(uint64_t));
+	}
+
+	size_t Texture::GetLevelBlockCount(int level) const
+	{
+		return size_t(m_Levels[level].storageWidth / 4) * (m_Levels[level].storageHeight / 4) * GetBlockWords(m_Format);
+	}
+
+	std::vector<uint64_t> Texture::ReadStreamedLevel(int level) const
+	{
+		//Only reads data that is fixed after loading, so it can run next to the samplers
+		std::vector<uint64_t> blocks(GetLevelBlockCount(level));
+		std::ifstream file{ m_StreamPath, std::ios::binary };
+		if (!file.seekg(m_LevelOffsets[level]) || !file.read(reinterpret_cast<char*>(blocks.data()), blocks.size() * sizeof(uint64_t)))
+		{
+			printf("Unable to stream level %d off %s\n", level, m_StreamPath.c_str());
+			blocks.clear();
+		}
+		return blocks;
+	}
+
+	void Texture::MakeLevelResident(std::vector<uint64_t>&& blocks)
+	{
+		m_Levels[m_ResidentLevel - 1].blocks = std::move(blocks);
+		--m_ResidentLevel;
+
+		//The new blocks can reuse the address off evicted ones, a new id keeps the decoded block cache from returning stale texels
+		m_Id = g_NextTextureId++;
+	}
+
+	void Texture::EvictLevel()
+	{
+		std::vector<uint64_t>{}.swap(m_Levels[m_ResidentLevel].blocks);
+		++m_ResidentLevel;
+	}
+
+	const uint32_t* Texture::GetDecodedBlock(const Level& level, uint32_t block) const
+	{
+		//Direct mapped, neighbouring fetches mostly hit the block decoded for the previous pixel
+		struct DecodedBlock
+		{
+			uint32_t textureId{};
+			const uint64_t* pBlock{};
+			uint32_t texels[16]{};
+		};
+		thread_local std::array<DecodedBlock, 256> decodedBlocks{};
+
+		const int blockWords{ GetBlockWords(m_Format) };
+		const uint64_t* pBlock{ level.blocks.data() + size_t(block) * blockWords };
+		DecodedBlock& entry{ decodedBlocks[((reinterpret_cast<uintptr_t>(pBlock) >> 3) * 0x9E3779B1u >> 8) & 255] };
+		if (entry.pBlock == pBlock && entry.textureId == m_Id)
+			return entry.texels;
+
+		entry.textureId = m_Id;
+		entry.pBlock    = pBlock;
+		switch (m_Format)
+		{
+		case TextureFormat::BC1:
+			BlockCompression::DecodeBC1(pBlock[0], entry.texels);
+			break;
+		case TextureFormat::BC4:
+		{
+			uint8_t values[16]{};
+			BlockCompression::DecodeBC4(pBlock[0], values);
+			for (int i{}; i < 16; ++i)
+				entry.texels[i] = values[i];
+			break;
+		}
+		default:
+		{
+			uint8_t valuesX[16]{};
+			uint8_t valuesY[16]{};
+			BlockCompression::DecodeBC4(pBlock[0], valuesX);
+			BlockCompression::DecodeBC4(pBlock[1], valuesY);
+			for (int i{}; i < 16; ++i)
+				entry.texels[i] = valuesX[i] | (valuesY[i] << 8);
+			break;
+		}
+		}
+		return entry.texels;
+	}
+
+	uint32_t Texture::FetchColor(const Level& level, uint32_t address) const
+	{
+		if (level.blocks.empty())
+			return level.colorTexels[address];
+		return GetDecodedBlock(level, address >> 4)[address & 15];
+	}
+
+	uint8_t Texture::FetchSingle(const Level& level, uint32_t address) const
+	{
+		if (level.blocks.empty())
+			return level.singleTexels[address];
+		return uint8_t(GetDecodedBlock(level, address >> 4)[address & 15]);
+	}
+
+	Vector3 Texture::FetchNormal(const Level& level, uint32_t address) const
+	{
+		if (level.blocks.empty())
+			return level.normalTexels[address];
+
+		const uint32_t texel{ GetDecodedBlock(level, address >> 4)[address & 15] };
+		const float x{ (texel & 0xFF) / 255.0f * 2.0f - 1.0f };
+		const float y{ ((texel >> 8) & 0xFF) / 255.0f * 2.0f - 1.0f };
+		return Vector3{ x, y, std::sqrt(std::max(0.0f, 1.0f - x * x - y * y)) };
+	}
+
+	uint32_t Texture::GetTexelIndex(const Level& level, const Vector2& uv) const
 	{
-		//TODO
 		//Sample the correct texel for the given uv
 		const float uNormal{ std::ranges::clamp(uv.x, 0.f, 1.f) };
 		const float vNormal{ std::ranges::clamp(uv.y, 0.f, 1.f) };
 
-		const Uint32 u{ Uint32 (uNormal * m_pSurface->w) };
-		const Uint32 v{ Uint32 (vNormal * m_pSurface->h) };
+		const Uint32 u{ std::min(Uint32(uNormal * level.width ), Uint32(level.width  - 1)) };
+		const Uint32 v{ std::min(Uint32(vNormal * level.height), Uint32(level.height - 1)) };
 
-		//const Uint32 totPxl{ Uint32(m_pSurface->w * m_pSurface->h) };
+		return GetTexelAddress(level, u, v);
+	}
 
-		Uint32 pxl{ ( u  + (v * m_pSurface->w )) };
+	Texture::BilinearFootprint Texture::GetBilinearFootprint(const Level& level, const Vector2& uv) const
+	{
+		//Texel centers sit at +0.5, the footprint is clamped to the edge
+		const float x{ std::ranges::clamp(uv.x, 0.f, 1.f) * level.width  - 0.5f };
+		const float y{ std::ranges::clamp(uv.y, 0.f, 1.f) * level.height - 0.5f };
+		const float floorX{ std::floor(x) };
+		const float floorY{ std::floor(y) };
 
-		Uint8 r{}, b{}, g{};
+		const int u0{ Clamp(int(floorX), 0, level.width - 1) };
+		const int v0{ Clamp(int(floorY), 0, level.height - 1) };
+		const int u1{ Clamp(int(floorX) + 1, 0, level.width - 1) };
+		const int v1{ Clamp(int(floorY) + 1, 0, level.height - 1) };
 
-		SDL_GetRGB(m_pSurfacePixels[pxl], m_pSurface->format, &r, &g, &b);
+		return BilinearFootprint{
+			{ GetTexelAddress(level, u0, v0), GetTexelAddress(level, u1, v0), GetTexelAddress(level, u0, v1), GetTexelAddress(level, u1, v1) },
+			Saturate(x - floorX),
+			Saturate(y - floorY) };
+	}
 
-		return { ColorRGB{(float)r, (float)g, (float)b}/ 255.0f };
+	int Texture::GetNearestLevel(float lod) const
+	{
+		return RequestLevel(Clamp(int(lod + 0.5f), 0, GetLevelCount() - 1));
 	}
-	Vector3 Texture::SampleNormal(const Vector2& uv) const
+
+	int Texture::RequestLevel(int level) const
 	{
-		ColorRGB c = Sample(uv);
+		if (!IsStreamed())
+			return level;
 
-		return Vector3(c.r * 2.0f -1.0f, c.g * 2.0f - 1.0f, c.b *2.0f - 1.0f);
+		//Relaxed min, only the streamer reads it and only between frames
+		int requestedLevel{ m_RequestedLevel.load(std::memory_order_relaxed) };
+		while (level < requestedLevel && !m_RequestedLevel.compare_exchange_weak(requestedLevel, level, std::memory_order_relaxed))
+		{
+		}
+		return std::max(level, m_ResidentLevel);
+	}
+
+	int Texture::TakeRequestedLevel() const
+	{
+		return std::min(m_RequestedLevel.exchange(std::numeric_limits<int>::max(), std::memory_order_relaxed), GetLevelCount());
+	}
+
+	float Texture::CalculateLod(const Vector2& uvDdx, const Vector2& uvDdy) const
+	{
+		//Texels stepped per pixel along the longest screen axis
+		const float width{ float(GetWidth()) };
+		const float height{ float(GetHeight()) };
+		const float lengthX{ Square(uvDdx.x * width) + Square(uvDdx.y * height) };
+		const float lengthY{ Square(uvDdy.x * width) + Square(uvDdy.y * height) };
+		const float maxLength{ std::max(lengthX, lengthY) };
+		if (maxLength <= 1.0f)
+			return 0.0f;
+
+		//log2(sqrt(x)) == 0.5 * log2(x)
+		return std::min(0.5f * std::log2(maxLength), float(GetLevelCount() - 1));
+	}
+
+	ColorRGB Texture::Sample(const Vector2& uv) const
+	{
+		const Level& level{ m_Levels[RequestLevel(0)] };
+		return ToColor(FetchColor(level, GetTexelIndex(level, uv)));
+	}
+
+	Vector3 Texture::SampleNormal(const Vector2& uv) const
+	{
+		const Level& level{ m_Levels[RequestLevel(0)] };
+		return FetchNormal(level, GetTexelIndex(level, uv));
 	}
 
 	float Texture::SampleFloat(const Vector2& uv) const
 	{
-		ColorRGB c = Sample(uv);
+		constexpr float toFloat{ 1.0f / 255.0f };
+		const Level& level{ m_Levels[RequestLevel(0)] };
+		return FetchSingle(level, GetTexelIndex(level, uv)) * toFloat;
+	}
+
+	ColorRGB Texture::SampleNearestMip(const Vector2& uv, float lod) const
+	{
+		const Level& level{ m_Levels[GetNearestLevel(lod)] };
+		return ToColor(FetchColor(level, GetTexelIndex(level, uv)));
+	}
+
+	Vector3 Texture::SampleNormalNearestMip(const Vector2& uv, float lod) const
+	{
+		const Level& level{ m_Levels[GetNearestLevel(lod)] };
+		return FetchNormal(level, GetTexelIndex(level, uv));
+	}
+
+	float Texture::SampleFloatNearestMip(const Vector2& uv, float lod) const
+	{
+		constexpr float toFloat{ 1.0f / 255.0f };
+		const Level& level{ m_Levels[GetNearestLevel(lod)] };
+		return FetchSingle(level, GetTexelIndex(level, uv)) * toFloat;
+	}
+
+	ColorRGB Texture::SampleTrilinear(const Vector2& uv, float lod) const
+	{
+		const int level0{ RequestLevel(Clamp(int(lod), 0, GetLevelCount() - 1)) };
+		const int level1{ std::min(level0 + 1, GetLevelCount() - 1) };
+		const float blend{ Saturate(lod - level0) };
+
+		const ColorRGB color0{ SampleBilinear(m_Levels[level0], uv) };
+		if (blend == 0.0f || level0 == level1)
+			return color0;
+		return ColorRGB::Lerp(color0, SampleBilinear(m_Levels[level1], uv), blend);
+	}
+
+	Vector3 Texture::SampleNormalTrilinear(const Vector2& uv, float lod) const
+	{
+		const int level0{ RequestLevel(Clamp(int(lod), 0, GetLevelCount() - 1)) };
+		const int level1{ std::min(level0 + 1, GetLevelCount() - 1) };
+		const float blend{ Saturate(lod - level0) };
+
+		const Vector3 normal0{ SampleNormalBilinear(m_Levels[level0], uv) };
+		if (blend == 0.0f || level0 == level1)
+			return normal0;
+		return (normal0 * (1.0f - blend) + SampleNormalBilinear(m_Levels[level1], uv) * blend).Normalized();
+	}
+
+	float Texture::SampleFloatTrilinear(const Vector2& uv, float lod) const
+	{
+		const int level0{ RequestLevel(Clamp(int(lod), 0, GetLevelCount() - 1)) };
+		const int level1{ std::min(level0 + 1, GetLevelCount() - 1) };
+		const float blend{ Saturate(lod - level0) };
+
+		const float value0{ SampleFloatBilinear(m_Levels[level0], uv) };
+		if (blend == 0.0f || level0 == level1)
+			return value0;
+		return Lerpf(value0, SampleFloatBilinear(m_Levels[level1], uv), blend);
+	}
+
+	ColorRGB Texture::SampleBilinear(const Level& level, const Vector2& uv) const
+	{
+		const BilinearFootprint footprint{ GetBilinearFootprint(level, uv) };
+		const ColorRGB top{ ColorRGB::Lerp(ToColor(FetchColor(level, footprint.indices[0])), ToColor(FetchColor(level, footprint.indices[1])), footprint.weightU) };
+		const ColorRGB bottom{ ColorRGB::Lerp(ToColor(FetchColor(level, footprint.indices[2])), ToColor(FetchColor(level, footprint.indices[3])), footprint.weightU) };
+		return ColorRGB::Lerp(top, bottom, footprint.weightV);
+	}
+
+	Vector3 Texture::SampleNormalBilinear(const Level& level, const Vector2& uv) const
+	{
+		const BilinearFootprint footprint{ GetBilinearFootprint(level, uv) };
+		const float weights[4]
+		{
+			(1.0f - footprint.weightU) * (1.0f - footprint.weightV),
+			footprint.weightU * (1.0f - footprint.weightV),
+			(1.0f - footprint.weightU) * footprint.weightV,
+			footprint.weightU * footprint.weightV
+		};
+
+		Vector3 normal{};
+		for (int corner{}; corner < 4; ++corner)
+			normal += FetchNormal(level, footprint.indices[corner]) * weights[corner];
+		return normal.Normalized();
+	}
+
+	float Texture::SampleFloatBilinear(const Level& level, const Vector2& uv) const
+	{
+		constexpr float toFloat{ 1.0f / 255.0f };
+		const BilinearFootprint footprint{ GetBilinearFootprint(level, uv) };
+		const float top{ Lerpf(FetchSingle(level, footprint.indices[0]), FetchSingle(level, footprint.indices[1]), footprint.weightU) };
+		const float bottom{ Lerpf(FetchSingle(level, footprint.indices[2]), FetchSingle(level, footprint.indices[3]), footprint.weightU) };
+		return Lerpf(top, bottom, footprint.weightV) * toFloat;
+	}
+
+	void Texture::SampleBilinearBatch(const Vector2* pUvs, ColorRGB* pColors, int count, float lod, TextureAddressMode addressMode) const
+	{
+		const Level& level{ m_Levels[GetNearestLevel(lod)] };
+		int first{};
+		//Gathers need uncompressed texels and an AVX2 CPU, everything else takes the scalar path
+		static const bool hasAvx2{ HasAvx2() };
+		if (hasAvx2 && level.blocks.empty())
+		{
+			const TextureGather::Level gatherLevel{ level.colorTexels.data(), level.width, level.height, level.storageWidth, level.mortonBits, level.layout };
+
+			//A partial batch off at least 4 is padded with its last uv
+			for (; count - first >= 4; first += std::min(count - first, 8))
+			{
+				float us[8], vs[8], reds[8], greens[8], blues[8];
+				for (int i{}; i < 8; ++i)
+				{
+					us[i] = pUvs[std::min(first + i, count - 1)].x;
+					vs[i] = pUvs[std::min(first + i, count - 1)].y;
+				}
+				TextureGather::SampleBilinear8(gatherLevel, us, vs, addressMode, reds, greens, blues);
+				for (int i{}; i < std::min(count - first, 8); ++i)
+					pColors[first + i] = ColorRGB{ reds[i], greens[i], blues[i] };
+			}
+		}
+		for (; first < count; ++first)
+			pColors[first] = SampleBilinearFixed(level, pUvs[first], addressMode);
+	}
+
+	ColorRGB Texture::SampleBilinearFixed(const Level& level, const Vector2& uv, TextureAddressMode addressMode) const
+	{
+		const float x{ uv.x * level.width - 0.5f };
+		const float y{ uv.y * level.height - 0.5f };
+		const float floorX{ std::floor(x) };
+		const float floorY{ std::floor(y) };
+		const uint32_t weightU{ uint32_t((x - floorX) * 256.0f + 0.5f) };
+		const uint32_t weightV{ uint32_t((y - floorY) * 256.0f + 0.5f) };
+
+		const int u0{ AddressTexel(int(floorX), level.width, addressMode) };
+		const int u1{ AddressTexel(int(floorX) + 1, level.width, addressMode) };
+		const int v0{ AddressTexel(int(floorY), level.height, addressMode) };
+		const int v1{ AddressTexel(int(floorY) + 1, level.height, addressMode) };
 
-		return c.r;
+		const uint32_t top{ LerpTexels(FetchColor(level, GetTexelAddress(level, u0, v0)), FetchColor(level, GetTexelAddress(level, u1, v0)), weightU) };
+		const uint32_t bottom{ LerpTexels(FetchColor(level, GetTexelAddress(level, u0, v1)), FetchColor(level, GetTexelAddress(level, u1, v1)), weightU) };
+		return ToColor(LerpTexels(top, bottom, weightV));
 	}
 }
\ No newline at end of file
@@ -1,29 +1,167 @@
 #pragma once
 #include <SDL_surface.h>
+#include <atomic>
+#include <ios>
+#include <limits>
 #include <string>
+#include <vector>
 #include "ColorRGB.h"
+#include "Vector3.h"
 
 namespace dae
 {
 	struct Vector2;
-	struct Vector3;
+
+	//Internal texel layout, picked per use when the texture is loaded
+	enum class TextureFormat
+	{
+		RGBA8,  //color, 4 bytes per texel
+		R8,     //single channel (gloss), 1 byte per texel
+		Normal, //normal map, pre-expanded to [-1, 1], 3 floats per texel
+		BC1,    //block compressed color, 0.5 byte per texel, sampled like RGBA8
+		BC4,    //block compressed single channel, 0.5 byte per texel, sampled like R8
+		BC5     //block compressed normal xy, 1 byte per texel, z is reconstructed, sampled like Normal
+	};
+
+	//Order off the texels in memory, swizzled layouts keep 2D neighbours close together
+	enum class TextureLayout
+	{
+		Linear,   //row major, u + v * width
+		Tiled4x4, //row major 4x4 blocks off 16 texels
+		Morton    //Z-order curve, storage padded to power of two sizes
+	};
+
+	//Addressing off uvs outside [0, 1]
+	enum class TextureAddressMode
+	{
+		Clamp,
+		Wrap
+	};
 
 	class Texture
 	{
 	public:
-		~Texture();
+		~Texture() = default;
 
-		static Texture* LoadFromFile(const std::string& path);
+		//Block compressed formats are compressed once and cached next to the image as path.bc1/.bc4/.bc5
+		static Texture* LoadFromFile(const std::string& path, TextureFormat format = TextureFormat::RGBA8);
+		//Block compressed textures only keep their coarse levels resident, the finer ones are read from the cache by a TextureStreamer
+		//Other formats load like LoadFromFile
+		static Texture* LoadStreamed(const std::string& path, TextureFormat format);
+		//Texels generated at runtime, pRGBA holds width * height texels with r in the lowest byte
+		//Block compressed formats are compressed from their source format, nothing is cached
+		static Texture* CreateFromPixels(int width, int height, const uint32_t* pRGBA, TextureFormat format = TextureFormat::RGBA8);
+		//RGBA8 and BC1 textures only
 		ColorRGB Sample(const Vector2& uv) const;
-		//return value in [-1, 1]
+		//Normal and BC5 textures only, return value in [-1, 1]
 		Vector3 SampleNormal(const Vector2& uv) const;
-		//return 1 off the components as a float
+		//R8 and BC4 textures only, return the single channel as a float
 		float SampleFloat(const Vector2& uv) const;
 
+		//Nearest texel off the mip level closest to lod
+		ColorRGB SampleNearestMip(const Vector2& uv, float lod) const;
+		Vector3 SampleNormalNearestMip(const Vector2& uv, float lod) const;
+		float SampleFloatNearestMip(const Vector2& uv, float lod) const;
+
+		//Bilinear in the 2 mip levels around lod, blended by the fraction off lod
+		ColorRGB SampleTrilinear(const Vector2& uv, float lod) const;
+		Vector3 SampleNormalTrilinear(const Vector2& uv, float lod) const;
+		float SampleFloatTrilinear(const Vector2& uv, float lod) const;
+
+		//RGBA8 textures only, bilinear filter off count uvs in the mip level closest to lod
+		//8 bit fixed point weights, 8 uvs per step with AVX2 gathers when the CPU has them
+		void SampleBilinearBatch(const Vector2* pUvs, ColorRGB* pColors, int count, float lod, TextureAddressMode addressMode = TextureAddressMode::Clamp) const;
+
+		//Mip level for the screen space uv derivatives, clamped to the available levels
+		float CalculateLod(const Vector2& uvDdx, const Vector2& uvDdy) const;
+
+		int GetWidth() const { return m_Levels[0].width; }
+		int GetHeight() const { return m_Levels[0].height; }
+		int GetLevelCount() const { return int(m_Levels.size()); }
+		TextureFormat GetFormat() const { return m_Format; }
+		TextureLayout GetLayout() const { return m_Layout; }
+		size_t GetMemorySize() const;
+		bool IsBlockCompressed() const;
+		bool IsStreamed() const { return !m_StreamPath.empty(); }
+		//Finest mip level in memory, sampling clamps to it
+		int GetResidentLevel() const { return m_ResidentLevel; }
+
+		//Reorders the texels off every level, sampling results stay the same
+		//Block compressed textures keep their 4x4 block order
+		void SetLayout(TextureLayout layout);
+
 	private:
-		Texture(SDL_Surface* pSurface);
+		friend class TextureStreamer;
+
+		//Only the array matching m_Format is filled, the storage size includes the padding off the layout
+		struct Level
+		{
+			int width{};
+			int height{};
+			TextureLayout layout{};
+			int storageWidth{};
+			int storageHeight{};
+			int mortonBits{}; //log2 off the smallest storage side
+			std::vector<uint32_t> colorTexels{};
+			std::vector<uint8_t> singleTexels{};
+			std::vector<Vector3> normalTexels{};
+			std::vector<uint64_t> blocks{}; //4x4 blocks in Tiled4x4 order, 2 per block for BC5
+		};
+
+		//Texels and weights off a bilinear footprint
+		struct BilinearFootprint
+		{
+			uint32_t indices[4]{};
+			float weightU{};
+			float weightV{};
+		};
+
+		Texture() = default;
+		Texture(SDL_Surface* pSurface, TextureFormat format);
+
+		void Compress(TextureFormat format);
+		static Texture* LoadCompressedCache(const std::string& path, const std::string& cachePath, TextureFormat format, bool streamed = false);
+		void SaveCompressedCache(const std::string& cachePath) const;
+
+		//Texel at an address from GetTexelAddress, block compressed levels decode through a small per thread cache
+		uint32_t FetchColor(const Level& level, uint32_t address) const;
+		uint8_t FetchSingle(const Level& level, uint32_t address) const;
+		Vector3 FetchNormal(const Level& level, uint32_t address) const;
+		const uint32_t* GetDecodedBlock(const Level& level, uint32_t block) const;
+
+		void GenerateMipLevels();
+		static void SetStorageSize(Level& level, TextureLayout layout);
+		static uint32_t GetTexelAddress(const Level& level, uint32_t u, uint32_t v);
+		uint32_t GetTexelIndex(const Level& level, const Vector2& uv) const;
+		BilinearFootprint GetBilinearFootprint(const Level& level, const Vector2& uv) const;
+		int GetNearestLevel(float lod) const;
+
+		//Records level as wanted this frame and returns the finest resident level that can stand in for it
+		int RequestLevel(int level) const;
+		//Finest level requested since the last call, GetLevelCount when nothing was sampled
+		int TakeRequestedLevel() const;
+		size_t GetLevelBlockCount(int level) const;
+		//Thread safe, empty when the cache could not be read
+		std::vector<uint64_t> ReadStreamedLevel(int level) const;
+		//Only between frames, while no sampler reads the texture
+		void MakeLevelResident(std::vector<uint64_t>&& blocks);
+		void EvictLevel();
+
+		ColorRGB SampleBilinear(const Level& level, const Vector2& uv) const;
+		Vector3 SampleNormalBilinear(const Level& level, const Vector2& uv) const;
+		float SampleFloatBilinear(const Level& level, const Vector2& uv) const;
+		ColorRGB SampleBilinearFixed(const Level& level, const Vector2& uv, TextureAddressMode addressMode) const;
+
+		TextureFormat m_Format{};
+		TextureLayout m_Layout{ TextureLayout::Linear };
+		uint32_t m_Id{}; //keys the decoded block cache
+		std::vector<Level> m_Levels{};
 
-		SDL_Surface* m_pSurface{ nullptr };
-		uint32_t* m_pSurfacePixels{ nullptr };
+		//Streaming state, the levels from m_PinnedLevel on never leave memory
+		std::string m_StreamPath{};
+		std::vector<std::streamoff> m_LevelOffsets{};
+		int m_ResidentLevel{};
+		int m_PinnedLevel{};
+		mutable std::atomic<int> m_RequestedLevel{ std::numeric_limits<int>::max() };
 	};
-}
\ No newline at end of file
+}
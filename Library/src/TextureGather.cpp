@@ -0,0 +1,129 @@
+#include "TextureGather.h"
+#include <immintrin.h>
+
+//Built with AVX2, so nothing inline from another header is called here: the linker could pick this copy for every caller
+namespace dae
+{
+	namespace
+	{
+		bool IsPowerOfTwo(int size)
+		{
+			return size > 0 && (size & (size - 1)) == 0;
+		}
+
+		int Log2(int size)
+		{
+			int log{};
+			while ((1 << (log + 1)) <= size)
+				++log;
+			return log;
+		}
+
+		__m256i AddressTexels(__m256i texel, int size, TextureAddressMode addressMode)
+		{
+			if (addressMode == TextureAddressMode::Clamp)
+				return _mm256_min_epi32(_mm256_max_epi32(texel, _mm256_setzero_si256()), _mm256_set1_epi32(size - 1));
+			if (IsPowerOfTwo(size))
+				return _mm256_and_si256(texel, _mm256_set1_epi32(size - 1));
+
+			//texel - size * floor(texel / size), the float division can be off by one wrap so fix up both ends
+			const __m256 texelFloat{ _mm256_cvtepi32_ps(texel) };
+			const __m256 wraps{ _mm256_floor_ps(_mm256_mul_ps(texelFloat, _mm256_set1_ps(1.0f / size))) };
+			const __m256i sizes{ _mm256_set1_epi32(size) };
+			__m256i wrapped{ _mm256_sub_epi32(texel, _mm256_mullo_epi32(_mm256_cvtps_epi32(wraps), sizes)) };
+			wrapped = _mm256_add_epi32(wrapped, _mm256_and_si256(_mm256_cmpgt_epi32(_mm256_setzero_si256(), wrapped), sizes));
+			wrapped = _mm256_sub_epi32(wrapped, _mm256_andnot_si256(_mm256_cmpgt_epi32(sizes, wrapped), sizes));
+			return wrapped;
+		}
+
+		__m256i SpreadBits(__m256i v)
+		{
+			v = _mm256_and_si256(_mm256_or_si256(v, _mm256_slli_epi32(v, 8)), _mm256_set1_epi32(0x00FF00FF));
+			v = _mm256_and_si256(_mm256_or_si256(v, _mm256_slli_epi32(v, 4)), _mm256_set1_epi32(0x0F0F0F0F));
+			v = _mm256_and_si256(_mm256_or_si256(v, _mm256_slli_epi32(v, 2)), _mm256_set1_epi32(0x33333333));
+			v = _mm256_and_si256(_mm256_or_si256(v, _mm256_slli_epi32(v, 1)), _mm256_set1_epi32(0x55555555));
+			return v;
+		}
+
+		//Same addressing as Texture::GetTexelAddress, 8 texels at once
+		__m256i TexelAddresses(__m256i u, __m256i v, const TextureGather::Level& level)
+		{
+			switch (level.layout)
+			{
+			case TextureLayout::Tiled4x4:
+			{
+				const __m256i three{ _mm256_set1_epi32(3) };
+				const __m256i block{ _mm256_add_epi32(_mm256_srli_epi32(u, 2), _mm256_mullo_epi32(_mm256_srli_epi32(v, 2), _mm256_set1_epi32(level.storageWidth >> 2))) };
+				return _mm256_or_si256(_mm256_slli_epi32(block, 4), _mm256_or_si256(_mm256_slli_epi32(_mm256_and_si256(v, three), 2), _mm256_and_si256(u, three)));
+			}
+			case TextureLayout::Morton:
+			{
+				const __m128i bits{ _mm_cvtsi32_si128(level.mortonBits) };
+				const __m128i doubleBits{ _mm_cvtsi32_si128(2 * level.mortonBits) };
+				const __m256i squareMask{ _mm256_set1_epi32((1 << level.mortonBits) - 1) };
+				const __m256i high{ _mm256_or_si256(_mm256_srl_epi32(u, bits), _mm256_srl_epi32(v, bits)) };
+				const __m256i square{ _mm256_or_si256(SpreadBits(_mm256_and_si256(u, squareMask)), _mm256_slli_epi32(SpreadBits(_mm256_and_si256(v, squareMask)), 1)) };
+				return _mm256_or_si256(square, _mm256_sll_epi32(high, doubleBits));
+			}
+			default:
+				//Power of two rows are a shift instead off a multiply
+				if (IsPowerOfTwo(level.width))
+					return _mm256_add_epi32(u, _mm256_sll_epi32(v, _mm_cvtsi32_si128(Log2(level.width))));
+				return _mm256_add_epi32(u, _mm256_mullo_epi32(v, _mm256_set1_epi32(level.width)));
+			}
+		}
+
+		//Lerp off 8 pairs off packed RGBA8 texels, the 16 bit multiplies keep red/blue and green/alpha packed
+		__m256i LerpTexels(__m256i a, __m256i b, __m256i weight)
+		{
+			const __m256i mask{ _mm256_set1_epi32(0x00FF00FF) };
+			const __m256i weight16{ _mm256_or_si256(weight, _mm256_slli_epi32(weight, 16)) };
+			const __m256i inverseWeight16{ _mm256_sub_epi16(_mm256_set1_epi16(256), weight16) };
+
+			const __m256i redBlue{ _mm256_srli_epi16(_mm256_add_epi16(
+				_mm256_mullo_epi16(_mm256_and_si256(a, mask), inverseWeight16),
+				_mm256_mullo_epi16(_mm256_and_si256(b, mask), weight16)), 8) };
+			const __m256i greenAlpha{ _mm256_srli_epi16(_mm256_add_epi16(
+				_mm256_mullo_epi16(_mm256_and_si256(_mm256_srli_epi32(a, 8), mask), inverseWeight16),
+				_mm256_mullo_epi16(_mm256_and_si256(_mm256_srli_epi32(b, 8), mask), weight16)), 8) };
+			return _mm256_or_si256(redBlue, _mm256_slli_epi32(greenAlpha, 8));
+		}
+	}
+
+	void TextureGather::SampleBilinear8(const Level& level, const float (&us)[8], const float (&vs)[8], TextureAddressMode addressMode,
+		float (&reds)[8], float (&greens)[8], float (&blues)[8])
+	{
+		//Texel centers sit at +0.5, the fraction becomes an 8 bit weight
+		const __m256 half{ _mm256_set1_ps(0.5f) };
+		const __m256 x{ _mm256_sub_ps(_mm256_mul_ps(_mm256_loadu_ps(us), _mm256_set1_ps(float(level.width))), half) };
+		const __m256 y{ _mm256_sub_ps(_mm256_mul_ps(_mm256_loadu_ps(vs), _mm256_set1_ps(float(level.height))), half) };
+		const __m256 floorX{ _mm256_floor_ps(x) };
+		const __m256 floorY{ _mm256_floor_ps(y) };
+		const __m256 weightScale{ _mm256_set1_ps(256.0f) };
+		const __m256i weightU{ _mm256_cvttps_epi32(_mm256_add_ps(_mm256_mul_ps(_mm256_sub_ps(x, floorX), weightScale), half)) };
+		const __m256i weightV{ _mm256_cvttps_epi32(_mm256_add_ps(_mm256_mul_ps(_mm256_sub_ps(y, floorY), weightScale), half)) };
+
+		const __m256i one{ _mm256_set1_epi32(1) };
+		const __m256i texelU{ _mm256_cvttps_epi32(floorX) };
+		const __m256i texelV{ _mm256_cvttps_epi32(floorY) };
+		const __m256i u0{ AddressTexels(texelU, level.width, addressMode) };
+		const __m256i u1{ AddressTexels(_mm256_add_epi32(texelU, one), level.width, addressMode) };
+		const __m256i v0{ AddressTexels(texelV, level.height, addressMode) };
+		const __m256i v1{ AddressTexels(_mm256_add_epi32(texelV, one), level.height, addressMode) };
+
+		const int* pTexels{ reinterpret_cast<const int*>(level.pTexels) };
+		const auto gather = [pTexels, &level](__m256i u, __m256i v)
+			{
+				return _mm256_i32gather_epi32(pTexels, TexelAddresses(u, v, level), 4);
+			};
+		const __m256i top{ LerpTexels(gather(u0, v0), gather(u1, v0), weightU) };
+		const __m256i bottom{ LerpTexels(gather(u0, v1), gather(u1, v1), weightU) };
+		const __m256i texels{ LerpTexels(top, bottom, weightV) };
+
+		const __m256i byteMask{ _mm256_set1_epi32(0xFF) };
+		const __m256 toFloat{ _mm256_set1_ps(1.0f / 255.0f) };
+		_mm256_storeu_ps(reds, _mm256_mul_ps(_mm256_cvtepi32_ps(_mm256_and_si256(texels, byteMask)), toFloat));
+		_mm256_storeu_ps(greens, _mm256_mul_ps(_mm256_cvtepi32_ps(_mm256_and_si256(_mm256_srli_epi32(texels, 8), byteMask)), toFloat));
+		_mm256_storeu_ps(blues, _mm256_mul_ps(_mm256_cvtepi32_ps(_mm256_and_si256(_mm256_srli_epi32(texels, 16), byteMask)), toFloat));
+	}
+}
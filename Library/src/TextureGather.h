@@ -0,0 +1,26 @@
+#pragma once
+#include <cstdint>
+#include "Texture.h"
+
+namespace dae
+{
+	//Bilinear filtering off 8 uvs at once with AVX2 gathers, for the uncompressed RGBA8 levels off a Texture
+	//TextureGather.cpp is the only file built with AVX2, callers check the CPU before they call in
+	namespace TextureGather
+	{
+		//One mip level, addressed like Texture::GetTexelAddress
+		struct Level
+		{
+			const uint32_t* pTexels{};
+			int width{};
+			int height{};
+			int storageWidth{};
+			int mortonBits{};
+			TextureLayout layout{};
+		};
+
+		//Same 8 bit weights and rounding as the scalar fixed point path, channels scaled to [0, 1]
+		void SampleBilinear8(const Level& level, const float (&us)[8], const float (&vs)[8], TextureAddressMode addressMode,
+			float (&reds)[8], float (&greens)[8], float (&blues)[8]);
+	}
+}
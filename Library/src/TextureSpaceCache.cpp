@@ -0,0 +1,88 @@
+#include "TextureSpaceCache.h"
+#include <algorithm>
+
+namespace dae
+{
+	TextureSpaceCache::TextureSpaceCache(const Mesh& mesh, int width, int height) :
+		m_Width{ std::max(width, 1) },
+		m_Height{ std::max(height, 1) },
+		m_Vertices{ mesh.vertices },
+		m_Indices{ mesh.indices },
+		m_Texels(size_t(m_Width) * m_Height),
+		m_Colors(m_Texels.size()),
+		m_ShadedGeneration(m_Texels.size())
+	{
+		//Texels keep the triangle they are furthest inside off, the border around an island takes the closest edge
+		const float borderTexels{ 1.0f };
+		std::vector<float> insideDistance(m_Texels.size(), -borderTexels);
+		//Triangles with the texel center strictly inside, texels on an edge shared by 2 triangles are not an overlap
+		std::vector<uint8_t> claims(m_Texels.size());
+		const float edgeTolerance{ 1e-3f };
+
+		const bool isStrip{ mesh.primitiveTopology == PrimitiveTopology::TriangleStrip };
+		const size_t increment{ isStrip ? 1u : 3u };
+		for (size_t indc{}; indc + 2 < m_Indices.size(); indc += increment)
+		{
+			Vector2 texels[3]{};
+			for (int i{}; i < 3; ++i)
+				texels[i] = { m_Vertices[m_Indices[indc + i]].uv.x * m_Width, m_Vertices[m_Indices[indc + i]].uv.y * m_Height };
+
+			//Either winding, uv islands can be mirrored
+			const float area{ Vector2::Cross(texels[1] - texels[0], texels[2] - texels[0]) };
+			if (std::abs(area) < FLT_EPSILON)
+				continue;
+
+			//Weight to distance in texels from the opposite edge
+			const float edgeScales[3]{ std::abs(area) / (texels[2] - texels[1]).Magnitude(), std::abs(area) / (texels[0] - texels[2]).Magnitude(), std::abs(area) / (texels[1] - texels[0]).Magnitude() };
+
+			const int left{ Clamp(int(std::floor(std::min({ texels[0].x, texels[1].x, texels[2].x }) - borderTexels)), 0, m_Width) };
+			const int top{ Clamp(int(std::floor(std::min({ texels[0].y, texels[1].y, texels[2].y }) - borderTexels)), 0, m_Height) };
+			const int right{ Clamp(int(std::ceil(std::max({ texels[0].x, texels[1].x, texels[2].x }) + borderTexels)), 0, m_Width) };
+			const int bottom{ Clamp(int(std::ceil(std::max({ texels[0].y, texels[1].y, texels[2].y }) + borderTexels)), 0, m_Height) };
+			for (int v{ top }; v < bottom; ++v)
+			{
+				for (int u{ left }; u < right; ++u)
+				{
+					const Vector2 center{ u + 0.5f, v + 0.5f };
+					const float W0{ Vector2::Cross(texels[2] - texels[1], center - texels[1]) / area };
+					const float W1{ Vector2::Cross(texels[0] - texels[2], center - texels[2]) / area };
+					const float W2{ 1.0f - W0 - W1 };
+
+					const float distance{ std::min({ W0 * edgeScales[0], W1 * edgeScales[1], W2 * edgeScales[2] }) };
+					const size_t index{ size_t(v) * m_Width + u };
+					if (distance > edgeTolerance && claims[index] < 2 && ++claims[index] == 2)
+						++m_OverlappingTexelCount;
+					if (distance <= insideDistance[index])
+						continue;
+
+					if (m_Texels[index].firstIndex == InvalidIndex)
+						++m_CoveredTexelCount;
+					insideDistance[index] = distance;
+					m_Texels[index]       = { uint32_t(indc), W1, W2 };
+				}
+			}
+		}
+	}
+
+	size_t TextureSpaceCache::GetMemorySize() const
+	{
+		return m_Texels.size() * (sizeof(Texel) + sizeof(ColorRGB) + sizeof(uint32_t))
+			+ m_Vertices.size() * sizeof(Vertex) + m_Indices.size() * sizeof(uint32_t);
+	}
+
+	Vertex TextureSpaceCache::GetSurface(size_t index) const
+	{
+		const Texel& texel{ m_Texels[index] };
+		const Vertex& v0{ m_Vertices[m_Indices[texel.firstIndex]] };
+		const Vertex& v1{ m_Vertices[m_Indices[texel.firstIndex + 1]] };
+		const Vertex& v2{ m_Vertices[m_Indices[texel.firstIndex + 2]] };
+		const float W0{ 1.0f - texel.W1 - texel.W2 };
+
+		Vertex surface{};
+		surface.position = v0.position * W0 + v1.position * texel.W1 + v2.position * texel.W2;
+		surface.normal   = (v0.normal * W0 + v1.normal * texel.W1 + v2.normal * texel.W2).Normalized();
+		surface.tangent  = (v0.tangent * W0 + v1.tangent * texel.W1 + v2.tangent * texel.W2).Normalized();
+		surface.uv       = { (index % m_Width + 0.5f) / m_Width, (index / m_Width + 0.5f) / m_Height };
+		return surface;
+	}
+}
@@ -0,0 +1,92 @@
+#pragma once
+#include <cmath>
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+#include "Maths.h"
+#include "DataTypes.h"
+
+namespace dae
+{
+	//Lighting off one mesh cached in its uv layout, so the uv layout may not overlap itself
+	//A mesh with overlapping or mirrored uv islands reports its shared texels and has to be shaded per pixel instead
+	//A texel is only shaded when a pixel samples it and stays valid until Invalidate, camera moves keep it
+	class TextureSpaceCache final
+	{
+	public:
+		//Rasterizes the uv layout once, texels just outside a triangle edge are extrapolated from that triangle
+		TextureSpaceCache(const Mesh& mesh, int width, int height);
+
+		//Every texel goes stale, nothing is shaded until it is sampled again
+		void Invalidate() { ++m_Generation; }
+
+		//Bilinear over the covered texels around the uv, stale ones are shaded first with shadeTexel(const Vertex& surface)
+		//The surface is in object space with the uv at the texel center, 0 when no texel around the uv is covered
+		template<typename ShadeTexel>
+		ColorRGB Sample(const Vector2& uv, ShadeTexel&& shadeTexel) const
+		{
+			const float x{ uv.x * m_Width - 0.5f };
+			const float y{ uv.y * m_Height - 0.5f };
+			const int left{ int(std::floor(x)) };
+			const int top{ int(std::floor(y)) };
+			const float weightX{ x - left };
+			const float weightY{ y - top };
+
+			ColorRGB color{};
+			float totalWeight{};
+			for (int corner{}; corner < 4; ++corner)
+			{
+				const float weight{ ((corner & 1) ? weightX : 1.0f - weightX) * ((corner & 2) ? weightY : 1.0f - weightY) };
+				const size_t index{ size_t(Clamp(top + (corner >> 1), 0, m_Height - 1)) * m_Width + Clamp(left + (corner & 1), 0, m_Width - 1) };
+				if (weight <= 0.0f || m_Texels[index].firstIndex == InvalidIndex)
+					continue;
+
+				if (m_ShadedGeneration[index] != m_Generation)
+				{
+					m_Colors[index]           = shadeTexel(GetSurface(index));
+					m_ShadedGeneration[index] = m_Generation;
+					++m_ShadedTexelCount;
+				}
+				color       += m_Colors[index] * weight;
+				totalWeight += weight;
+			}
+			return totalWeight > 0.0f ? color / totalWeight : color;
+		}
+
+		int GetWidth() const { return m_Width; }
+		int GetHeight() const { return m_Height; }
+		size_t GetCoveredTexelCount() const { return m_CoveredTexelCount; }
+		//Texels inside more than one triangle, they only hold the lighting off one off them
+		size_t GetOverlappingTexelCount() const { return m_OverlappingTexelCount; }
+		//Texels shaded since the cache was built, a sample off a valid texel does not count
+		size_t GetShadedTexelCount() const { return m_ShadedTexelCount; }
+		size_t GetMemorySize() const;
+
+	private:
+		static constexpr uint32_t InvalidIndex{ UINT32_MAX };
+
+		//The triangle a texel lies on and the weights off its second and third vertex
+		struct Texel
+		{
+			uint32_t firstIndex{ InvalidIndex };
+			float W1{};
+			float W2{};
+		};
+
+		Vertex GetSurface(size_t index) const;
+
+		int m_Width{};
+		int m_Height{};
+		std::vector<Vertex> m_Vertices{};
+		std::vector<uint32_t> m_Indices{};
+		std::vector<Texel> m_Texels{};
+		size_t m_CoveredTexelCount{};
+		size_t m_OverlappingTexelCount{};
+
+		//A texel is valid when it was shaded in the current generation
+		uint32_t m_Generation{ 1 };
+		mutable std::vector<ColorRGB> m_Colors{};
+		mutable std::vector<uint32_t> m_ShadedGeneration{};
+		mutable size_t m_ShadedTexelCount{};
+	};
+}
@@ -0,0 +1,145 @@
+#include "TextureStreamer.h"
+#include "ThreadPool.h"
+#include <algorithm>
+#include <chrono>
+
+namespace dae
+{
+	TextureStreamer::TextureStreamer(ThreadPool& threadPool, size_t budget) :
+		m_ThreadPool{ threadPool },
+		m_Budget{ budget }
+	{
+	}
+
+	void TextureStreamer::Register(const std::shared_ptr<Texture>& pTexture)
+	{
+		std::lock_guard lock{ m_Mutex };
+		StreamedTexture& texture{ m_Textures.emplace_back() };
+		texture.pTexture       = pTexture;
+		texture.lastUsedFrames = std::vector<uint64_t>(pTexture->GetLevelCount());
+		texture.requestedLevel = pTexture->GetLevelCount();
+	}
+
+	bool TextureStreamer::Update(bool frameRendered)
+	{
+		std::lock_guard lock{ m_Mutex };
+		++m_Frame;
+		bool changed{ false };
+
+		//Held for the whole update, a read job that finishes meanwhile could otherwise release the last owner
+		std::vector<std::shared_ptr<Texture>> pTextures{};
+		for (auto it{ m_Textures.begin() }; it != m_Textures.end();)
+		{
+			std::shared_ptr<Texture> pTexture{ it->pTexture.lock() };
+			if (pTexture == nullptr)
+			{
+				m_StreamedSize -= it->streamedSize;
+				it = m_Textures.erase(it);
+				continue;
+			}
+			pTextures.push_back(std::move(pTexture));
+			++it;
+		}
+
+		for (size_t i{}; i < m_Textures.size(); ++i)
+		{
+			StreamedTexture& texture{ m_Textures[i] };
+			Texture& streamedTexture{ *pTextures[i] };
+			if (texture.pendingBlocks.valid() && texture.pendingBlocks.wait_for(std::chrono::seconds{ 0 }) == std::future_status::ready)
+			{
+				std::vector<uint64_t> blocks{ texture.pendingBlocks.get() };
+				if (blocks.empty())
+				{
+					texture.readFailed    = true;
+					texture.streamedSize -= GetLevelSize(streamedTexture, texture.pendingLevel);
+					m_StreamedSize       -= GetLevelSize(streamedTexture, texture.pendingLevel);
+				}
+				else
+				{
+					streamedTexture.MakeLevelResident(std::move(blocks));
+					changed = true;
+				}
+				texture.pendingLevel = -1;
+			}
+
+			const int requestedLevel{ streamedTexture.TakeRequestedLevel() };
+			if (frameRendered)
+				texture.requestedLevel = requestedLevel;
+			for (int level{ texture.requestedLevel }; level < streamedTexture.GetLevelCount(); ++level)
+				texture.lastUsedFrames[level] = m_Frame;
+		}
+
+		//Levels come in one at a time from coarse to fine, so the resident levels stay a contiguous chain
+		for (size_t i{}; i < m_Textures.size(); ++i)
+		{
+			StreamedTexture& texture{ m_Textures[i] };
+			const std::shared_ptr<Texture>& pTexture{ pTextures[i] };
+			const int level{ pTexture->GetResidentLevel() - 1 };
+			if (texture.readFailed || texture.pendingLevel != -1 || level < texture.requestedLevel)
+				continue;
+
+			const size_t levelSize{ GetLevelSize(*pTexture, level) };
+			if (!MakeRoom(levelSize, pTextures, changed))
+				continue;
+
+			texture.pendingLevel  = level;
+			texture.streamedSize += levelSize;
+			m_StreamedSize       += levelSize;
+			texture.pendingBlocks = m_ThreadPool.Submit([pTexture, level]()
+				{
+					return pTexture->ReadStreamedLevel(level);
+				});
+		}
+
+		return changed;
+	}
+
+	bool TextureStreamer::MakeRoom(size_t size, const std::vector<std::shared_ptr<Texture>>& pTextures, bool& evicted)
+	{
+		while (m_StreamedSize + size > m_Budget)
+		{
+			//Only the finest resident level off a texture can go, levels used this frame stay
+			size_t oldest{ m_Textures.size() };
+			uint64_t oldestFrame{};
+			for (size_t i{}; i < m_Textures.size(); ++i)
+			{
+				const StreamedTexture& texture{ m_Textures[i] };
+				const int level{ pTextures[i]->GetResidentLevel() };
+				if (texture.pendingLevel != -1 || level >= pTextures[i]->m_PinnedLevel || texture.lastUsedFrames[level] == m_Frame)
+					continue;
+				if (oldest == m_Textures.size() || texture.lastUsedFrames[level] < oldestFrame)
+				{
+					oldest      = i;
+					oldestFrame = texture.lastUsedFrames[level];
+				}
+			}
+			if (oldest == m_Textures.size())
+				return false;
+
+			Texture& texture{ *pTextures[oldest] };
+			const size_t levelSize{ GetLevelSize(texture, texture.GetResidentLevel()) };
+			texture.EvictLevel();
+			m_Textures[oldest].streamedSize -= levelSize;
+			m_StreamedSize                  -= levelSize;
+			evicted = true;
+		}
+		return true;
+	}
+
+	size_t TextureStreamer::GetLevelSize(const Texture& texture, int level)
+	{
+		return texture.GetLevelBlockCount(level) * sizeof(uint64_t);
+	}
+
+	size_t TextureStreamer::GetStreamedSize() const
+	{
+		std::lock_guard lock{ m_Mutex };
+		return m_StreamedSize;
+	}
+
+	int TextureStreamer::GetPendingCount() const
+	{
+		std::lock_guard lock{ m_Mutex };
+		return int(std::ranges::count_if(m_Textures, [](const StreamedTexture& texture) { return texture.pendingLevel != -1; }));
+	}
+}
@@ -0,0 +1,59 @@
+#pragma once
+#include <future>
+#include <memory>
+#include <mutex>
+#include <vector>
+#include "Texture.h"
+
+namespace dae
+{
+	class ThreadPool;
+
+	//Streams the finer mip levels off streamed textures in and out off memory within a byte budget
+	//Levels are read from disk on the thread pool, but only swapped in Update, between frames
+	class TextureStreamer final
+	{
+	public:
+		//budget only counts the streamed levels, the pinned coarse levels are always resident
+		TextureStreamer(ThreadPool& threadPool, size_t budget);
+		~TextureStreamer() = default;
+
+		TextureStreamer(const TextureStreamer&) = delete;
+		TextureStreamer(TextureStreamer&&) noexcept = delete;
+		TextureStreamer& operator=(const TextureStreamer&) = delete;
+		TextureStreamer& operator=(TextureStreamer&&) noexcept = delete;
+
+		void Register(const std::shared_ptr<Texture>& pTexture);
+		//Commits finished loads, evicts the least recently used levels and requests new ones
+		//frameRendered is false after a skipped frame, the screen then still shows what the last rendered frame requested
+		//Returns true when a texture changed, the image has to be drawn again
+		bool Update(bool frameRendered);
+
+		size_t GetBudget() const { return m_Budget; }
+		size_t GetStreamedSize() const;
+		int GetPendingCount() const;
+
+	private:
+		struct StreamedTexture
+		{
+			std::weak_ptr<Texture> pTexture{};
+			std::vector<uint64_t> lastUsedFrames{};
+			int requestedLevel{};
+			int pendingLevel{ -1 };
+			std::future<std::vector<uint64_t>> pendingBlocks{};
+			size_t streamedSize{}; //resident and pending streamed levels
+			bool readFailed{ false };
+		};
+
+		//Evicts least recently used levels until size fits the budget, false when that is not possible this frame
+		bool MakeRoom(size_t size, const std::vector<std::shared_ptr<Texture>>& pTextures, bool& evicted);
+		static size_t GetLevelSize(const Texture& texture, int level);
+
+		ThreadPool& m_ThreadPool;
+		const size_t m_Budget{};
+		size_t m_StreamedSize{};
+		uint64_t m_Frame{};
+		mutable std::mutex m_Mutex{};
+		std::vector<StreamedTexture> m_Textures{};
+	};
+}
@@ -0,0 +1,45 @@
+#include "ThreadPool.h"
+#include <algorithm>
+
+namespace dae
+{
+	ThreadPool::ThreadPool(int threadCount)
+	{
+		if (threadCount <= 0)
+			threadCount = std::max(int(std::thread::hardware_concurrency()), 1);
+
+		m_Workers.reserve(threadCount);
+		for (int i{}; i < threadCount; ++i)
+			m_Workers.emplace_back(&ThreadPool::RunWorker, this);
+	}
+
+	ThreadPool::~ThreadPool()
+	{
+		//Jobs already queued still run, so no future is left without a result
+		{
+			std::lock_guard lock{ m_Mutex };
+			m_IsStopping = true;
+		}
+		m_JobAvailable.notify_all();
+		for (std::thread& worker : m_Workers)
+			worker.join();
+	}
+
+	void ThreadPool::RunWorker()
+	{
+		while (true)
+		{
+			std::function<void()> job{};
+			{
+				std::unique_lock lock{ m_Mutex };
+				m_JobAvailable.wait(lock, [this]() { return m_IsStopping || !m_Jobs.empty(); });
+				if (m_Jobs.empty())
+					return;
+
+				job = std::move(m_Jobs.front());
+				m_Jobs.pop();
+			}
+			job();
+		}
+	}
+}
@@ -0,0 +1,54 @@
+#pragma once
+#include <condition_variable>
+#include <functional>
+#include <future>
+#include <memory>
+#include <mutex>
+#include <queue>
+#include <thread>
+#include <type_traits>
+#include <vector>
+
+namespace dae
+{
+	//Fixed set off worker threads running submitted jobs in order, results come back through futures
+	class ThreadPool final
+	{
+	public:
+		//0 uses one thread per hardware thread
+		explicit ThreadPool(int threadCount = 0);
+		~ThreadPool();
+
+		ThreadPool(const ThreadPool&) = delete;
+		ThreadPool(ThreadPool&&) noexcept = delete;
+		ThreadPool& operator=(const ThreadPool&) = delete;
+		ThreadPool& operator=(ThreadPool&&) noexcept = delete;
+
+		template<typename Function>
+		std::future<std::invoke_result_t<std::decay_t<Function>>> Submit(Function&& function)
+		{
+			using Result = std::invoke_result_t<std::decay_t<Function>>;
+
+			//std::function needs a copyable target, so the task itself is shared
+			const auto pTask{ std::make_shared<std::packaged_task<Result()>>(std::forward<Function>(function)) };
+			std::future<Result> future{ pTask->get_future() };
+			{
+				std::lock_guard lock{ m_Mutex };
+				m_Jobs.emplace([pTask]() { (*pTask)(); });
+			}
+			m_JobAvailable.notify_one();
+			return future;
+		}
+
+		int GetThreadCount() const { return int(m_Workers.size()); }
+
+	private:
+		void RunWorker();
+
+		std::vector<std::thread> m_Workers{};
+		std::queue<std::function<void()>> m_Jobs{};
+		std::mutex m_Mutex{};
+		std::condition_variable m_JobAvailable{};
+		bool m_IsStopping{ false };
+	};
+}
@@ -0,0 +1,54 @@
+#include "Upscaler.h"
+#include <algorithm>
+
+namespace dae
+{
+	namespace
+	{
+		//Lerp 2 packed 8 bit channels at a time with an 8 bit weight, no channel can overflow into its neighbour
+		uint32_t LerpPixel(uint32_t a, uint32_t b, uint32_t weight)
+		{
+			const uint32_t rb{ ((((a     ) & 0x00FF00FF) * (256 - weight) + ((b     ) & 0x00FF00FF) * weight) >> 8) & 0x00FF00FF };
+			const uint32_t ag{ ((((a >> 8) & 0x00FF00FF) * (256 - weight) + ((b >> 8) & 0x00FF00FF) * weight)     ) & 0xFF00FF00 };
+			return rb | ag;
+		}
+
+		//16.16 fixed point position off the destination pixel center in the source
+		int SourcePosition(int destination, int64_t step, int sourceSize)
+		{
+			const int64_t position{ ((2 * destination + 1) * step) / 2 - 0x8000 };
+			return int(std::clamp<int64_t>(position, 0, int64_t(sourceSize - 1) << 16));
+		}
+	}
+
+	void Upscaler::UpscaleBilinear(const uint32_t* pSource, int sourceWidth, int sourceHeight,
+		uint32_t* pDestination, int destinationWidth, int destinationHeight, int destinationStride)
+	{
+		const int64_t stepX{ (int64_t(sourceWidth ) << 16) / destinationWidth  };
+		const int64_t stepY{ (int64_t(sourceHeight) << 16) / destinationHeight };
+
+		for (int dy{}; dy < destinationHeight; ++dy)
+		{
+			const int fy{ SourcePosition(dy, stepY, sourceHeight) };
+			const int y0{ fy >> 16 };
+			const int y1{ std::min(y0 + 1, sourceHeight - 1) };
+			const uint32_t weightY{ uint32_t(fy >> 8) & 0xFF };
+
+			const uint32_t* pRow0{ pSource + y0 * sourceWidth };
+			const uint32_t* pRow1{ pSource + y1 * sourceWidth };
+			uint32_t* pRow{ pDestination + dy * destinationStride };
+
+			for (int dx{}; dx < destinationWidth; ++dx)
+			{
+				const int fx{ SourcePosition(dx, stepX, sourceWidth) };
+				const int x0{ fx >> 16 };
+				const int x1{ std::min(x0 + 1, sourceWidth - 1) };
+				const uint32_t weightX{ uint32_t(fx >> 8) & 0xFF };
+
+				const uint32_t top   { LerpPixel(pRow0[x0], pRow0[x1], weightX) };
+				const uint32_t bottom{ LerpPixel(pRow1[x0], pRow1[x1], weightX) };
+				pRow[dx] = LerpPixel(top, bottom, weightY);
+			}
+		}
+	}
+}
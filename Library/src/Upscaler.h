@@ -0,0 +1,13 @@
+#pragma once
+#include <cstdint>
+
+namespace dae
+{
+	//Scales packed 8 bit per channel images, positions in 16.16 fixed point and 8 bit weights
+	namespace Upscaler
+	{
+		//Bilinear filter with the pixel centers aligned, the source is packed and destinationStride is in pixels
+		void UpscaleBilinear(const uint32_t* pSource, int sourceWidth, int sourceHeight,
+			uint32_t* pDestination, int destinationWidth, int destinationHeight, int destinationStride);
+	}
+}
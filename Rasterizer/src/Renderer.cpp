@@ -6,10 +6,19 @@
 #include "Renderer.h"
 #include "Maths.h"
 #include "Texture.h"
+#include "Material.h"
 #include "Utils.h"
+#include "MeshPack.h"
 #include "BRDFs.h"
+#include "NormalMapBaker.h"
+#include "Upscaler.h"
 #include <iostream>
+#include <iomanip>
 #include <limits>
+#include <chrono>
+#include <random>
+#include <bit>
+#include <algorithm>
 
 using namespace dae;
 
@@ -17,12 +26,15 @@ Renderer::Renderer(SDL_Window* pWindow) :
 	m_pWindow(pWindow)
 {
 	//Initialize
-	SDL_GetWindowSize(pWindow, &m_Width, &m_Height);
+	SDL_GetWindowSize(pWindow, &m_WindowWidth, &m_WindowHeight);
+	m_Width  = m_WindowWidth;
+	m_Height = m_WindowHeight;
 
-	//Create Buffers
+	//Create Buffers, sized for the window so the render resolution can scale down inside them
 	m_pFrontBuffer       = SDL_GetWindowSurface(pWindow);
 	m_pBackBuffer        = SDL_CreateRGBSurface(0, m_Width, m_Height, 32, 0, 0, 0, 0);
 	m_pBackBufferPixels  = (uint32_t*)m_pBackBuffer->pixels;
+	m_pUpscaleBuffer     = SDL_CreateRGBSurface(0, m_Width, m_Height, 32, 0, 0, 0, 0);
 	m_pDepthBufferPixels = new float[m_Width * m_Height];
 	ResetDepthBuffer();
 
@@ -30,29 +42,100 @@ Renderer::Renderer(SDL_Window* pWindow) :
 	m_Camera.Initialize(45.f, { .0f, 5.f, 64.f });
 	m_Camera.SetAspectRatio(float(m_Width) / m_Height);
 
+	//The directional light every lighting mode was designed around, local lights come from AddLight or the O key
+	AddLight(Light{ LightType::Directional, {}, Vector3{ .577f, -.577f, .577f } });
+
+	//Specular tables, their error is against powf over the whole gloss range
+	std::cout << "Phong table: " << m_PhongLut.GetMemorySize() / 1024 << " KB, max error " << m_PhongLut.GetMaxError()
+		<< ", Blinn-Phong table: " << m_BlinnPhongLut.GetMemorySize() / 1024 << " KB, max error " << m_BlinnPhongLut.GetMaxError() << std::endl;
+	std::cout << "Split-sum table: " << m_SplitSumLut.GetMemorySize() / 1024 << " KB, " << (m_SplitSumLut.IsLoadedFromCache() ? "loaded from cache" : "integrated and cached") << std::endl;
+
+	//Environment lighting, the 9 coefficients are all that is kept off the image
+	const auto environmentStart{ std::chrono::high_resolution_clock::now() };
+	const bool hasEnvironmentMap{ m_Environment.LoadFromHdr("Resources/environment.hdr") };
+	if (!hasEnvironmentMap)
+	{
+		const int gradientWidth{ 64 }, gradientHeight{ 32 };
+		std::vector<ColorRGB> gradient(gradientWidth * gradientHeight);
+		for (int y{}; y < gradientHeight; ++y)
+		{
+			const float up{ std::cos(PI * (y + 0.5f) / gradientHeight) };
+			std::fill_n(gradient.begin() + y * gradientWidth, gradientWidth, m_GroundColor + (m_SkyColor - m_GroundColor) * (0.5f + 0.5f * up));
+		}
+		m_Environment.ProjectEquirectangular(gradient, gradientWidth, gradientHeight);
+	}
+	const std::chrono::duration<float, std::milli> environmentTime{ std::chrono::high_resolution_clock::now() - environmentStart };
+	std::cout << "Environment: " << (hasEnvironmentMap ? "Resources/environment.hdr" : "sky gradient, no Resources/environment.hdr") << " projected to 9 SH coefficients in " << environmentTime.count() << " ms" << std::endl;
+
 	//Init textures
-	m_pTexture              = Texture::LoadFromFile("Resources/tuktuk.png");
-	m_pTextureNormalMap     = Texture::LoadFromFile("Resources/vehicle_normal.png");
-	m_pTextureGlossines     = Texture::LoadFromFile("Resources/vehicle_gloss.png");
-	m_pTextureSpecular      = Texture::LoadFromFile("Resources/vehicle_specular.png");
-	m_pTextureVehicle       = Texture::LoadFromFile("Resources/vehicle_diffuse.png");
+	if (m_UseTextureStreaming)
+		AssetManager::GetInstance().EnableTextureStreaming(m_TextureStreamingBudget);
+
+	//Textures are shared through the AssetManager and loaded on first use, tuktuk.png only by the older render functions
+	m_pTexture              = TextureHandle{ "Resources/tuktuk.png" };
+
+	//The vehicle maps and the obj are decoded in parallel on the asset workers, the first frame waits for what it needs
+	const auto loadStart{ std::chrono::high_resolution_clock::now() };
+	LoadVehicleTextures();
+
+	MeshPack::ConversionReport objReport{};
+	std::future<Mesh> vehicleMesh{ AssetManager::GetInstance().GetThreadPool().Submit([&objReport]()
+		{
+			//The binary pack next to the obj skips parsing, it is written on the first run
+			Mesh mesh{};
+			MeshPack::LoadObj("Resources/vehicle.obj", mesh, true, &objReport);
+			return mesh;
+		}) };
+
+	CreateVehicleMaterial();
 
 	//Init model
-	m_Meshes_world.push_back( Mesh{} );
-	Utils::ParseOBJ("Resources/vehicle.obj", m_Meshes_world[0].vertices, m_Meshes_world[0].indices);
+	m_Meshes_world.push_back( vehicleMesh.get() );
+	const std::chrono::duration<float, std::milli> meshLoadTime{ std::chrono::high_resolution_clock::now() - loadStart };
+	std::cout << "Vehicle mesh ready after " << meshLoadTime.count() << " ms, textures keep loading in the background" << std::endl;
+	if (objReport.parsing.size > 0)
+	{
+		const MeshOptimizer::Report& optimization{ objReport.optimization };
+		std::cout << "vehicle.obj parsed on " << objReport.parsing.threadCount << " threads at " << objReport.parsing.GetMegabytesPerSecond() << " MB/s" << std::endl;
+		std::cout << "vehicle.obj optimized: " << optimization.vertexCountBefore << " -> " << optimization.vertexCountAfter << " vertices, ACMR "
+			<< optimization.acmrBefore << " -> " << optimization.acmrAfter << ", overdraw " << optimization.overdrawBefore << " -> " << optimization.overdrawAfter << std::endl;
+	}
+	else
+		std::cout << "vehicle.obj loaded from vehicle.obj.pack" << std::endl;
 	m_Meshes_world[0].primitiveTopology          = PrimitiveTopology::TriangleList;
 	m_Meshes_world[0].worldMatrix                = Matrix::CreateTranslation({ 0.f, 0.f, 50.f });
 
+	//The bake reads the full resolution map itself, the shared one may only have its coarse levels resident
+	m_ObjectNormalMapBake = AssetManager::GetInstance().GetThreadPool().Submit([mesh = m_Meshes_world[0]]()
+		{
+			Texture* pTangentSpaceMap{ Texture::LoadFromFile("Resources/vehicle_normal.png", TextureFormat::Normal) };
+			if (pTangentSpaceMap == nullptr)
+				return static_cast<Texture*>(nullptr);
+
+			NormalMapBaker::Report report{};
+			Texture* pObjectSpaceMap{ NormalMapBaker::BakeObjectSpace(*pTangentSpaceMap, mesh, &report) };
+			delete pTangentSpaceMap;
+
+			//A texel shared by overlapping or mirrored uv islands can only hold the normal off one off them
+			if (pObjectSpaceMap != nullptr && report.overlappingTexels > 0)
+			{
+				std::cout << "Object space normal map not used: " << report.overlappingTexels << " off " << report.coveredTexels
+					<< " texels are covered by more than one triangle, the normal map stays in tangent space" << std::endl;
+				delete pObjectSpaceMap;
+				return static_cast<Texture*>(nullptr);
+			}
+			return pObjectSpaceMap;
+		});
 }
 
 Renderer::~Renderer()
 {
 	delete[] m_pDepthBufferPixels;
-	delete m_pTexture;
-	delete m_pTextureNormalMap;
-	delete m_pTextureGlossines;
-	delete m_pTextureSpecular;
-	delete m_pTextureVehicle;
+	SDL_FreeSurface(m_pUpscaleBuffer);
+	delete m_pMaterialVehicle;
+	if (m_ObjectNormalMapBake.valid())
+		m_pTextureObjectNormalMap = m_ObjectNormalMapBake.get();
+	delete m_pTextureObjectNormalMap;
 }
 
 void Renderer::Update(Timer* pTimer)
@@ -66,14 +149,42 @@ void Renderer::Update(Timer* pTimer)
 	}
 
 	m_Camera.Update(pTimer);
+
+	//The finished bake switches the normals to object space, FrameState sees the change
+	if (m_ObjectNormalMapBake.valid() && m_ObjectNormalMapBake.wait_for(std::chrono::seconds(0)) == std::future_status::ready)
+	{
+		m_pTextureObjectNormalMap = m_ObjectNormalMapBake.get();
+		if (m_pTextureObjectNormalMap)
+			std::cout << "Object space normal map baked, " << m_pTextureObjectNormalMap->GetMemorySize() / 1024 << " KB" << std::endl;
+	}
+
+	//Between frames, so no sampler reads a level while it is swapped, a changed texture affects every pixel
+	if (AssetManager::GetInstance().UpdateTextureStreaming(!m_FrameSkipped))
+	{
+		m_FrameTracker.RequestFullFrame();
+		for (TextureSpaceCache& cache : m_ShadingCaches)
+			cache.Invalidate();
+	}
+
+	//A skipped frame waited for input, its frame time says nothing about the render cost
+	if (m_UseDynamicResolution && !m_FrameSkipped)
+		UpdateDynamicResolution(pTimer->GetElapsed());
 }
 
 void Renderer::Render()
 {
+	//Only the region touched by a changed mesh gets rendered again, nothing changed means no frame at all
+	m_DirtyRect    = CalculateDirtyRect();
+	m_FrameSkipped = m_DirtyRect.IsEmpty();
+	if (m_FrameSkipped)
+		return;
+
 	//@START
 	//Lock BackBuffer
 	SDL_LockSurface(m_pBackBuffer);
-	SDL_FillRect(m_pBackBuffer, NULL, SDL_MapRGB(m_pBackBuffer->format, 100, 100, 100));
+	if (m_VrsMode != VariableRateShading::Off)
+		UpdateShadingRateImage();
+	ClearColorRect(m_DirtyRect, SDL_MapRGB(m_pBackBuffer->format, 100, 100, 100));
 
 	//RENDER LOGIC
 	//IntroRender();
@@ -90,14 +201,22 @@ void Renderer::Render()
 	//@END
 	//Update SDL Surface
 	SDL_UnlockSurface(m_pBackBuffer);
-	SDL_BlitSurface(m_pBackBuffer, 0, m_pFrontBuffer, 0);
+	if (IsRenderResolutionScaled())
+	{
+		UpscaleToWindow();
+		SDL_BlitSurface(m_pUpscaleBuffer, 0, m_pFrontBuffer, 0);
+	}
+	else
+	{
+		SDL_BlitSurface(m_pBackBuffer, 0, m_pFrontBuffer, 0);
+	}
 	SDL_UpdateWindowSurface(m_pWindow);
 	
 }
 
 bool Renderer::SaveBufferToImage() const
 {
-	return SDL_SaveBMP(m_pBackBuffer, "Rasterizer_ColorBuffer.bmp");
+	return SDL_SaveBMP(IsRenderResolutionScaled() ? m_pUpscaleBuffer : m_pBackBuffer, "Rasterizer_ColorBuffer.bmp");
 }
 
 void dae::Renderer::ToggleRotation()
@@ -105,11 +224,84 @@ void dae::Renderer::ToggleRotation()
 	m_Rotating = !m_Rotating;
 }
 
+void dae::Renderer::ToggleIncrementalRendering()
+{
+	m_UseIncrementalRendering = !m_UseIncrementalRendering;
+	std::cout << "Incremental rendering: " << (m_UseIncrementalRendering ? "on" : "off") << std::endl;
+}
+
+void dae::Renderer::InvalidateFrame()
+{
+	m_FrameTracker.RequestFullFrame();
+}
+
+int dae::Renderer::AddLight(const Light& light)
+{
+	m_Lights.push_back(light);
+	return int(m_Lights.size()) - 1;
+}
+
+void dae::Renderer::RemoveLight(int index)
+{
+	m_Lights.erase(m_Lights.begin() + index);
+}
+
+void dae::Renderer::SwitchLocalLightCount()
+{
+	//Local lights are appended after the directional light, so they are replaced as a block
+	const int lightCounts[]{ 0, 16, 256 };
+	const int amountOfModes{ 3 };
+	const int mode{ int(std::find(lightCounts, lightCounts + amountOfModes, m_LocalLightCount) - lightCounts) };
+	std::erase_if(m_Lights, [](const Light& light) { return light.type != LightType::Directional; });
+	m_LocalLightCount = lightCounts[(mode + 1) % amountOfModes];
+
+	//Scattered in a box around the vehicle, sized relative to it
+	const Mesh& vehicle{ m_Meshes_world[0] };
+	const Vector3 center{ vehicle.worldMatrix.TransformPoint((vehicle.minBounds + vehicle.maxBounds) * 0.5f) };
+	const Vector3 extent{ (vehicle.maxBounds - vehicle.minBounds) * 0.75f };
+	const float size{ extent.Magnitude() };
+	std::mt19937 random{ 7 };
+	std::uniform_real_distribution<float> unit{ -1.0f, 1.0f };
+	for (int i{}; i < m_LocalLightCount; ++i)
+	{
+		Light light{};
+		light.type      = (i % 4 == 3) ? LightType::Spot : LightType::Point;
+		light.position  = center + Vector3{ unit(random) * extent.x, unit(random) * extent.y, unit(random) * extent.z };
+		light.direction = Vector3{ unit(random) * 0.5f, -1.0f, unit(random) * 0.5f }.Normalized();
+		light.color     = ColorRGB{ 0.5f + 0.5f * unit(random), 0.5f + 0.5f * unit(random), 0.5f + 0.5f * unit(random) };
+		light.intensity = 2.0f;
+		light.range     = size * (0.2f + 0.1f * unit(random));
+		AddLight(light);
+	}
+	std::cout << "Local lights: " << m_LocalLightCount << std::endl;
+}
+
+bool dae::Renderer::IsFrameSkipped() const
+{
+	return m_FrameSkipped;
+}
+
 void dae::Renderer::SwitchLightMode()
 {
-	const int amountOfModes{ 4 };
+	const int amountOfModes{ 5 };
 	m_LightMode = static_cast<LightingMode>((int(m_LightMode) + 1) % amountOfModes);
-	std::cout << "LightMode: oa/diffuse/specular/combined " << int(m_LightMode)  << std::endl;
+	std::cout << "LightMode: oa/diffuse/specular/combined/pbr " << int(m_LightMode)  << std::endl;
+}
+
+void dae::Renderer::SwitchShadingFrequency()
+{
+	const int amountOfModes{ 3 };
+	m_ShadingFrequency = static_cast<ShadingFrequency>((int(m_ShadingFrequency) + 1) % amountOfModes);
+	std::cout << "Shading: per pixel/per vertex textured/per vertex " << int(m_ShadingFrequency) << std::endl;
+}
+
+void dae::Renderer::ToggleTextureSpaceShading()
+{
+	//Nothing was tracked while it was off
+	m_UseTextureSpaceShading = !m_UseTextureSpaceShading;
+	for (TextureSpaceCache& cache : m_ShadingCaches)
+		cache.Invalidate();
+	std::cout << "Texture space shading: " << (m_UseTextureSpaceShading ? "on" : "off") << std::endl;
 }
 
 void dae::Renderer::ToggleNormal()
@@ -117,6 +309,200 @@ void dae::Renderer::ToggleNormal()
 	m_UseNormalMap = !m_UseNormalMap;
 }
 
+void dae::Renderer::SwitchNormalMapSpace()
+{
+	//The bake finished without a map, it could not load the normal map or the uvs overlap
+	if (m_NormalMapSpace == NormalMapSpace::Tangent && !m_pTextureObjectNormalMap && !m_ObjectNormalMapBake.valid())
+	{
+		std::cout << "Normal map: tangent space, there is no object space map for this mesh" << std::endl;
+		return;
+	}
+	m_NormalMapSpace = m_NormalMapSpace == NormalMapSpace::Tangent ? NormalMapSpace::Object : NormalMapSpace::Tangent;
+	std::cout << "Normal map: " << (m_NormalMapSpace == NormalMapSpace::Object ? "object space" : "tangent space")
+		<< (m_NormalMapSpace == NormalMapSpace::Object && !m_pTextureObjectNormalMap ? ", still baking" : "") << std::endl;
+}
+
+void dae::Renderer::ToggleMSAA()
+{
+	m_UseMSAA = !m_UseMSAA;
+	std::cout << "MSAA 4x: " << (m_UseMSAA ? "on" : "off") << std::endl;
+}
+
+void dae::Renderer::ToggleDynamicResolution()
+{
+	m_UseDynamicResolution = !m_UseDynamicResolution;
+	m_SmoothedFrameTime    = m_TargetFrameTime;
+	if (!m_UseDynamicResolution)
+		SetRenderResolution(m_WindowWidth, m_WindowHeight);
+
+	std::cout << "Dynamic resolution: " << (m_UseDynamicResolution ? "on" : "off") << std::endl;
+}
+
+void dae::Renderer::SwitchVariableRateShading()
+{
+	const int amountOfModes{ 3 };
+	m_VrsMode = static_cast<VariableRateShading>((int(m_VrsMode) + 1) % amountOfModes);
+	std::cout << "Variable rate shading: off/quality/performance " << int(m_VrsMode) << std::endl;
+}
+
+void dae::Renderer::SwitchTextureFiltering()
+{
+	const int amountOfModes{ 4 };
+	m_TextureFiltering = static_cast<TextureFiltering>((int(m_TextureFiltering) + 1) % amountOfModes);
+	std::cout << "Texture filtering: point/nearest mip/bilinear/trilinear " << int(m_TextureFiltering) << std::endl;
+}
+
+void dae::Renderer::SwitchSpecularModel()
+{
+	const int amountOfModes{ 3 };
+	m_SpecularModel = static_cast<SpecularModel>((int(m_SpecularModel) + 1) % amountOfModes);
+	std::cout << "Specular: phong/phong table/blinn-phong table " << int(m_SpecularModel) << std::endl;
+}
+
+void dae::Renderer::ToggleShadows()
+{
+	m_UseShadows = !m_UseShadows;
+	m_ShadowMap.Invalidate();
+	std::cout << "Shadows: " << (m_UseShadows ? "on" : "off") << ", " << m_ShadowMap.GetSize() << "x" << m_ShadowMap.GetSize()
+		<< " map rendered " << m_ShadowMap.GetRenderCount() << " times" << std::endl;
+}
+
+void dae::Renderer::SwitchTextureLayout()
+{
+	//Block compressed maps always keep their 4x4 blocks in rows
+	if (m_UseCompressedTextures)
+	{
+		std::cout << "Texture layout: not supported on block compressed textures, C switches to uncompressed" << std::endl;
+		return;
+	}
+
+	const int amountOfModes{ 3 };
+	m_TextureLayout = static_cast<TextureLayout>((int(m_TextureLayout) + 1) % amountOfModes);
+	for (Texture* pTexture : { m_pTextureNormalMap.Get(), m_pTextureGlossines.Get(), m_pTextureSpecular.Get(), m_pTextureVehicle.Get() })
+		pTexture->SetLayout(m_TextureLayout);
+
+	std::cout << "Texture layout: linear/tiled 4x4/morton " << int(m_TextureLayout) << std::endl;
+}
+
+void dae::Renderer::BenchmarkTextureLayouts()
+{
+	if (m_UseCompressedTextures)
+	{
+		std::cout << "Texture layout benchmark: not supported on block compressed textures, C switches to uncompressed" << std::endl;
+		return;
+	}
+
+	//Same fetch pattern for every layout, uvs are generated up front so only the fetches are timed
+	const int randomFetchCount{ 1 << 22 };
+	const int walkCount{ 4096 };
+	const int walkLength{ 1024 };
+	std::mt19937 generator{ 1234 };
+	std::uniform_real_distribution<float> distribution{ 0.0f, 1.0f };
+
+	std::vector<Vector2> randomUvs(randomFetchCount);
+	for (Vector2& uv : randomUvs)
+		uv = { distribution(generator), distribution(generator) };
+
+	//Walks step one texel along a random, mostly not axis aligned direction, like a uv gradient across a triangle
+	const float texelSize{ 1.0f / m_pTextureVehicle->GetWidth() };
+	std::vector<Vector2> walkUvs{};
+	walkUvs.reserve(size_t(walkCount) * walkLength);
+	for (int walk{}; walk < walkCount; ++walk)
+	{
+		const float angle{ distribution(generator) * PI_2 };
+		const Vector2 step{ std::cos(angle) * texelSize, std::sin(angle) * texelSize };
+		Vector2 uv{ distribution(generator), distribution(generator) };
+		for (int i{}; i < walkLength; ++i, uv += step)
+			walkUvs.push_back(uv);
+	}
+
+	const auto measure = [](const std::vector<Vector2>& uvs, const auto& fetch, float& checksum)
+		{
+			const auto start{ std::chrono::high_resolution_clock::now() };
+			ColorRGB sum{};
+			for (const Vector2& uv : uvs)
+				sum += fetch(uv);
+			const std::chrono::duration<float> duration{ std::chrono::high_resolution_clock::now() - start };
+			checksum = sum.r + sum.g + sum.b;
+			return float(uvs.size()) / duration.count() / 1e6f;
+		};
+
+	const Texture& texture{ *m_pTextureVehicle.Get() };
+	const auto point    = [&texture](const Vector2& uv) { return texture.Sample(uv); };
+	const auto bilinear = [&texture](const Vector2& uv) { return texture.SampleTrilinear(uv, 0.0f); };
+
+	std::cout << "Texture layout benchmark, Mfetch/s (random point / walk point / walk bilinear, checksum)" << std::endl;
+	const char* layoutNames[]{ "linear", "tiled 4x4", "morton" };
+	for (int layout{}; layout < 3; ++layout)
+	{
+		m_pTextureVehicle->SetLayout(static_cast<TextureLayout>(layout));
+		float checksum{};
+		const float randomRate{ measure(randomUvs, point, checksum) };
+		const float walkRate{ measure(walkUvs, point, checksum) };
+		const float bilinearRate{ measure(walkUvs, bilinear, checksum) };
+		std::cout << std::setw(10) << layoutNames[layout] << ": " << std::fixed << std::setprecision(1)
+			<< randomRate << " / " << walkRate << " / " << bilinearRate << ", " << checksum << std::defaultfloat << std::endl;
+	}
+	m_pTextureVehicle->SetLayout(m_TextureLayout);
+}
+
+void dae::Renderer::ToggleInterleavedMaterial()
+{
+	m_UseInterleavedMaterial = !m_UseInterleavedMaterial;
+	std::cout << "Interleaved material: " << (m_UseInterleavedMaterial && m_pMaterialVehicle ? "on" : "off") << std::endl;
+}
+
+void dae::Renderer::ToggleCompressedTextures()
+{
+	m_UseCompressedTextures = !m_UseCompressedTextures;
+	LoadVehicleTextures();
+	CreateVehicleMaterial();
+
+	//The uncompressed maps are shared, so they may still be in another layout
+	if (!m_UseCompressedTextures)
+	{
+		for (Texture* pTexture : { m_pTextureNormalMap.Get(), m_pTextureGlossines.Get(), m_pTextureSpecular.Get(), m_pTextureVehicle.Get() })
+			pTexture->SetLayout(m_TextureLayout);
+	}
+
+	for (TextureSpaceCache& cache : m_ShadingCaches)
+		cache.Invalidate();
+	std::cout << "Compressed textures: " << (m_UseCompressedTextures ? "on, texture layouts, interleaved material and gather sampling are off" : "off") << std::endl;
+}
+
+void dae::Renderer::LoadVehicleTextures()
+{
+	//The handles off the other format are released, the AssetManager frees those maps once nobody else owns them
+	m_pTextureNormalMap     = TextureHandle{ "Resources/vehicle_normal.png", m_UseCompressedTextures ? TextureFormat::BC5 : TextureFormat::Normal };
+	m_pTextureGlossines     = TextureHandle{ "Resources/vehicle_gloss.png", m_UseCompressedTextures ? TextureFormat::BC4 : TextureFormat::R8 };
+	m_pTextureSpecular      = TextureHandle{ "Resources/vehicle_specular.png", m_UseCompressedTextures ? TextureFormat::BC1 : TextureFormat::RGBA8 };
+	m_pTextureVehicle       = TextureHandle{ "Resources/vehicle_diffuse.png", m_UseCompressedTextures ? TextureFormat::BC1 : TextureFormat::RGBA8 };
+	for (TextureHandle* pHandle : { &m_pTextureNormalMap, &m_pTextureGlossines, &m_pTextureSpecular, &m_pTextureVehicle })
+		pHandle->Prefetch();
+}
+
+void dae::Renderer::CreateVehicleMaterial()
+{
+	//The interleaved material stores every map uncompressed, so it is only worth it when memory is not the limit
+	delete m_pMaterialVehicle;
+	m_pMaterialVehicle = nullptr;
+	if (!m_UseCompressedTextures)
+		m_pMaterialVehicle = Material::CreateFromTextures(m_pTextureVehicle.Get(), m_pTextureSpecular.Get(), m_pTextureGlossines.Get(), m_pTextureNormalMap.Get());
+}
+
+void dae::Renderer::SwitchDepthMode()
+{
+	const int amountOfModes{ 3 };
+	const DepthMode mode{ static_cast<DepthMode>((int(m_Camera.depthMode) + 1) % amountOfModes) };
+
+	//Reversed-Z keeps its precision over a much longer range, so the far plane can be pushed out
+	m_Camera.SetDepthMode(mode);
+	m_Camera.farPlane = (mode == DepthMode::Standard) ? m_StandardFarPlane : m_ReversedFarPlane;
+	m_Camera.CalculateProjectionMatrix();
+	ResetDepthBuffer();
+	std::cout << "DepthMode: standard/reversedZ/reversedZ infinite " << int(mode) << std::endl;
+}
+
 
 void Renderer::IntroRender()const
 {
@@ -1011,6 +1397,7 @@ void dae::Renderer::Render_W3_1()
 	for (Mesh& mesh : m_Meshes_world)
 	{
 		bool isColored{ false };//-> get value from depthBuffer if pixel is already colored  
+		m_ObjectToWorld = mesh.worldMatrix;
 		
 		//World to NDCSpace
 		std::vector<Vector4> vertices_NDC{};
@@ -1145,6 +1532,21 @@ void dae::Renderer::Render_W4_1()
 {
 	
 	ColorRGB finalColor{ colors::Negative };
+	const bool reversedZ{ m_Camera.IsReversedZ() };
+
+	if (m_UseMSAA)
+		ResetMsaaBuffers(m_DirtyRect);
+
+	//Local lights need the depth off the visible surfaces before shading, MSAA culls against the full depth range
+	m_HasLocalLights = std::ranges::any_of(m_Lights, [](const Light& light) { return light.type != LightType::Directional; });
+	if (m_HasLocalLights && !m_UseMSAA)
+		RenderLightDepthPrepass();
+	m_LightGrid.Cull(m_Lights, m_Camera.viewMatrix, m_Camera.projectionMatrix, m_Camera.nearPlane,
+		m_UseMSAA ? nullptr : m_LightDepth.data(), m_Width, m_Height, m_DirtyRect);
+	const std::vector<int>& directionalLights{ m_LightGrid.GetDirectionalLights() };
+	const bool shadowMapChanged{ m_UseShadows && !directionalLights.empty() && m_ShadowMap.Update(m_Lights[directionalLights[0]].direction, m_Meshes_world) };
+	if (m_UseTextureSpaceShading)
+		UpdateShadingCaches(shadowMapChanged);
 
 	//////////////////////////////////////////////////////////////////////////////////
 	//Check every Mesh
@@ -1152,6 +1554,11 @@ void dae::Renderer::Render_W4_1()
 	for (Mesh& mesh : m_Meshes_world)
 	{
 		bool isColored{ false };//-> get value from depthBuffer if pixel is already colored  
+		m_ObjectToWorld = mesh.worldMatrix;
+		const size_t meshIndex{ size_t(&mesh - m_Meshes_world.data()) };
+		//A mesh with overlapping uvs is shaded per pixel, its shared texels can only cache one surface
+		m_pShadingCache = (m_UseTextureSpaceShading && HasViewIndependentTerms() && meshIndex < m_ShadingCaches.size()
+			&& m_ShadingCaches[meshIndex].GetOverlappingTexelCount() == 0) ? &m_ShadingCaches[meshIndex] : nullptr;
 
 		//World to NDCSpace
 		std::vector<Vertex_Out> vertices_NDC{};
@@ -1163,6 +1570,10 @@ void dae::Renderer::Render_W4_1()
 		vector2_Screen.reserve(mesh.vertices.size());
 		VertectTransformToScreen(vertices_NDC, vector2_Screen);
 
+		//Vertex lighting shades every unique vertex once, the pixels only interpolate the color
+		if (m_ShadingFrequency != ShadingFrequency::PerPixel)
+			ShadeVertices(vertices_NDC);
+
 		//////////////////////////////////////////////////////////////////////////
 		//loop through every triangle of current mesh
 
@@ -1190,18 +1601,20 @@ void dae::Renderer::Render_W4_1()
 		for (size_t indc{ 0 }; indc < mesh.indices.size() - sizeReducer; indc += increment)
 		{
 			//check if triangle is in frustom
-			if (vertices_NDC[mesh.indices[indc + 0]].position.x < -1.0f || vertices_NDC[mesh.indices[indc + 0]].position.x > 1.0f || vertices_NDC[mesh.indices[indc + 1]].position.x < -1.0f || vertices_NDC[mesh.indices[indc + 1]].position.x > 1.0f || vertices_NDC[mesh.indices[indc + 2]].position.x < -1.0f || vertices_NDC[mesh.indices[indc + 2]].position.x > 1.0f ||
-				vertices_NDC[mesh.indices[indc + 0]].position.y < -1.0f || vertices_NDC[mesh.indices[indc + 0]].position.y > 1.0f || vertices_NDC[mesh.indices[indc + 1]].position.y < -1.0f || vertices_NDC[mesh.indices[indc + 1]].position.y > 1.0f || vertices_NDC[mesh.indices[indc + 2]].position.y < -1.0f || vertices_NDC[mesh.indices[indc + 2]].position.y > 1.0f ||
-				vertices_NDC[mesh.indices[indc + 0]].position.z < 0     || vertices_NDC[mesh.indices[indc + 0]].position.z > 1.0f || vertices_NDC[mesh.indices[indc + 1]].position.z < 0     || vertices_NDC[mesh.indices[indc + 1]].position.z > 1.0f || vertices_NDC[mesh.indices[indc + 2]].position.z < 0     || vertices_NDC[mesh.indices[indc + 2]].position.z > 1.0f)
+			if (IsOutsideFrustum(vertices_NDC[mesh.indices[indc + 0]].position) ||
+				IsOutsideFrustum(vertices_NDC[mesh.indices[indc + 1]].position) ||
+				IsOutsideFrustum(vertices_NDC[mesh.indices[indc + 2]].position))
 				continue;
 			
 
 #pragma region BoundingBox
-			//check bounds off current triangle
-			const int left{ Clamp(int(std::min(std::min(vector2_Screen[mesh.indices[indc + 0]].x, vector2_Screen[mesh.indices[indc + 1]].x), vector2_Screen[mesh.indices[indc + 2]].x) - 1), 0, m_Width) };
-			const int top{ Clamp(int(std::min(std::min(vector2_Screen[mesh.indices[indc + 0]].y, vector2_Screen[mesh.indices[indc + 1]].y), vector2_Screen[mesh.indices[indc + 2]].y) - 1), 0, m_Height) };
-			const int right{ Clamp(int(std::max(std::max(vector2_Screen[mesh.indices[indc + 0]].x, vector2_Screen[mesh.indices[indc + 1]].x), vector2_Screen[mesh.indices[indc + 2]].x) + 1), 0, m_Width) };
-			const int bottom{ Clamp(int(std::max(std::max(vector2_Screen[mesh.indices[indc + 0]].y, vector2_Screen[mesh.indices[indc + 1]].y), vector2_Screen[mesh.indices[indc + 2]].y) + 1), 0, m_Height) };
+			//check bounds off current triangle, limited to the region that is rendered this frame
+			const int left{ Clamp(int(std::min(std::min(vector2_Screen[mesh.indices[indc + 0]].x, vector2_Screen[mesh.indices[indc + 1]].x), vector2_Screen[mesh.indices[indc + 2]].x) - 1), m_DirtyRect.left, m_DirtyRect.right) };
+			const int top{ Clamp(int(std::min(std::min(vector2_Screen[mesh.indices[indc + 0]].y, vector2_Screen[mesh.indices[indc + 1]].y), vector2_Screen[mesh.indices[indc + 2]].y) - 1), m_DirtyRect.top, m_DirtyRect.bottom) };
+			const int right{ Clamp(int(std::max(std::max(vector2_Screen[mesh.indices[indc + 0]].x, vector2_Screen[mesh.indices[indc + 1]].x), vector2_Screen[mesh.indices[indc + 2]].x) + 1), m_DirtyRect.left, m_DirtyRect.right) };
+			const int bottom{ Clamp(int(std::max(std::max(vector2_Screen[mesh.indices[indc + 0]].y, vector2_Screen[mesh.indices[indc + 1]].y), vector2_Screen[mesh.indices[indc + 2]].y) + 1), m_DirtyRect.top, m_DirtyRect.bottom) };
+			if (left >= right || top >= bottom)
+				continue;
 #pragma endregion BoundingBox calulations
 
 			//Calculate area off current triangle and check if it is a line;
@@ -1209,83 +1622,82 @@ void dae::Renderer::Render_W4_1()
 			const float W  = inverter * Vector2::Cross(vector2_Screen[mesh.indices[indc + 0]] - vector2_Screen[mesh.indices[indc + 2]], vector2_Screen[mesh.indices[indc + 1]] - vector2_Screen[mesh.indices[indc + 2]]);
 			if (W <= 0.0001f && W >= -0.0001f)continue;
 
+			TriangleSetup triangle
+			{
+				{ &vertices_NDC[mesh.indices[indc + 0]], &vertices_NDC[mesh.indices[indc + 1]], &vertices_NDC[mesh.indices[indc + 2]] },
+				{ vector2_Screen[mesh.indices[indc + 0]], vector2_Screen[mesh.indices[indc + 1]], vector2_Screen[mesh.indices[indc + 2]] },
+				inverter / W
+			};
+			if (m_TextureFiltering != TextureFiltering::Point)
+				CalculateUvGradients(triangle);
+			++m_TriangleId;
+			const int triangleShadingRate{ (m_VrsMode != VariableRateShading::Off && !m_UseMSAA) ? CalculateTriangleShadingRate(triangle, std::abs(W)) : 1 };
+
+			//Full rate pixels off this triangle are shaded in batches so their texture fetches can be vectorized
+			const bool batchShading{ m_TextureFiltering == TextureFiltering::Bilinear && !m_UseMSAA && m_ShadingFrequency == ShadingFrequency::PerPixel };
+			Vertex_Out batchPixels[m_ShadingBatchSize]{};
+			int batchPixelIndices[m_ShadingBatchSize]{};
+			int batchCount{};
+
 			//Check for every pxl off the boundingBox if in current triangle
 			for (int px{ left }; px < right; ++px)
 			{
 				for (int py{ top }; py < bottom; ++py)
 				{
+					if (m_UseMSAA)
+					{
+						RasterizeMsaaPixel(px, py, triangle, reversedZ);
+						continue;
+					}
+
 					//pixel position and index
 					int pxl{ px + py * m_Width };
 					Vector2 pxlScr{ px + 0.5f, py + 0.5f };
 
-					//Calculate total area off current triangle and the weight off every corner
-					const float W2 = inverter * Vector2::Cross(pxlScr - vector2_Screen[mesh.indices[indc + 0]], vector2_Screen[mesh.indices[indc + 1]] - vector2_Screen[mesh.indices[indc + 0]]) / W;
-					const float W0 = inverter * Vector2::Cross(pxlScr - vector2_Screen[mesh.indices[indc + 1]], vector2_Screen[mesh.indices[indc + 2]] - vector2_Screen[mesh.indices[indc + 1]]) / W;
-					const float W1 = inverter * Vector2::Cross(pxlScr - vector2_Screen[mesh.indices[indc + 2]], vector2_Screen[mesh.indices[indc + 0]] - vector2_Screen[mesh.indices[indc + 2]]) / W;
+					//Calculate the weight off every corner
+					float W0{}, W1{}, W2{};
+					CalculateWeights(triangle, pxlScr, W0, W1, W2);
 
 					//if pxl in current triangle, check depth
 					if (W0 < 0.0f && W1 < 0.0f && W2 < 0.0f)
 					{
-						const float zBufferValue
-						{ -1.0f / (
-							  ((W0) / vertices_NDC[mesh.indices[indc + 0]].position.w)
-							+ ((W1) / vertices_NDC[mesh.indices[indc + 1]].position.w)
-							+ ((W2) / vertices_NDC[mesh.indices[indc + 2]].position.w)
-						) };
+						const float zBufferValue{ InterpolateDepth(triangle, W0, W1, W2, reversedZ) };
 
 						//Compare with DepthBuffer
-						if (m_pDepthBufferPixels[pxl] > zBufferValue)
+						if (reversedZ ? zBufferValue > m_pDepthBufferPixels[pxl] : zBufferValue < m_pDepthBufferPixels[pxl])
 						{
-							const float zInterpolated
-							{ 1.0f / (
-								  ((W0) / vertices_NDC[mesh.indices[indc + 0]].position.w)
-								+ ((W1) / vertices_NDC[mesh.indices[indc + 1]].position.w)
-								+ ((W2) / vertices_NDC[mesh.indices[indc + 2]].position.w)
-							) };
-
 							m_pDepthBufferPixels[pxl] = zBufferValue;
 
-							//-----------------------------------------------------------------------------
-
-
-							//Interpolate vertex for shading
-							////////////////////////////////////////////////////////////////
-#pragma region Interpolation 
-							Vertex_Out interpolatedVertex{};
-							interpolatedVertex.uv = { (
-									  vertices_NDC[mesh.indices[indc + 0]].uv * (W0) / vertices_NDC[mesh.indices[indc + 0]].position.w
-									+ vertices_NDC[mesh.indices[indc + 1]].uv * (W1) / vertices_NDC[mesh.indices[indc + 1]].position.w
-									+ vertices_NDC[mesh.indices[indc + 2]].uv * (W2) / vertices_NDC[mesh.indices[indc + 2]].position.w
-									  ) * zInterpolated
-								};
-
-							interpolatedVertex.normal = { (
-									  vertices_NDC[mesh.indices[indc + 0]].normal * (W0) / vertices_NDC[mesh.indices[indc + 0]].position.w
-									+ vertices_NDC[mesh.indices[indc + 1]].normal * (W1) / vertices_NDC[mesh.indices[indc + 1]].position.w
-									+ vertices_NDC[mesh.indices[indc + 2]].normal * (W2) / vertices_NDC[mesh.indices[indc + 2]].position.w
-									  ) * zInterpolated
-								};
-							interpolatedVertex.normal.Normalize();
-
-							interpolatedVertex.tangent = { (
-									  vertices_NDC[mesh.indices[indc + 0]].tangent * (W0) / vertices_NDC[mesh.indices[indc + 0]].position.w
-									+ vertices_NDC[mesh.indices[indc + 1]].tangent * (W1) / vertices_NDC[mesh.indices[indc + 1]].position.w
-									+ vertices_NDC[mesh.indices[indc + 2]].tangent * (W2) / vertices_NDC[mesh.indices[indc + 2]].position.w
-									  ) * zInterpolated
-								};
-							interpolatedVertex.tangent.Normalize();
-
-							interpolatedVertex.viewDirection = { (
-									  vertices_NDC[mesh.indices[indc + 0]].viewDirection* (W0) / vertices_NDC[mesh.indices[indc + 0]].position.w
-									+ vertices_NDC[mesh.indices[indc + 1]].viewDirection * (W1) / vertices_NDC[mesh.indices[indc + 1]].position.w
-									+ vertices_NDC[mesh.indices[indc + 2]].viewDirection * (W2) / vertices_NDC[mesh.indices[indc + 2]].position.w
-									  ) * zInterpolated
-							};
-							interpolatedVertex.viewDirection.Normalize();
-#pragma endregion Interpolatin 
-							
-
-							finalColor = ShadePxl(interpolatedVertex);
+							//Interpolate vertex for shading, coarse rates reuse the result off the first pixel shaded in their cell
+							const int shadingRate{ triangleShadingRate == 1 ? 1 : std::min(triangleShadingRate, int(m_ShadingRates[(px / m_ShadingRateTileSize) + (py / m_ShadingRateTileSize) * m_ShadingRateTilesX])) };
+							if (shadingRate == 1 && batchShading)
+							{
+								batchPixels[batchCount]       = InterpolateVertex(triangle, W0, W1, W2);
+								batchPixelIndices[batchCount] = pxl;
+								if (++batchCount == m_ShadingBatchSize)
+								{
+									ShadePxlBatch(batchPixels, batchPixelIndices, batchCount);
+									batchCount = 0;
+								}
+							}
+							else if (shadingRate == 1)
+							{
+								finalColor = ShadePxl(InterpolateVertex(triangle, W0, W1, W2));
+							}
+							else
+							{
+								CoarseShade& cell{ m_CoarseShadeCache[py - py % shadingRate] };
+								if (cell.triangleId != m_TriangleId || cell.cellX != px / shadingRate || cell.rate != shadingRate)
+								{
+									//One shade covers shadingRate pixels, so the texture footprint grows with it
+									Vertex_Out coarseVertex{ InterpolateVertex(triangle, W0, W1, W2) };
+									coarseVertex.uvDdx *= float(shadingRate);
+									coarseVertex.uvDdy *= float(shadingRate);
+									cell = CoarseShade{ m_TriangleId, px / shadingRate, shadingRate, ShadePxl(coarseVertex) };
+								}
+
+								finalColor = cell.color;
+							}
 						}
 					}//end if pxl in triangle
 
@@ -1314,21 +1726,481 @@ void dae::Renderer::Render_W4_1()
 
 			}//end for px
 
+			if (batchCount > 0)
+				ShadePxlBatch(batchPixels, batchPixelIndices, batchCount);
+
 		}//end for each triangle
 
 	}//end for each Mesh
+
+	if (m_UseMSAA)
+		ResolveMsaa(m_DirtyRect);
+
+	ResetDepthBuffer();
+}
+
+void dae::Renderer::UpdateDynamicResolution(float elapsedSec)
+{
+	//Smooth the frame time so a single hitch does not drop the resolution
+	m_SmoothedFrameTime = Lerpf(m_SmoothedFrameTime, elapsedSec, 0.1f);
+
+	//Leave a dead zone around the target so the resolution does not oscillate
+	const float ratio{ m_TargetFrameTime / m_SmoothedFrameTime };
+	if (ratio > 0.95f && ratio < 1.1f)
+		return;
+
+	//Raster cost scales with the pixel count, so the linear scale follows the square root of the ratio
+	const float desiredScale{ m_ResolutionScale * std::sqrt(ratio) };
+	m_ResolutionScale = Clamp(Lerpf(m_ResolutionScale, desiredScale, 0.25f), m_MinResolutionScale, 1.0f);
+
+	//Keep the resolution a multiple of 8 so screen tiles stay aligned
+	const int width { std::min(m_WindowWidth , std::max(8, int(m_WindowWidth  * m_ResolutionScale) & ~7)) };
+	const int height{ std::min(m_WindowHeight, std::max(8, int(m_WindowHeight * m_ResolutionScale) & ~7)) };
+	SetRenderResolution(width, height);
+}
+
+void dae::Renderer::SetRenderResolution(int width, int height)
+{
+	if (width == m_Width && height == m_Height)
+		return;
+
+	//The back and depth buffer keep their window size, the image is packed with a stride of m_Width
+	m_Width  = width;
+	m_Height = height;
 	ResetDepthBuffer();
 }
 
+bool dae::Renderer::IsRenderResolutionScaled() const
+{
+	return m_Width != m_WindowWidth || m_Height != m_WindowHeight;
+}
+
+void dae::Renderer::UpscaleToWindow() const
+{
+	SDL_LockSurface(m_pUpscaleBuffer);
+	Upscaler::UpscaleBilinear(m_pBackBufferPixels, m_Width, m_Height, (uint32_t*)m_pUpscaleBuffer->pixels, m_WindowWidth, m_WindowHeight, m_pUpscaleBuffer->pitch / 4);
+	SDL_UnlockSurface(m_pUpscaleBuffer);
+}
+
+void dae::Renderer::RenderLightDepthPrepass()
+{
+	//Depth only raster off every mesh, keeps the view depth off the nearest surface per pixel in the dirty rect
+	m_LightDepth.resize(size_t(m_WindowWidth) * m_WindowHeight);
+	for (int py{ m_DirtyRect.top }; py < m_DirtyRect.bottom; ++py)
+		std::fill_n(m_LightDepth.begin() + (m_DirtyRect.left + py * m_Width), m_DirtyRect.right - m_DirtyRect.left, std::numeric_limits<float>::max());
+
+	for (const Mesh& mesh : m_Meshes_world)
+	{
+		std::vector<Vertex_Out> vertices_NDC{};
+		vertices_NDC.reserve(mesh.vertices.size());
+		ViewProjectionToNDC(mesh, vertices_NDC);
+
+		std::vector<Vector2> vector2_Screen{};
+		vector2_Screen.reserve(mesh.vertices.size());
+		VertectTransformToScreen(vertices_NDC, vector2_Screen);
+
+		const bool isStrip{ mesh.primitiveTopology == PrimitiveTopology::TriangleStrip };
+		const size_t increment{ isStrip ? 1u : 3u };
+		const size_t sizeReducer{ isStrip ? 2u : 0u };
+		for (size_t indc{ 0 }; indc + sizeReducer < mesh.indices.size(); indc += increment)
+		{
+			const uint32_t indices[3]{ mesh.indices[indc + 0], mesh.indices[indc + 1], mesh.indices[indc + 2] };
+			if (IsOutsideFrustum(vertices_NDC[indices[0]].position) ||
+				IsOutsideFrustum(vertices_NDC[indices[1]].position) ||
+				IsOutsideFrustum(vertices_NDC[indices[2]].position))
+				continue;
+
+			const Vector2& screen0{ vector2_Screen[indices[0]] };
+			const Vector2& screen1{ vector2_Screen[indices[1]] };
+			const Vector2& screen2{ vector2_Screen[indices[2]] };
+			const int left{ Clamp(int(std::min(std::min(screen0.x, screen1.x), screen2.x) - 1), m_DirtyRect.left, m_DirtyRect.right) };
+			const int top{ Clamp(int(std::min(std::min(screen0.y, screen1.y), screen2.y) - 1), m_DirtyRect.top, m_DirtyRect.bottom) };
+			const int right{ Clamp(int(std::max(std::max(screen0.x, screen1.x), screen2.x) + 1), m_DirtyRect.left, m_DirtyRect.right) };
+			const int bottom{ Clamp(int(std::max(std::max(screen0.y, screen1.y), screen2.y) + 1), m_DirtyRect.top, m_DirtyRect.bottom) };
+			if (left >= right || top >= bottom)
+				continue;
+
+			const int inverter{ (isStrip && indc % 2 != 0) ? -1 : 1 };
+			const float W{ inverter * Vector2::Cross(screen0 - screen2, screen1 - screen2) };
+			if (W <= 0.0001f && W >= -0.0001f)
+				continue;
+
+			const TriangleSetup triangle
+			{
+				{ &vertices_NDC[indices[0]], &vertices_NDC[indices[1]], &vertices_NDC[indices[2]] },
+				{ screen0, screen1, screen2 },
+				inverter / W
+			};
+			for (int py{ top }; py < bottom; ++py)
+			{
+				for (int px{ left }; px < right; ++px)
+				{
+					float W0{}, W1{}, W2{};
+					CalculateWeights(triangle, Vector2{ px + 0.5f, py + 0.5f }, W0, W1, W2);
+					if (W0 < 0.0f && W1 < 0.0f && W2 < 0.0f)
+					{
+						float& depth{ m_LightDepth[px + py * m_Width] };
+						depth = std::min(depth, InterpolateDepth(triangle, W0, W1, W2, false));
+					}
+				}
+			}
+		}
+	}
+}
+
+void dae::Renderer::UpdateShadingRateImage()
+{
+	m_ShadingRateTilesX = (m_Width  + m_ShadingRateTileSize - 1) / m_ShadingRateTileSize;
+	const int tilesY{ (m_Height + m_ShadingRateTileSize - 1) / m_ShadingRateTileSize };
+	m_ShadingRates.resize(size_t(m_ShadingRateTilesX) * tilesY);
+	m_ShadingRateAges.resize(m_ShadingRates.size());
+	m_CoarseShadeCache.resize(m_WindowHeight);
+
+	//The previous frame is only usable when it was rendered at the same resolution
+	if (m_ShadingRateImageWidth != m_Width || m_ShadingRateImageHeight != m_Height)
+	{
+		m_ShadingRateImageWidth  = m_Width;
+		m_ShadingRateImageHeight = m_Height;
+		std::fill(m_ShadingRates.begin(), m_ShadingRates.end(), uint8_t(1));
+		std::fill(m_ShadingRateAges.begin(), m_ShadingRateAges.end(), uint8_t(0));
+		return;
+	}
+
+	//Only the tiles under the dirty rect are drawn again, the others keep the rate their pixels were shaded at
+	const int firstTileX{ m_DirtyRect.left / m_ShadingRateTileSize };
+	const int firstTileY{ m_DirtyRect.top  / m_ShadingRateTileSize };
+	const int endTileX{ std::min((m_DirtyRect.right  + m_ShadingRateTileSize - 1) / m_ShadingRateTileSize, m_ShadingRateTilesX) };
+	const int endTileY{ std::min((m_DirtyRect.bottom + m_ShadingRateTileSize - 1) / m_ShadingRateTileSize, tilesY) };
+
+	//Tiles with a low luminance contrast in the previous frame get shaded coarser
+	const float threshold{ m_VrsMode == VariableRateShading::Quality ? m_VrsQualityContrast : m_VrsPerformanceContrast };
+	const SDL_PixelFormat* pFormat{ m_pBackBuffer->format };
+	for (int tileY{ firstTileY }; tileY < endTileY; ++tileY)
+	{
+		for (int tileX{ firstTileX }; tileX < endTileX; ++tileX)
+		{
+			//Coarse shading flattens the contrast it is measured on, so a coarse tile keeps its rate for a while and is then shaded at full rate to measure it again
+			const int tile{ tileX + tileY * m_ShadingRateTilesX };
+			if (m_ShadingRates[tile] != 1)
+			{
+				if (++m_ShadingRateAges[tile] >= m_VrsRefreshInterval)
+					m_ShadingRates[tile] = 1;
+				continue;
+			}
+
+			int minLuma{ 255 }, maxLuma{ 0 };
+			const int endY{ std::min((tileY + 1) * m_ShadingRateTileSize, m_Height) };
+			const int endX{ std::min((tileX + 1) * m_ShadingRateTileSize, m_Width) };
+			for (int py{ tileY * m_ShadingRateTileSize }; py < endY; ++py)
+			{
+				for (int px{ tileX * m_ShadingRateTileSize }; px < endX; ++px)
+				{
+					const uint32_t pixel{ m_pBackBufferPixels[px + py * m_Width] };
+					const int r{ int((pixel & pFormat->Rmask) >> pFormat->Rshift) };
+					const int g{ int((pixel & pFormat->Gmask) >> pFormat->Gshift) };
+					const int b{ int((pixel & pFormat->Bmask) >> pFormat->Bshift) };
+					const int luma{ (2 * r + 5 * g + b) >> 3 };
+					minLuma = std::min(minLuma, luma);
+					maxLuma = std::max(maxLuma, luma);
+				}
+			}
+
+			const float contrast{ (maxLuma - minLuma) / 255.0f };
+			uint8_t rate{ 1 };
+			if (contrast < threshold * 0.25f)
+				rate = 4;
+			else if (contrast < threshold)
+				rate = 2;
+			m_ShadingRates[tile] = rate;
+
+			//Staggered, so the tiles that turned coarse together are not all refreshed in the same frame
+			m_ShadingRateAges[tile] = uint8_t((tileX + 3 * tileY) % m_VrsRefreshInterval);
+		}
+	}
+}
+
+int dae::Renderer::CalculateTriangleShadingRate(const TriangleSetup& triangle, float screenArea) const
+{
+	//Texels covered per pixel: minified triangles carry texture detail and stay at full rate, magnified ones can share shading
+	const Vector2& uv0{ triangle.pVertices[0]->uv };
+	const Vector2& uv1{ triangle.pVertices[1]->uv };
+	const Vector2& uv2{ triangle.pVertices[2]->uv };
+	const float uvArea{ std::abs(Vector2::Cross(uv1 - uv0, uv2 - uv0)) };
+	const float texelsPerPixel{ uvArea * m_pTextureVehicle->GetWidth() * m_pTextureVehicle->GetHeight() / screenArea };
+
+	if (texelsPerPixel > 0.25f)
+		return 1;
+	if (texelsPerPixel > 1.0f / 16.0f)
+		return 2;
+	return 4;
+}
+
+void dae::Renderer::CalculateWeights(const TriangleSetup& triangle, const Vector2& point, float& W0, float& W1, float& W2) const
+{
+	W2 = Vector2::Cross(point - triangle.screen[0], triangle.screen[1] - triangle.screen[0]) * triangle.inverseArea;
+	W0 = Vector2::Cross(point - triangle.screen[1], triangle.screen[2] - triangle.screen[1]) * triangle.inverseArea;
+	W1 = Vector2::Cross(point - triangle.screen[2], triangle.screen[0] - triangle.screen[2]) * triangle.inverseArea;
+}
+
+float dae::Renderer::InterpolateDepth(const TriangleSetup& triangle, float W0, float W1, float W2, bool reversedZ) const
+{
+	const Vertex_Out& v0{ *triangle.pVertices[0] };
+	const Vertex_Out& v1{ *triangle.pVertices[1] };
+	const Vertex_Out& v2{ *triangle.pVertices[2] };
+
+	//Standard depth keeps the interpolated view depth, reversed-Z the ndc depth (linear in screen space)
+	if (reversedZ)
+		return -(W0 * v0.position.z + W1 * v1.position.z + W2 * v2.position.z);
+
+	return -1.0f / (W0 / v0.position.w + W1 / v1.position.w + W2 / v2.position.w);
+}
+
+Vertex_Out dae::Renderer::InterpolateVertex(const TriangleSetup& triangle, float W0, float W1, float W2) const
+{
+	const Vertex_Out& v0{ *triangle.pVertices[0] };
+	const Vertex_Out& v1{ *triangle.pVertices[1] };
+	const Vertex_Out& v2{ *triangle.pVertices[2] };
+
+	const float zInterpolated
+	{ 1.0f / (
+		  ((W0) / v0.position.w)
+		+ ((W1) / v1.position.w)
+		+ ((W2) / v2.position.w)
+	) };
+
+#pragma region Interpolation 
+	Vertex_Out interpolatedVertex{};
+	interpolatedVertex.uv = { (
+			  v0.uv * (W0) / v0.position.w
+			+ v1.uv * (W1) / v1.position.w
+			+ v2.uv * (W2) / v2.position.w
+			  ) * zInterpolated
+		};
+
+	//Quotient rule on (uv/w) / (1/w)
+	if (m_TextureFiltering != TextureFiltering::Point)
+	{
+		interpolatedVertex.uvDdx = (triangle.uvOverWDdx - interpolatedVertex.uv * triangle.inverseWDdx) * zInterpolated;
+		interpolatedVertex.uvDdy = (triangle.uvOverWDdy - interpolatedVertex.uv * triangle.inverseWDdy) * zInterpolated;
+	}
+
+	//Vertex lighting only carries the lit color, next to the uv for the diffuse texture
+	if (m_ShadingFrequency != ShadingFrequency::PerPixel)
+	{
+		interpolatedVertex.color = { (
+				  v0.color * (W0) / v0.position.w
+				+ v1.color * (W1) / v1.position.w
+				+ v2.color * (W2) / v2.position.w
+				  ) * zInterpolated
+			};
+		return interpolatedVertex;
+	}
+
+	interpolatedVertex.normal = { (
+			  v0.normal * (W0) / v0.position.w
+			+ v1.normal * (W1) / v1.position.w
+			+ v2.normal * (W2) / v2.position.w
+			  ) * zInterpolated
+		};
+	interpolatedVertex.normal.Normalize();
+
+	//Only the tangent space normal map needs the tangent
+	if (m_UseNormalMap && !UsesObjectSpaceNormals())
+	{
+		interpolatedVertex.tangent = { (
+				  v0.tangent * (W0) / v0.position.w
+				+ v1.tangent * (W1) / v1.position.w
+				+ v2.tangent * (W2) / v2.position.w
+				  ) * zInterpolated
+			};
+		interpolatedVertex.tangent.Normalize();
+	}
+
+	interpolatedVertex.viewDirection = { (
+			  v0.viewDirection * (W0) / v0.position.w
+			+ v1.viewDirection * (W1) / v1.position.w
+			+ v2.viewDirection * (W2) / v2.position.w
+			  ) * zInterpolated
+	};
+	interpolatedVertex.viewDirection.Normalize();
+
+	//The weights sum to -1 inside the triangle, the screen position picks the light tile
+	//The world position is only needed for local lights and the shadow map lookup
+	interpolatedVertex.position.x = -(W0 * triangle.screen[0].x + W1 * triangle.screen[1].x + W2 * triangle.screen[2].x);
+	interpolatedVertex.position.y = -(W0 * triangle.screen[0].y + W1 * triangle.screen[1].y + W2 * triangle.screen[2].y);
+	if (m_HasLocalLights || m_UseShadows)
+	{
+		interpolatedVertex.worldPosition = { (
+				  v0.worldPosition * (W0) / v0.position.w
+				+ v1.worldPosition * (W1) / v1.position.w
+				+ v2.worldPosition * (W2) / v2.position.w
+				  ) * zInterpolated
+			};
+	}
+#pragma endregion Interpolatin 
+
+	return interpolatedVertex;
+}
+
+void dae::Renderer::CalculateUvGradients(TriangleSetup& triangle) const
+{
+	//The weights are linear in screen space, their derivatives follow from the edges used in CalculateWeights
+	const Vector2 edge0{ triangle.screen[2] - triangle.screen[1] };
+	const Vector2 edge1{ triangle.screen[0] - triangle.screen[2] };
+	const Vector2 edge2{ triangle.screen[1] - triangle.screen[0] };
+	const float weightDdx[3]{ edge0.y * triangle.inverseArea, edge1.y * triangle.inverseArea, edge2.y * triangle.inverseArea };
+	const float weightDdy[3]{ -edge0.x * triangle.inverseArea, -edge1.x * triangle.inverseArea, -edge2.x * triangle.inverseArea };
+
+	triangle.uvOverWDdx  = {};
+	triangle.uvOverWDdy  = {};
+	triangle.inverseWDdx = 0.0f;
+	triangle.inverseWDdy = 0.0f;
+	for (int corner{}; corner < 3; ++corner)
+	{
+		const float inverseW{ 1.0f / triangle.pVertices[corner]->position.w };
+		const Vector2 uvOverW{ triangle.pVertices[corner]->uv * inverseW };
+		triangle.uvOverWDdx  += uvOverW * weightDdx[corner];
+		triangle.uvOverWDdy  += uvOverW * weightDdy[corner];
+		triangle.inverseWDdx += inverseW * weightDdx[corner];
+		triangle.inverseWDdy += inverseW * weightDdy[corner];
+	}
+}
+
+void dae::Renderer::RasterizeMsaaPixel(int px, int py, const TriangleSetup& triangle, bool reversedZ)
+{
+	const int pxl{ px + py * m_Width };
+
+	//Coverage and depth are resolved per sample
+	uint8_t coverage{};
+	Vector2 centroid{};
+	for (int sample{}; sample < m_MsaaSampleCount; ++sample)
+	{
+		const Vector2 sampleScr{ px + m_MsaaSamplePositions[sample].x, py + m_MsaaSamplePositions[sample].y };
+
+		float W0{}, W1{}, W2{};
+		CalculateWeights(triangle, sampleScr, W0, W1, W2);
+		if (W0 >= 0.0f || W1 >= 0.0f || W2 >= 0.0f)
+			continue;
+
+		const float sampleDepth{ InterpolateDepth(triangle, W0, W1, W2, reversedZ) };
+		float& storedDepth{ m_MsaaDepth[pxl * m_MsaaSampleCount + sample] };
+		if (reversedZ ? sampleDepth > storedDepth : sampleDepth < storedDepth)
+		{
+			storedDepth = sampleDepth;
+			coverage   |= uint8_t(1 << sample);
+			centroid   += sampleScr;
+		}
+	}
+	if (coverage == 0)
+		return;
+
+	//Shade once per pixel: at the center when fully covered, otherwise at the centroid of the covered samples so the attributes never get extrapolated
+	const Vector2 shadePoint{ coverage == m_MsaaFullCoverage ? Vector2{ px + 0.5f, py + 0.5f } : centroid / float(std::popcount(coverage)) };
+	float W0{}, W1{}, W2{};
+	CalculateWeights(triangle, shadePoint, W0, W1, W2);
+
+	ColorRGB finalColor{ ShadePxl(InterpolateVertex(triangle, W0, W1, W2)) };
+	finalColor.MaxToOne();
+
+	WriteMsaaFragment(pxl, coverage, SDL_MapRGB(m_pBackBuffer->format,
+		static_cast<uint8_t>(finalColor.r * 255),
+		static_cast<uint8_t>(finalColor.g * 255),
+		static_cast<uint8_t>(finalColor.b * 255)));
+}
+
+void dae::Renderer::WriteMsaaFragment(int pxl, uint8_t coverage, uint32_t color)
+{
+	//Fully covered pixels collapse back to a single color
+	if (coverage == m_MsaaFullCoverage)
+	{
+		m_MsaaColors[pxl]      = color;
+		m_MsaaEdgeIndices[pxl] = m_MsaaNoEdge;
+		return;
+	}
+
+	//Partially covered pixels get their own sample colors, only edge pixels pay for the extra storage
+	uint32_t& edgeIndex{ m_MsaaEdgeIndices[pxl] };
+	if (edgeIndex == m_MsaaNoEdge)
+	{
+		const uint32_t pixelColor{ m_MsaaColors[pxl] };
+		edgeIndex = uint32_t(m_MsaaEdges.size());
+		m_MsaaEdges.push_back(MsaaEdgePixel{ { pixelColor, pixelColor, pixelColor, pixelColor } });
+	}
+
+	MsaaEdgePixel& edge{ m_MsaaEdges[edgeIndex] };
+	for (int sample{}; sample < m_MsaaSampleCount; ++sample)
+	{
+		if (coverage & (1 << sample))
+			edge.samples[sample] = color;
+	}
+}
+
+void dae::Renderer::ResetMsaaBuffers(const ScreenRect& rect)
+{
+	const size_t pixelCount{ size_t(m_Width) * m_Height };
+	if (m_MsaaColors.size() != pixelCount)
+	{
+		m_MsaaColors.resize(pixelCount);
+		m_MsaaEdgeIndices.resize(pixelCount);
+		m_MsaaDepth.resize(pixelCount * m_MsaaSampleCount);
+	}
+
+	//Edge pixels outside the rect still point into the pool, so it can only be emptied on a full frame
+	if (rect == ScreenRect{ 0, 0, m_Width, m_Height })
+		m_MsaaEdges.clear();
+
+	const uint32_t clearColor{ SDL_MapRGB(m_pBackBuffer->format, 100, 100, 100) };
+	const float clearDepth{ m_Camera.IsReversedZ() ? 0.0f : std::numeric_limits<float>::max() };
+	for (int py{ rect.top }; py < rect.bottom; ++py)
+	{
+		const int rowStart{ rect.left + py * m_Width };
+		const int rowEnd{ rect.right + py * m_Width };
+		std::fill(m_MsaaColors.begin() + rowStart, m_MsaaColors.begin() + rowEnd, clearColor);
+		std::fill(m_MsaaEdgeIndices.begin() + rowStart, m_MsaaEdgeIndices.begin() + rowEnd, m_MsaaNoEdge);
+		std::fill(m_MsaaDepth.begin() + size_t(rowStart) * m_MsaaSampleCount, m_MsaaDepth.begin() + size_t(rowEnd) * m_MsaaSampleCount, clearDepth);
+	}
+}
+
+void dae::Renderer::ResolveMsaa(const ScreenRect& rect)
+{
+	for (int py{ rect.top }; py < rect.bottom; ++py)
+	{
+		const int rowStart{ rect.left + py * m_Width };
+		MsaaResolve::ResolveRow(&m_MsaaColors[rowStart], &m_MsaaEdgeIndices[rowStart], m_MsaaEdges.data(), &m_pBackBufferPixels[rowStart], rect.right - rect.left);
+	}
+}
+
+
+
+
 
+ScreenRect dae::Renderer::CalculateDirtyRect()
+{
+	const FrameState state{ m_Camera.viewMatrix, m_Camera.projectionMatrix, m_Camera.depthMode, m_LightMode, m_SpecularModel, m_TextureFiltering, m_ShadingFrequency, m_UseTextureSpaceShading, m_UseInterleavedMaterial, m_UseCompressedTextures, m_UseNormalMap, UsesObjectSpaceNormals(),
+		m_UseMSAA, m_UseShadows, m_VrsMode, m_Width, m_Height };
 
+	//The MSAA edge pool is only emptied on a full frame, a moved caster also moves its shadow, which can fall on any other mesh
+	const bool forceFullFrame{ !m_UseIncrementalRendering || (m_UseMSAA && m_MsaaEdges.size() > size_t(m_Width) * m_Height / 4) };
+	return m_FrameTracker.Update(state, m_Lights, m_Meshes_world, m_Camera.viewMatrix * m_Camera.projectionMatrix, m_Camera.nearPlane,
+		m_Width, m_Height, forceFullFrame, m_UseShadows);
+}
 
+void dae::Renderer::ClearColorRect(const ScreenRect& rect, uint32_t color)
+{
+	//The back buffer is packed with a stride off m_Width, which SDL_FillRect does not know about
+	for (int py{ rect.top }; py < rect.bottom; ++py)
+	{
+		std::fill(m_pBackBufferPixels + rect.left + py * m_Width, m_pBackBufferPixels + rect.right + py * m_Width, color);
+	}
+}
 
 void dae::Renderer::ResetDepthBuffer()
 {
+	//Reversed-Z clears to the far plane at 0, everything in front of it is greater
+	const float clearValue{ m_Camera.IsReversedZ() ? 0.0f : std::numeric_limits<float>::max() };
 	for (int i{}; i < (m_Width * m_Height); ++i)
 	{
-		m_pDepthBufferPixels[i] = std::numeric_limits<float>::max();
+		m_pDepthBufferPixels[i] = clearValue;
 	}
 }
 
@@ -1421,14 +2293,23 @@ void dae::Renderer::ViewProjectionToNDC(const Mesh& world, std::vector<Vertex_Ou
 		intermediate.z /= intermediate.w;
 
 		Vector3 normal{ (world.worldMatrix.TransformVector(modelSpace[i].normal)).Normalized()};
-		Vector3 tangent{ (world.worldMatrix.TransformVector(modelSpace[i].tangent)).Normalized()};
+		Vector3 tangent{ (m_UseNormalMap && !UsesObjectSpaceNormals()) ? world.worldMatrix.TransformVector(modelSpace[i].tangent).Normalized() : Vector3{} };
+		Vector3 worldPosition{ world.worldMatrix.TransformPoint(modelSpace[i].position) };
 		Vector3 viewDir{ (world.worldMatrix.TransformVector(modelSpace[i].position) - m_Camera.origin).Normalized()};
-		Vertex_Out ndc{ intermediate, modelSpace[i].color, modelSpace[i].uv, normal, tangent, viewDir } ;
+		Vertex_Out ndc{ intermediate, modelSpace[i].color, modelSpace[i].uv, normal, tangent, viewDir, worldPosition } ;
 
 		NDC.emplace_back(ndc);
 	}
 }
 
+bool dae::Renderer::IsOutsideFrustum(const Vector4& ndc) const
+{
+	//The depth range stays [0, 1] in every DepthMode, reversed-Z only swaps which side is near
+	return ndc.x < -1.0f || ndc.x > 1.0f
+		|| ndc.y < -1.0f || ndc.y > 1.0f
+		|| ndc.z <  0.0f || ndc.z > 1.0f;
+}
+
 float dae::Renderer::Remap(float v, float min, float max) const
 {
 	float result{ (v - min) / (max - min) };
@@ -1438,75 +2319,401 @@ float dae::Renderer::Remap(float v, float min, float max) const
 
 ColorRGB dae::Renderer::ShadePxl(const Vertex_Out& pxl) const
 {
-	//Calculate observed area, if negative break
-	const Vector3 lightDirection = { .577f, -.577f, .577f };
+	//Vertex lighting already did the lighting, only the diffuse texture is left
+	switch (m_ShadingFrequency)
+	{
+	case ShadingFrequency::PerVertexTextured:
+		return pxl.color * SampleColor(m_pTextureVehicle.Get(), pxl);
+	case ShadingFrequency::PerVertex:
+		return pxl.color;
+	default:
+		//Nothing left to shade per pixel, the material is not needed
+		if (m_pShadingCache && !HasViewDependentTerms())
+			return SampleShadingCache(pxl);
+		return ShadePxl(pxl, SampleMaterial(pxl));
+	}
+}
+
+void dae::Renderer::ShadePxlBatch(const Vertex_Out* pPixels, const int* pPixelIndices, int count)
+{
+	//The maps are filtered for the whole batch in the finest level any off its pixels needs
+	const bool useMaterial{ m_UseInterleavedMaterial && m_pMaterialVehicle };
+	Vector2 uvs[m_ShadingBatchSize]{};
+	float lod{ std::numeric_limits<float>::max() };
+	for (int i{}; i < count; ++i)
+	{
+		uvs[i] = pPixels[i].uv;
+		lod    = std::min(lod, useMaterial ? m_pMaterialVehicle->CalculateLod(pPixels[i].uvDdx, pPixels[i].uvDdy) : m_pTextureVehicle->CalculateLod(pPixels[i].uvDdx, pPixels[i].uvDdy));
+	}
+	lod = std::round(lod);
+
+	//One interleaved fetch per pixel, or the color maps 8 pixels at a time with gathers
+	MaterialSample materials[m_ShadingBatchSize]{};
+	if (useMaterial)
+	{
+		m_pMaterialVehicle->SampleBilinearBatch(uvs, materials, count, lod);
+	}
+	else
+	{
+		ColorRGB diffuse[m_ShadingBatchSize]{};
+		ColorRGB specular[m_ShadingBatchSize]{};
+		m_pTextureVehicle->SampleBilinearBatch(uvs, diffuse, count, lod);
+		m_pTextureSpecular->SampleBilinearBatch(uvs, specular, count, lod);
+		for (int i{}; i < count; ++i)
+		{
+			materials[i] = { diffuse[i], specular[i], m_pTextureGlossines->SampleFloatTrilinear(uvs[i], lod) };
+			if (m_UseNormalMap && !UsesObjectSpaceNormals())
+				materials[i].normal = m_pTextureNormalMap->SampleNormalTrilinear(uvs[i], lod);
+		}
+	}
+
+	//The baked map replaces the tangent space normal
+	if (UsesObjectSpaceNormals())
+	{
+		ColorRGB objectNormals[m_ShadingBatchSize]{};
+		m_pTextureObjectNormalMap->SampleBilinearBatch(uvs, objectNormals, count, lod);
+		for (int i{}; i < count; ++i)
+			materials[i].normal = NormalMapBaker::DecodeNormal(objectNormals[i]);
+	}
 
+	for (int i{}; i < count; ++i)
+	{
+		ColorRGB finalColor{ ShadePxl(pPixels[i], materials[i]) };
+		finalColor.MaxToOne();
+		m_pBackBufferPixels[pPixelIndices[i]] = SDL_MapRGB(m_pBackBuffer->format,
+			static_cast<uint8_t>(finalColor.r * 255),
+			static_cast<uint8_t>(finalColor.g * 255),
+			static_cast<uint8_t>(finalColor.b * 255));
+	}
+}
+
+ColorRGB dae::Renderer::ShadePxl(const Vertex_Out& pxl, const MaterialSample& material) const
+{
+	//The view independent part comes from the texture space cache, only the rest is shaded per pixel
+	if (m_pShadingCache)
+	{
+		const ColorRGB cached{ SampleShadingCache(pxl) };
+		return HasViewDependentTerms() ? cached + ShadeSurface(pxl, material, CalculateShadingNormal(pxl, material), ShadingTerms::ViewDependent) : cached;
+	}
+	return ShadeSurface(pxl, material, CalculateShadingNormal(pxl, material));
+}
 
-	float
-		lightIntensity{ 7.0f },
-		cosArea{};
-	Vector3
-		normalValue{},
-		normalVector{};
-	ColorRGB
-		Ambient{.025f, .025f, .025f},
-		color{  };
+Vector3 dae::Renderer::CalculateShadingNormal(const Vertex_Out& pxl, const MaterialSample& material) const
+{
+	Vector3 normalValue{};
 
-	//Calculate normalmaps
-	if (m_UseNormalMap)
+	//Calculate normalmaps, the object space map only needs the rotation off the mesh
+	if (UsesObjectSpaceNormals())
+	{
+		normalValue = m_ObjectToWorld.TransformVector(material.normal);
+	}
+	else if (m_UseNormalMap)
 	{
 		Vector3 biNormal        { Vector3::Cross(pxl.normal, pxl.tangent) };
 		Matrix tangentSpaceAxis = Matrix{ pxl.tangent, biNormal, pxl.normal,Vector3::Zero };
-		normalVector            = m_pTextureNormalMap->SampleNormal(pxl.uv);
-		normalValue             = tangentSpaceAxis.TransformVector(normalVector);
-							
-		//Calculate observerd area, return if negative
-		cosArea = lightDirection.Dot(-lightDirection, normalValue) ;
-		if (cosArea < 0.0f)
-			return {};
-	
+		normalValue             = tangentSpaceAxis.TransformVector(material.normal);
 	}
 	else
 	{
 		normalValue = pxl.normal;
-		cosArea     = lightDirection.Dot(-lightDirection, pxl.normal) ;
-		if (cosArea < 0.0f)
-			return {};
 	}
+	return normalValue;
+}
 
-	const float shininess            { 25.f };
-	const Vector3 ambient			 { 0.25f, 0.25f, 0.25f };
-	const float GlossMapValue        { m_pTextureGlossines->SampleFloat(pxl.uv)  * shininess };
-	const ColorRGB specularMapValue  { m_pTextureSpecular->Sample(pxl.uv) };
-	const ColorRGB diffuseMap        { m_pTextureVehicle->Sample(pxl.uv) };
-	const ColorRGB diffuseColor      { BRDF::Lambert(lightIntensity, diffuseMap) };
-		
-	
+ColorRGB dae::Renderer::SampleShadingCache(const Vertex_Out& pxl) const
+{
+	return m_pShadingCache->Sample(pxl.uv, [&](const Vertex& surface) { return ShadeTexel(surface, pxl); });
+}
+
+ColorRGB dae::Renderer::ShadeTexel(const Vertex& surface, const Vertex_Out& pxl) const
+{
+	//Shaded like a pixel at the full map resolution, the tile off the pixel that needs the texel picks the local lights
+	Vertex_Out texel{};
+	texel.position      = pxl.position;
+	texel.uv            = surface.uv;
+	texel.normal        = m_ObjectToWorld.TransformVector(surface.normal).Normalized();
+	texel.tangent       = m_ObjectToWorld.TransformVector(surface.tangent).Normalized();
+	texel.viewDirection = pxl.viewDirection;
+	texel.worldPosition = m_ObjectToWorld.TransformPoint(surface.position);
+
+	const MaterialSample material{ SampleMaterial(texel) };
+	return ShadeSurface(texel, material, CalculateShadingNormal(texel, material), ShadingTerms::ViewIndependent);
+}
+
+void dae::Renderer::UpdateShadingCaches(bool shadowMapChanged)
+{
+	//Built on first use, one texel per texel off the diffuse map
+	if (m_ShadingCaches.size() != m_Meshes_world.size())
+	{
+		const Texture* pDiffuse{ m_pTextureVehicle.Get() };
+		m_ShadingCaches.clear();
+		for (const Mesh& mesh : m_Meshes_world)
+			m_ShadingCaches.emplace_back(mesh, pDiffuse->GetWidth(), pDiffuse->GetHeight());
+
+		size_t memorySize{};
+		for (const TextureSpaceCache& cache : m_ShadingCaches)
+			memorySize += cache.GetMemorySize();
+		std::cout << "Texture space shading caches: " << m_ShadingCaches.size() << ", " << memorySize / 1024 << " KB" << std::endl;
+		for (size_t i{}; i < m_ShadingCaches.size(); ++i)
+		{
+			if (m_ShadingCaches[i].GetOverlappingTexelCount() > 0)
+				std::cout << "  mesh " << i << " is shaded per pixel, " << m_ShadingCaches[i].GetOverlappingTexelCount() << " off its "
+					<< m_ShadingCaches[i].GetCoveredTexelCount() << " texels are covered by more than one triangle" << std::endl;
+		}
+	}
+
+	//A moved mesh only makes its own cache stale, unless it moved the shadows with it
+	const ShadingCacheState state{ m_LightMode, m_UseNormalMap, UsesObjectSpaceNormals(), m_UseInterleavedMaterial, m_UseShadows };
+	const bool allStale{ shadowMapChanged || state != m_ShadingCacheState || m_Lights != m_ShadingCacheLights };
+	m_ShadingCacheState  = state;
+	m_ShadingCacheLights = m_Lights;
+	m_ShadingCacheWorldMatrices.resize(m_Meshes_world.size());
+	for (size_t i{}; i < m_Meshes_world.size(); ++i)
+	{
+		if (allStale || !(m_Meshes_world[i].worldMatrix == m_ShadingCacheWorldMatrices[i]))
+			m_ShadingCaches[i].Invalidate();
+		m_ShadingCacheWorldMatrices[i] = m_Meshes_world[i].worldMatrix;
+	}
+}
+
+ColorRGB dae::Renderer::ShadeVertex(const Vertex_Out& vertex) const
+{
+	//The maps are only sampled per pixel, the vertex stage uses a white diffuse and a mid specular material
+	const MaterialSample material{ colors::White, ColorRGB{ 0.5f, 0.5f, 0.5f }, 0.5f };
+	//Hidden, off screen and not redrawn vertices still light the visible pixels between them, so no tile list fits them
+	return ShadeSurface(vertex, material, vertex.normal, ShadingTerms::All, false);
+}
+
+void dae::Renderer::ShadeVertices(std::vector<Vertex_Out>& vertices) const
+{
+	//Every unique vertex is lit once
+	for (Vertex_Out& vertex : vertices)
+		vertex.color = ShadeVertex(vertex);
+}
+
+ColorRGB dae::Renderer::ShadeSurface(const Vertex_Out& pxl, const MaterialSample& material, const Vector3& normalValue, ShadingTerms terms, bool useTileLights) const
+{
+	//Directional lights reach every pixel, local lights come from the tile the pixel is in or from the full list
+	const bool viewIndependent{ terms != ShadingTerms::ViewDependent };
+	const bool viewDependent{ terms != ShadingTerms::ViewIndependent };
+	ColorRGB color{};
+	const std::vector<int>& directionalLights{ m_LightGrid.GetDirectionalLights() };
+	for (const int lightIndex : directionalLights)
+	{
+		const Light& light{ m_Lights[lightIndex] };
+		ColorRGB radiance{ light.color * light.intensity };
+		if (m_UseShadows && lightIndex == directionalLights[0] && Vector3::Dot(-light.direction, normalValue) > 0.0f)
+			radiance *= m_ShadowMap.SampleVisibility(pxl.worldPosition, pxl.normal);
+		color += ShadeLight(material, normalValue, pxl.viewDirection, light.direction, radiance, terms);
+	}
+	if (m_HasLocalLights)
+		color += ShadeLocalLights(pxl, material, normalValue, useTileLights ? m_LightGrid.GetPixelLights(pxl.position.x, pxl.position.y) : m_LightGrid.GetVertexLights(), terms);
+	//Ambient from the environment, PBR splits it into diffuse and specular itself
+	if (m_LightMode == LightingMode::PBR && viewDependent)
+		color += ShadeEnvironment(material, normalValue, pxl.viewDirection);
+	else if ((m_LightMode == LightingMode::Diffuse || m_LightMode == LightingMode::Combined) && viewIndependent)
+		color += BRDF::Lambert(1.0f, material.diffuse) * m_Environment.EvaluateIrradiance(normalValue);
+
+	return color;
+}
+
+ColorRGB dae::Renderer::ShadeLight(const MaterialSample& material, const Vector3& normal, const Vector3& viewDirection, const Vector3& lightDirection, const ColorRGB& radiance, ShadingTerms terms) const
+{
+	//Calculate observed area, return if negative
+	const float cosArea{ Vector3::Dot(-lightDirection, normal) };
+	if (cosArea < 0.0f)
+		return {};
+
+	const float lightIntensity       { 7.0f };
+	const float GlossMapValue        { material.gloss  * m_Shininess };
+	const ColorRGB specularMapValue  { material.specular };
+	const ColorRGB diffuseColor      { BRDF::Lambert(lightIntensity, material.diffuse) };
+
+	const bool viewIndependent{ terms != ShadingTerms::ViewDependent };
+	const bool viewDependent{ terms != ShadingTerms::ViewIndependent };
+	ColorRGB color{};
 	switch (m_LightMode)
 	{
 	case LightingMode::ObservedArea:
-		color = ColorRGB(cosArea, cosArea, cosArea) ;
+		if (viewIndependent)
+			color = ColorRGB(cosArea, cosArea, cosArea) ;
 		break;
 
 	case LightingMode::Diffuse:
-		color = diffuseColor* cosArea;
+		if (viewIndependent)
+			color = diffuseColor* cosArea;
 		break;
 
 	case LightingMode::Specular:
-		color =  BRDF::Phong(specularMapValue, GlossMapValue, lightDirection, -pxl.viewDirection, normalValue) * cosArea;
+		if (viewDependent)
+			color =  ShadeSpecular(specularMapValue, GlossMapValue, lightDirection, -viewDirection, normal) * cosArea;
 		break;
 
 	case LightingMode::Combined:
-		color = (diffuseColor + BRDF::Phong(specularMapValue, GlossMapValue, lightDirection, -pxl.viewDirection, normalValue)) * cosArea;
+		if (viewIndependent)
+			color += diffuseColor * cosArea;
+		if (viewDependent)
+			color += ShadeSpecular(specularMapValue, GlossMapValue, lightDirection, -viewDirection, normal) * cosArea;
+		break;
+
+	case LightingMode::PBR:
+		//Depends on the view all the way through its fresnel
+		if (viewDependent)
+			color = BRDF::CookTorrance(material.diffuse, GetMetalness(material), GetRoughness(material), -lightDirection, -viewDirection, normal) * (lightIntensity * cosArea);
 		break;
 
 	default:
 		break;
 	}
 
+	return color * radiance;
+}
+
+ColorRGB dae::Renderer::ShadeEnvironment(const MaterialSample& material, const Vector3& normal, const Vector3& viewDirection) const
+{
+	//Split sum, the specular integral is the prefiltered radiance times a table fetch for the BRDF part
+	const float metalness{ GetMetalness(material) };
+	const float roughness{ GetRoughness(material) };
+	const float dotNV{ std::max(Vector3::Dot(normal, -viewDirection), 0.0f) };
+	const Vector2 environmentBRDF{ m_SplitSumLut.Evaluate(dotNV, roughness) };
+
+	const ColorRGB dielectricF0{ 0.04f, 0.04f, 0.04f };
+	const ColorRGB f0{ dielectricF0 + (material.diffuse - dielectricF0) * metalness };
+	const ColorRGB specularWeight{ f0 * environmentBRDF.x + ColorRGB{ environmentBRDF.y, environmentBRDF.y, environmentBRDF.y } };
+	const ColorRGB specular{ m_Environment.EvaluateRadiance(Vector3::Reflect(viewDirection, normal), roughness) * specularWeight };
+
+	const ColorRGB one{ 1.0f, 1.0f, 1.0f };
+	const ColorRGB diffuse{ (one - specularWeight) * BRDF::Lambert(1.0f - metalness, material.diffuse) * m_Environment.EvaluateIrradiance(normal) };
+	return diffuse + specular;
+}
+
+float dae::Renderer::GetMetalness(const MaterialSample& material) const
+{
+	const float specular{ (material.specular.r + material.specular.g + material.specular.b) / 3.0f };
+	return Saturate((specular - 0.04f) / (1.0f - 0.04f));
+}
+
+float dae::Renderer::GetRoughness(const MaterialSample& material) const
+{
+	//Fully glossy would make the GGX lobe a single point
+	return std::max(1.0f - material.gloss, 0.05f);
+}
+
+ColorRGB dae::Renderer::ShadeLocalLights(const Vertex_Out& pxl, const MaterialSample& material, const Vector3& normal, const std::vector<int>& lightIndices, ShadingTerms terms) const
+{
+	//The range test drops the lights that do not reach the surface
+	ColorRGB color{};
+	for (const int lightIndex : lightIndices)
+	{
+		const Light& light{ m_Lights[lightIndex] };
+		Vector3 lightDirection{};
+		const float attenuation{ CalculateAttenuation(light, pxl.worldPosition, lightDirection) };
+		if (attenuation <= 0.0f)
+			continue;
+
+		color += ShadeLight(material, normal, pxl.viewDirection, lightDirection, light.color * (light.intensity * attenuation), terms);
+	}
 	return color;
 }
 
+ColorRGB dae::Renderer::ShadeSpecular(const ColorRGB& ks, float exp, const Vector3& l, const Vector3& v, const Vector3& n) const
+{
+	switch (m_SpecularModel)
+	{
+	case SpecularModel::PhongLut:
+		return BRDF::Phong(ks, exp, l, v, n, m_PhongLut);
+	case SpecularModel::BlinnPhongLut:
+		return BRDF::BlinnPhong(ks, 4.0f * exp, l, v, n, m_BlinnPhongLut);
+	default:
+		return BRDF::Phong(ks, exp, l, v, n);
+	}
+}
+
+MaterialSample dae::Renderer::SampleMaterial(const Vertex_Out& pxl) const
+{
+	//One interleaved fetch, or one fetch per map when the maps could not be interleaved
+	MaterialSample material{};
+	if (m_UseInterleavedMaterial && m_pMaterialVehicle)
+	{
+		switch (m_TextureFiltering)
+		{
+		case TextureFiltering::NearestMip:
+			material = m_pMaterialVehicle->SampleNearestMip(pxl.uv, m_pMaterialVehicle->CalculateLod(pxl.uvDdx, pxl.uvDdy));
+			break;
+		case TextureFiltering::Bilinear:
+			material = m_pMaterialVehicle->SampleTrilinear(pxl.uv, std::round(m_pMaterialVehicle->CalculateLod(pxl.uvDdx, pxl.uvDdy)));
+			break;
+		case TextureFiltering::Trilinear:
+			material = m_pMaterialVehicle->SampleTrilinear(pxl.uv, m_pMaterialVehicle->CalculateLod(pxl.uvDdx, pxl.uvDdy));
+			break;
+		default:
+			material = m_pMaterialVehicle->Sample(pxl.uv);
+			break;
+		}
+	}
+	else
+	{
+		material = { SampleColor(m_pTextureVehicle.Get(), pxl), SampleColor(m_pTextureSpecular.Get(), pxl), SampleFloat(m_pTextureGlossines.Get(), pxl) };
+		if (m_UseNormalMap && !UsesObjectSpaceNormals())
+			material.normal = SampleNormal(m_pTextureNormalMap.Get(), pxl);
+	}
+
+	//The baked map replaces the tangent space normal
+	if (UsesObjectSpaceNormals())
+		material.normal = NormalMapBaker::DecodeNormal(SampleColor(m_pTextureObjectNormalMap, pxl));
+	return material;
+}
+
+ColorRGB dae::Renderer::SampleColor(const Texture* pTexture, const Vertex_Out& pxl) const
+{
+	switch (m_TextureFiltering)
+	{
+	case TextureFiltering::NearestMip:
+		return pTexture->SampleNearestMip(pxl.uv, pTexture->CalculateLod(pxl.uvDdx, pxl.uvDdy));
+	case TextureFiltering::Bilinear:
+	{
+		ColorRGB color{};
+		pTexture->SampleBilinearBatch(&pxl.uv, &color, 1, pTexture->CalculateLod(pxl.uvDdx, pxl.uvDdy));
+		return color;
+	}
+	case TextureFiltering::Trilinear:
+		return pTexture->SampleTrilinear(pxl.uv, pTexture->CalculateLod(pxl.uvDdx, pxl.uvDdy));
+	default:
+		return pTexture->Sample(pxl.uv);
+	}
+}
+
+Vector3 dae::Renderer::SampleNormal(const Texture* pTexture, const Vertex_Out& pxl) const
+{
+	switch (m_TextureFiltering)
+	{
+	case TextureFiltering::NearestMip:
+		return pTexture->SampleNormalNearestMip(pxl.uv, pTexture->CalculateLod(pxl.uvDdx, pxl.uvDdy));
+	case TextureFiltering::Bilinear:
+		//A whole lod is a single bilinear level
+		return pTexture->SampleNormalTrilinear(pxl.uv, std::round(pTexture->CalculateLod(pxl.uvDdx, pxl.uvDdy)));
+	case TextureFiltering::Trilinear:
+		return pTexture->SampleNormalTrilinear(pxl.uv, pTexture->CalculateLod(pxl.uvDdx, pxl.uvDdy));
+	default:
+		return pTexture->SampleNormal(pxl.uv);
+	}
+}
+
+float dae::Renderer::SampleFloat(const Texture* pTexture, const Vertex_Out& pxl) const
+{
+	switch (m_TextureFiltering)
+	{
+	case TextureFiltering::NearestMip:
+		return pTexture->SampleFloatNearestMip(pxl.uv, pTexture->CalculateLod(pxl.uvDdx, pxl.uvDdy));
+	case TextureFiltering::Bilinear:
+		return pTexture->SampleFloatTrilinear(pxl.uv, std::round(pTexture->CalculateLod(pxl.uvDdx, pxl.uvDdy)));
+	case TextureFiltering::Trilinear:
+		return pTexture->SampleFloatTrilinear(pxl.uv, pTexture->CalculateLod(pxl.uvDdx, pxl.uvDdy));
+	default:
+		return pTexture->SampleFloat(pxl.uv);
+	}
+}
+
 void Renderer::VertectTransformToScreen(const std::vector<Vector3>& vertices_in, std::vector<Vector2>& vertices_out) const
 {
 	for (int i{}; i < vertices_in.size(); ++i)
@@ -4,6 +4,16 @@
 #include <vector>
 
 #include "Camera.h"
+#include "AssetManager.h"
+#include "PhongLut.h"
+#include "Light.h"
+#include "ShadowMap.h"
+#include "TextureSpaceCache.h"
+#include "SplitSumLut.h"
+#include "SphericalHarmonics.h"
+#include "MsaaResolve.h"
+#include "FrameTracker.h"
+#include "LightCulling.h"
 
 struct SDL_Window;
 struct SDL_Surface;
@@ -11,6 +21,8 @@ struct SDL_Surface;
 namespace dae
 {
 	class Texture;
+	class Material;
+	struct MaterialSample;
 	struct Mesh;
 	struct Vertex;
 	struct Vertex_Out;
@@ -34,9 +46,56 @@ namespace dae
 		bool SaveBufferToImage() const;
 		void ToggleRotation();
 		void SwitchLightMode();
+		void SwitchShadingFrequency();
 		void ToggleNormal();
+		void SwitchNormalMapSpace();
+		void SwitchDepthMode();
+		void ToggleMSAA();
+		void ToggleDynamicResolution();
+		void SwitchVariableRateShading();
+		void ToggleIncrementalRendering();
+		void SwitchTextureFiltering();
+		void SwitchSpecularModel();
+		void SwitchTextureLayout();
+		void BenchmarkTextureLayouts();
+		void ToggleInterleavedMaterial();
+		void ToggleCompressedTextures();
+		void InvalidateFrame();
+		bool IsFrameSkipped() const;
+
+		//World space lights, point and spot lights are assigned to screen tiles every frame
+		//Removing a light shifts the indices off the lights after it
+		int AddLight(const Light& light);
+		void RemoveLight(int index);
+		Light& GetLight(int index) { return m_Lights[index]; }
+		int GetLightCount() const { return int(m_Lights.size()); }
+		void SwitchLocalLightCount();
+		void ToggleShadows();
+		void ToggleTextureSpaceShading();
 
 	private:
+		//Screen space corners of the triangle being rasterized, inverseArea includes the triangleStrip winding
+		//The gradients are the screen space derivatives of uv/w and 1/w, only filled in when mipmapping
+		struct TriangleSetup
+		{
+			const Vertex_Out* pVertices[3]{};
+			Vector2 screen[3]{};
+			float inverseArea{};
+			Vector2 uvOverWDdx{};
+			Vector2 uvOverWDdy{};
+			float inverseWDdx{};
+			float inverseWDdy{};
+		};
+
+		//Shaded color shared by the pixels off one coarse shading cell
+		struct CoarseShade
+		{
+			uint32_t triangleId{};
+			int cellX{ -1 };
+			int rate{};
+			ColorRGB color{};
+		};
+
 		void VertectTransformToScreen(const std::vector<Vector3>& vertices_in, std::vector<Vector2>& vertices_out) const;
 		void VertectTransformToScreen(const std::vector<Vertex>& vertices_in, std::vector<Vector2>& vertices_out) const;
 		void VertectTransformToScreen(const std::vector<Vector4>& vertices_in, std::vector<Vector2>& vertices_out) const;
@@ -47,30 +106,112 @@ namespace dae
 		void ViewProjectionToNDC(const Mesh& world, std::vector<Vertex_Out>& NDC) ;
 
 		float Remap(float v, float min, float max) const;
+		bool IsOutsideFrustum(const Vector4& ndc) const;
 		
 
 		ColorRGB ShadePxl(const Vertex_Out& pxl)const;
+		ColorRGB ShadePxl(const Vertex_Out& pxl, const MaterialSample& material) const;
+		ColorRGB ShadeSpecular(const ColorRGB& ks, float exp, const Vector3& l, const Vector3& v, const Vector3& n) const;
+		//Which lighting terms to shade, the view independent ones can be cached in texture space
+		enum class ShadingTerms
+		{
+			All,
+			ViewIndependent,
+			ViewDependent
+		};
+		bool HasViewIndependentTerms() const { return m_LightMode != LightingMode::Specular && m_LightMode != LightingMode::PBR; }
+		bool HasViewDependentTerms() const { return m_LightMode == LightingMode::Specular || m_LightMode == LightingMode::Combined || m_LightMode == LightingMode::PBR; }
+
+		Vector3 CalculateShadingNormal(const Vertex_Out& pxl, const MaterialSample& material) const;
+		//useTileLights only fits pixels, the tile lists are culled against the visible depth inside the dirty rect
+		ColorRGB ShadeSurface(const Vertex_Out& pxl, const MaterialSample& material, const Vector3& normalValue, ShadingTerms terms = ShadingTerms::All, bool useTileLights = true) const;
+		ColorRGB SampleShadingCache(const Vertex_Out& pxl) const;
+		ColorRGB ShadeTexel(const Vertex& surface, const Vertex_Out& pxl) const;
+		void UpdateShadingCaches(bool shadowMapChanged);
+		ColorRGB ShadeVertex(const Vertex_Out& vertex) const;
+		void ShadeVertices(std::vector<Vertex_Out>& vertices) const;
+		ColorRGB ShadeLight(const MaterialSample& material, const Vector3& normal, const Vector3& viewDirection, const Vector3& lightDirection, const ColorRGB& radiance, ShadingTerms terms = ShadingTerms::All) const;
+		ColorRGB ShadeEnvironment(const MaterialSample& material, const Vector3& normal, const Vector3& viewDirection) const;
+		float GetMetalness(const MaterialSample& material) const;
+		float GetRoughness(const MaterialSample& material) const;
+		ColorRGB ShadeLocalLights(const Vertex_Out& pxl, const MaterialSample& material, const Vector3& normal, const std::vector<int>& lightIndices, ShadingTerms terms = ShadingTerms::All) const;
+		void ShadePxlBatch(const Vertex_Out* pPixels, const int* pPixelIndices, int count);
+		ColorRGB SampleColor(const Texture* pTexture, const Vertex_Out& pxl) const;
+		Vector3 SampleNormal(const Texture* pTexture, const Vertex_Out& pxl) const;
+		float SampleFloat(const Texture* pTexture, const Vertex_Out& pxl) const;
+		MaterialSample SampleMaterial(const Vertex_Out& pxl) const;
+
+		void CalculateWeights(const TriangleSetup& triangle, const Vector2& point, float& W0, float& W1, float& W2) const;
+		float InterpolateDepth(const TriangleSetup& triangle, float W0, float W1, float W2, bool reversedZ) const;
+		Vertex_Out InterpolateVertex(const TriangleSetup& triangle, float W0, float W1, float W2) const;
+		void CalculateUvGradients(TriangleSetup& triangle) const;
+
+		void UpdateDynamicResolution(float elapsedSec);
+		void SetRenderResolution(int width, int height);
+		bool IsRenderResolutionScaled() const;
+		void UpscaleToWindow() const;
+
+		void RenderLightDepthPrepass();
+
+		void UpdateShadingRateImage();
+		int CalculateTriangleShadingRate(const TriangleSetup& triangle, float screenArea) const;
+
+		void RasterizeMsaaPixel(int px, int py, const TriangleSetup& triangle, bool reversedZ);
+		void WriteMsaaFragment(int pxl, uint8_t coverage, uint32_t color);
+		void ResetMsaaBuffers(const ScreenRect& rect);
+		void ResolveMsaa(const ScreenRect& rect);
 
 		SDL_Window* m_pWindow{};
 
 		SDL_Surface* m_pFrontBuffer{ nullptr };
 		SDL_Surface* m_pBackBuffer{ nullptr };
+		SDL_Surface* m_pUpscaleBuffer{ nullptr };
 		uint32_t* m_pBackBufferPixels{};
 		float* m_pDepthBufferPixels{};
 
 		Camera m_Camera{};
-		Texture* m_pTexture{};
-		Texture* m_pTextureNormalMap{};
-		Texture* m_pTextureGlossines{};
-		Texture* m_pTextureVehicle{};
-		Texture* m_pTextureSpecular{};
+		TextureHandle m_pTexture{};
+		TextureHandle m_pTextureNormalMap{};
+		TextureHandle m_pTextureGlossines{};
+		TextureHandle m_pTextureVehicle{};
+		TextureHandle m_pTextureSpecular{};
+		//Vehicle maps as BC1/BC4/BC5, decoded per 4x4 block on fetch
+		//The texture layouts, the interleaved material and the gather sampler only work on the uncompressed maps
+		bool m_UseCompressedTextures{ true };
+		//Compressed maps keep their mips up to 128x128 resident, finer levels stream in on demand within the budget
+		const bool m_UseTextureStreaming{ true };
+		const size_t m_TextureStreamingBudget{ 2 * 1024 * 1024 };
+		//Vehicle maps interleaved per texel, nullptr when their resolutions differ
+		Material* m_pMaterialVehicle{};
+		bool m_UseInterleavedMaterial{ true };
+		void LoadVehicleTextures();
+		//Deletes the old material, only builds one from uncompressed maps
+		void CreateVehicleMaterial();
+		//Object space copy off the normal map, baked on an asset worker once the mesh is loaded
+		//Shading rotates it by the world matrix, so no tangent is interpolated and no frame is built per pixel
+		//Opt in, the bake is dropped when uv islands overlap, their shared texels can only hold one normal
+		enum class NormalMapSpace
+		{
+			Tangent,
+			Object
+		};
+		NormalMapSpace m_NormalMapSpace{ NormalMapSpace::Tangent };
+		Texture* m_pTextureObjectNormalMap{};
+		std::future<Texture*> m_ObjectNormalMapBake{};
+		Matrix m_ObjectToWorld{};
+		bool UsesObjectSpaceNormals() const { return m_UseNormalMap && m_NormalMapSpace == NormalMapSpace::Object && m_pTextureObjectNormalMap; }
 
 
+		//Render resolution, scaled down from the window size by the dynamic resolution
 		int m_Width{};
 		int m_Height{};
+		int m_WindowWidth{};
+		int m_WindowHeight{};
 		bool m_UseNormalMap{ true };
 		bool m_Rotating{ true };
 		float m_AngleOfModel{ 0.0f };
+		const float m_StandardFarPlane{ 100.0f };
+		const float m_ReversedFarPlane{ 10000.0f };
 
 		std::vector<Mesh> m_Meshes_world;
 
@@ -79,10 +220,155 @@ namespace dae
 			ObservedArea, //Lambert Cosine Law
 			Diffuse,      //Scattering of the light
 			Specular,     // Incident Radiance
-			Combined      //ObservedArea * Radiance * BRDF
+			Combined,     //ObservedArea * Radiance * BRDF
+			PBR           //Cook-Torrance with metalness/roughness, plus the environment through m_SplitSumLut
 		};
 		LightingMode m_LightMode{ LightingMode::ObservedArea };
 
+		//Where the lighting is evaluated, per vertex only interpolates the lit color over the triangle
+		enum class ShadingFrequency
+		{
+			PerPixel,
+			PerVertexTextured, //lit color times the diffuse texture per pixel
+			PerVertex
+		};
+		ShadingFrequency m_ShadingFrequency{ ShadingFrequency::PerPixel };
+
+		//Metalness and roughness come from the specular and gloss maps, specular above the dielectric f0 is taken as metal
+		const SplitSumLut m_SplitSumLut{ "Resources/SplitSumLut.bin" };
+
+		//Ambient and PBR environment light, projected once from the hdr, a sky and ground gradient when it is missing
+		SphericalHarmonics m_Environment{};
+		const ColorRGB m_SkyColor{ 0.35f, 0.4f, 0.5f };
+		const ColorRGB m_GroundColor{ 0.15f, 0.13f, 0.1f };
+
+		enum class SpecularModel
+		{
+			Phong,        //reflection and powf per pixel
+			PhongLut,     //reflection, power from m_PhongLut
+			BlinnPhongLut //half vector, power from m_BlinnPhongLut
+		};
+		SpecularModel m_SpecularModel{ SpecularModel::PhongLut };
+		const float m_Shininess{ 25.0f };
+		//pow(cosAlpha, gloss * shininess), Blinn-Phong needs 4 times the exponent for a similar highlight
+		const PhongLut m_PhongLut{ m_Shininess };
+		const PhongLut m_BlinnPhongLut{ 4.0f * m_Shininess, 512 };
+
+		enum class TextureFiltering
+		{
+			Point,      //nearest texel off the full resolution level
+			NearestMip, //nearest texel off the closest mip level
+			Bilinear,   //bilinear in the closest mip level, color maps filtered 8 pixels at a time
+			Trilinear   //bilinear in the two closest mip levels
+		};
+		TextureFiltering m_TextureFiltering{ TextureFiltering::Trilinear };
+		TextureLayout m_TextureLayout{ TextureLayout::Linear };
+		static constexpr int m_ShadingBatchSize{ 8 };
+
+		//4x MSAA, rotated grid sample pattern
+		static constexpr int m_MsaaSampleCount{ 4 };
+		static constexpr uint8_t m_MsaaFullCoverage{ 0b1111 };
+		static constexpr uint32_t m_MsaaNoEdge{ MsaaResolve::NoEdge };
+		const Vector2 m_MsaaSamplePositions[m_MsaaSampleCount]
+		{
+			{ 0.375f, 0.125f },
+			{ 0.875f, 0.375f },
+			{ 0.125f, 0.625f },
+			{ 0.625f, 0.875f }
+		};
+		bool m_UseMSAA{ false };
+		std::vector<uint32_t> m_MsaaColors{};
+		std::vector<uint32_t> m_MsaaEdgeIndices{};
+		std::vector<MsaaEdgePixel> m_MsaaEdges{};
+		std::vector<float> m_MsaaDepth{};
+
+		//Dynamic resolution
+		bool m_UseDynamicResolution{ false };
+		const float m_TargetFrameTime{ 1.0f / 60.0f };
+		const float m_MinResolutionScale{ 0.25f };
+		float m_ResolutionScale{ 1.0f };
+		float m_SmoothedFrameTime{ 1.0f / 60.0f };
+
+		//Variable rate shading, 1x1, 2x2 or 4x4 shading per 8x8 tile
+		enum class VariableRateShading
+		{
+			Off,
+			Quality,     //coarse shading only in nearly flat tiles
+			Performance  //coarse shading in low contrast tiles
+		};
+		VariableRateShading m_VrsMode{ VariableRateShading::Off };
+		static constexpr int m_ShadingRateTileSize{ 8 };
+		const float m_VrsQualityContrast{ 0.04f };
+		const float m_VrsPerformanceContrast{ 0.12f };
+		int m_ShadingRateTilesX{};
+		int m_ShadingRateImageWidth{};
+		int m_ShadingRateImageHeight{};
+		uint32_t m_TriangleId{};
+		std::vector<uint8_t> m_ShadingRates{};
+		//Frames a coarse tile has been drawn, at m_VrsRefreshInterval it is shaded at full rate and measured again
+		std::vector<uint8_t> m_ShadingRateAges{};
+		const int m_VrsRefreshInterval{ 8 };
+		std::vector<CoarseShade> m_CoarseShadeCache{};
+
+		//Forward+, point and spot lights are culled against the depth range off every 16x16 tile
+		//The depth prepass stores the view depth off the nearest surface per pixel
+		std::vector<Light> m_Lights{};
+		int m_LocalLightCount{};
+		bool m_HasLocalLights{ false };
+		std::vector<float> m_LightDepth{};
+		TileLightGrid m_LightGrid{ 16 };
+
+		//The first directional light casts shadows, its map is only rendered again when it or a mesh moved
+		bool m_UseShadows{ true };
+		ShadowMap m_ShadowMap{ 1024 };
+
+		//Texture space shading, the view independent lighting off every mesh is cached at the resolution off its diffuse map
+		//A cache goes stale when its mesh, the lights, the shadows or what the lighting reads changed, the camera keeps it
+		struct ShadingCacheState
+		{
+			LightingMode lightMode{};
+			bool useNormalMap{};
+			bool useObjectSpaceNormals{};
+			bool useInterleavedMaterial{};
+			bool useShadows{};
+
+			bool operator==(const ShadingCacheState& other) const = default;
+		};
+		bool m_UseTextureSpaceShading{ false };
+		std::vector<TextureSpaceCache> m_ShadingCaches{};
+		const TextureSpaceCache* m_pShadingCache{ nullptr }; //the cache off the mesh being rasterized
+		ShadingCacheState m_ShadingCacheState{};
+		std::vector<Light> m_ShadingCacheLights{};
+		std::vector<Matrix> m_ShadingCacheWorldMatrices{};
+
+		//Change tracking for incremental rendering, everything that affects every pixel lives in FrameState
+		struct FrameState
+		{
+			Matrix viewMatrix{};
+			Matrix projectionMatrix{};
+			DepthMode depthMode{};
+			LightingMode lightMode{};
+			SpecularModel specularModel{};
+			TextureFiltering textureFiltering{};
+			ShadingFrequency shadingFrequency{};
+			bool useTextureSpaceShading{};
+			bool useInterleavedMaterial{};
+			bool useCompressedTextures{};
+			bool useNormalMap{};
+			bool useObjectSpaceNormals{};
+			bool useMSAA{};
+			bool useShadows{};
+			VariableRateShading vrsMode{};
+			int width{};
+			int height{};
+
+			bool operator==(const FrameState& other) const = default;
+		};
+		bool m_UseIncrementalRendering{ true };
+		bool m_FrameSkipped{ false };
+		ScreenRect m_DirtyRect{};
+		FrameTracker<FrameState> m_FrameTracker{};
+
 		void IntroRender()const;
 		void Render_W1_1()const;
 		void Render_W1_2();
@@ -97,6 +383,9 @@ namespace dae
 
 		void Render_W4_1();
 
+		ScreenRect CalculateDirtyRect();
+		void ClearColorRect(const ScreenRect& rect, uint32_t color);
+
 		void ResetDepthBuffer();
 		void ResetColorBuffer();
 		bool IsInBoundingBox(const Vector2& pxlScr, size_t indc, const std::vector<Vector2>& vector2_Screen);
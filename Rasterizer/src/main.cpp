@@ -6,10 +6,15 @@
 
 //Standard includes
 #include <iostream>
+#include <chrono>
+#include <string>
+#include <vector>
 
 //Project includes
 #include "Timer.h"
 #include "Renderer.h"
+#include "MeshPack.h"
+#include "Utils.h"
 
 using namespace dae;
 
@@ -19,11 +24,39 @@ void ShutDown(SDL_Window* pWindow)
 	SDL_Quit();
 }
 
+//Parses and optimizes every OBJ into one binary mesh pack, in the order given
+int ConvertToMeshPack(const std::string& packPath, const std::vector<std::string>& objPaths)
+{
+	std::vector<Mesh> meshes(objPaths.size());
+	for (size_t i{}; i < objPaths.size(); ++i)
+	{
+		ObjParser::Statistics statistics{};
+		if (!ObjParser::Parse(objPaths[i], meshes[i].vertices, meshes[i].indices, true, &statistics))
+		{
+			std::cout << "Unable to parse " << objPaths[i] << std::endl;
+			return 1;
+		}
+		meshes[i].primitiveTopology = PrimitiveTopology::TriangleList;
+		Utils::CalculateBounds(meshes[i].vertices, meshes[i].minBounds, meshes[i].maxBounds);
+		MeshOptimizer::Report report{};
+		MeshOptimizer::Optimize(meshes[i], &report);
+		std::cout << objPaths[i] << ": parsed at " << statistics.GetMegabytesPerSecond() << " MB/s, " << report.vertexCountBefore << " -> " << report.vertexCountAfter
+			<< " vertices, ACMR " << report.acmrBefore << " -> " << report.acmrAfter << ", overdraw " << report.overdrawBefore << " -> " << report.overdrawAfter << std::endl;
+	}
+
+	if (!MeshPack::Write(packPath, meshes))
+		return 1;
+	std::cout << "Wrote " << meshes.size() << " meshes to " << packPath << std::endl;
+	return 0;
+}
+
 int main(int argc, char* args[])
 {
-	//Unreferenced parameters
-	(void)argc;
-	(void)args;
+	//Rasterizer --pack output.pack input.obj..., converts without opening a window
+	if (argc >= 4 && std::string{ args[1] } == "--pack")
+		return ConvertToMeshPack(args[2], std::vector<std::string>(args + 3, args + argc));
+
+	const auto startTime{ std::chrono::high_resolution_clock::now() };
 
 	//Create window + surfaces
 	SDL_Init(SDL_INIT_VIDEO);
@@ -52,6 +85,7 @@ int main(int argc, char* args[])
 
 	float printTimer = 0.f;
 	bool isLooping = true;
+	bool isFirstFrame = true;
 	bool takeScreenshot = false;
 	while (isLooping)
 	{
@@ -64,6 +98,10 @@ int main(int argc, char* args[])
 			case SDL_QUIT:
 				isLooping = false;
 				break;
+			case SDL_WINDOWEVENT:
+				if (e.window.event == SDL_WINDOWEVENT_EXPOSED)
+					pRenderer->InvalidateFrame();
+				break;
 			case SDL_KEYUP:
 				if (e.key.keysym.scancode == SDL_SCANCODE_X)
 					takeScreenshot = true;
@@ -73,6 +111,40 @@ int main(int argc, char* args[])
 					pRenderer->SwitchLightMode();
 				if (e.key.keysym.scancode == SDL_SCANCODE_F6)
 					pRenderer->ToggleNormal();
+				if (e.key.keysym.scancode == SDL_SCANCODE_F8)
+					pRenderer->SwitchDepthMode();
+				if (e.key.keysym.scancode == SDL_SCANCODE_F9)
+					pRenderer->ToggleMSAA();
+				if (e.key.keysym.scancode == SDL_SCANCODE_F10)
+					pRenderer->ToggleDynamicResolution();
+				if (e.key.keysym.scancode == SDL_SCANCODE_F11)
+					pRenderer->SwitchVariableRateShading();
+				if (e.key.keysym.scancode == SDL_SCANCODE_I)
+					pRenderer->ToggleIncrementalRendering();
+				if (e.key.keysym.scancode == SDL_SCANCODE_F)
+					pRenderer->SwitchTextureFiltering();
+				if (e.key.keysym.scancode == SDL_SCANCODE_L)
+					pRenderer->SwitchTextureLayout();
+				if (e.key.keysym.scancode == SDL_SCANCODE_B)
+					pRenderer->BenchmarkTextureLayouts();
+				if (e.key.keysym.scancode == SDL_SCANCODE_M)
+					pRenderer->ToggleInterleavedMaterial();
+				if (e.key.keysym.scancode == SDL_SCANCODE_C)
+					pRenderer->ToggleCompressedTextures();
+				if (e.key.keysym.scancode == SDL_SCANCODE_R)
+					AssetManager::GetInstance().PrintMemoryReport();
+				if (e.key.keysym.scancode == SDL_SCANCODE_P)
+					pRenderer->SwitchSpecularModel();
+				if (e.key.keysym.scancode == SDL_SCANCODE_O)
+					pRenderer->SwitchLocalLightCount();
+				if (e.key.keysym.scancode == SDL_SCANCODE_H)
+					pRenderer->ToggleShadows();
+				if (e.key.keysym.scancode == SDL_SCANCODE_J)
+					pRenderer->SwitchNormalMapSpace();
+				if (e.key.keysym.scancode == SDL_SCANCODE_V)
+					pRenderer->SwitchShadingFrequency();
+				if (e.key.keysym.scancode == SDL_SCANCODE_T)
+					pRenderer->ToggleTextureSpaceShading();
 				break;
 			}
 		}
@@ -82,6 +154,16 @@ int main(int argc, char* args[])
 
 		//--------- Render ---------
 		pRenderer->Render();
+		if (isFirstFrame)
+		{
+			isFirstFrame = false;
+			const std::chrono::duration<float, std::milli> timeToFirstFrame{ std::chrono::high_resolution_clock::now() - startTime };
+			std::cout << "Time to first frame: " << timeToFirstFrame.count() << " ms" << std::endl;
+		}
+
+		//Nothing changed, sleep until the next input event instead of spinning
+		if (pRenderer->IsFrameSkipped())
+			SDL_WaitEventTimeout(nullptr, 100);
 
 		//--------- Timer ---------
 		pTimer->Update();
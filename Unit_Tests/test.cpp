@@ -1,12 +1,960 @@
 #include "gtest/gtest.h"
 #include "Maths.h"
+#include "BlockCompression.h"
+#include "PhongLut.h"
+#include "ShadowMap.h"
+#include "SplitSumLut.h"
+#include "SphericalHarmonics.h"
+#include "NormalMapBaker.h"
+#include "ObjParser.h"
+#include "MeshPack.h"
+#include "MeshOptimizer.h"
+#include "MsaaResolve.h"
+#include "Upscaler.h"
+#include "FrameTracker.h"
+#include "LightCulling.h"
+#include <algorithm>
+#include <array>
+#include <random>
+#include <filesystem>
+#include "TextureSpaceCache.h"
+#include "Texture.h"
+#include "Material.h"
+#include "AssetManager.h"
+#include "ThreadPool.h"
+#include "TextureStreamer.h"
+#include <cstdio>
+#include <fstream>
+#include <thread>
+#include <chrono>
+#include <atomic>
+#include <stdexcept>
+#include <functional>
 
 
 namespace dae
 {
+	namespace
+	{
+		//24 bit bmp for the tests that load through SDL_image, getTexel returns r in the lowest byte
+		void WriteBmp(const std::string& path, int width, int height, const std::function<uint32_t(int, int)>& getTexel)
+		{
+			const int rowSize{ (width * 3 + 3) & ~3 };
+			const uint32_t fileSize{ uint32_t(54 + rowSize * height) };
+			uint8_t header[54]{ 'B', 'M' };
+			const auto writeInt = [&header](int offset, uint32_t value) { for (int i{}; i < 4; ++i) header[offset + i] = uint8_t(value >> (i * 8)); };
+			writeInt(2, fileSize);
+			writeInt(10, 54);
+			writeInt(14, 40);
+			writeInt(18, uint32_t(width));
+			writeInt(22, uint32_t(height));
+			header[26] = 1;
+			header[28] = 24;
+			writeInt(34, uint32_t(rowSize * height));
+
+			std::ofstream file{ path, std::ios::binary };
+			file.write(reinterpret_cast<const char*>(header), sizeof(header));
+			std::vector<uint8_t> row(rowSize);
+			for (int y{ height - 1 }; y >= 0; --y)
+			{
+				for (int x{}; x < width; ++x)
+				{
+					const uint32_t texel{ getTexel(x, y) };
+					row[x * 3]     = uint8_t(texel >> 16);
+					row[x * 3 + 1] = uint8_t(texel >> 8);
+					row[x * 3 + 2] = uint8_t(texel);
+				}
+				file.write(reinterpret_cast<const char*>(row.data()), rowSize);
+			}
+		}
+	}
+
 	TEST(TestCaseName, TestName) {
 		EXPECT_EQ(Vector3::Cross(Vector3::UnitX, Vector3::UnitY), Vector3::UnitZ);
 		EXPECT_TRUE(true);
 	}
 
+	TEST(Matrix, ReversedPerspectiveMapsNearToOneAndFarToZero) {
+		const Matrix projection{ Matrix::CreateReversedPerspectiveFovLH(1.f, 1.f, 0.1f, 1000.f) };
+		const Vector4 nearPoint{ projection.TransformPoint(Vector4{ 0.f, 0.f, 0.1f, 1.f }) };
+		const Vector4 farPoint{ projection.TransformPoint(Vector4{ 0.f, 0.f, 1000.f, 1.f }) };
+		EXPECT_NEAR(nearPoint.z / nearPoint.w, 1.f, 1e-5f);
+		EXPECT_NEAR(farPoint.z / farPoint.w, 0.f, 1e-5f);
+
+		const Matrix infinite{ Matrix::CreateInfiniteReversedPerspectiveFovLH(1.f, 1.f, 0.1f) };
+		const Vector4 distantPoint{ infinite.TransformPoint(Vector4{ 0.f, 0.f, 1e6f, 1.f }) };
+		EXPECT_GT(distantPoint.z / distantPoint.w, 0.f);
+		EXPECT_LT(distantPoint.z / distantPoint.w, 1e-6f);
+	}
+
+	TEST(MathHelpers, MortonEncodeInterleavesBits) {
+		EXPECT_EQ(MortonEncode(0, 0), 0u);
+		EXPECT_EQ(MortonEncode(1, 0), 1u);
+		EXPECT_EQ(MortonEncode(0, 1), 2u);
+		EXPECT_EQ(MortonEncode(3, 3), 15u);
+		EXPECT_EQ(MortonEncode(0xFFFF, 0), 0x55555555u);
+		EXPECT_EQ(MortonEncode(5, 9), 0b10010011u);
+	}
+
+	TEST(MsaaResolve, MatchesScalarSampleAverage) {
+		std::mt19937 random{ 27 };
+		std::vector<MsaaEdgePixel> edges(8);
+		for (MsaaEdgePixel& edge : edges)
+			for (uint32_t& sample : edge.samples)
+				sample = random();
+		edges[0] = MsaaEdgePixel{ { 0xFFFFFFFF, 0xFFFFFFFF, 0xFFFFFFFF, 0xFFFFFFFF } };
+		edges[1] = MsaaEdgePixel{ { 0x01010101, 0x01010101, 0, 0 } };
+
+		//Rows with 4 pixel groups without edges, groups with some edges and a tail
+		const int count{ 13 };
+		std::vector<uint32_t> colors(count), edgeIndices(count, MsaaResolve::NoEdge);
+		for (uint32_t& color : colors)
+			color = random();
+		for (const int pxl : { 4, 6, 9, 12 })
+			edgeIndices[pxl] = uint32_t(pxl % edges.size());
+
+		std::vector<uint32_t> resolved(count);
+		MsaaResolve::ResolveRow(colors.data(), edgeIndices.data(), edges.data(), resolved.data(), count);
+		for (int pxl{}; pxl < count; ++pxl)
+		{
+			if (edgeIndices[pxl] == MsaaResolve::NoEdge)
+			{
+				EXPECT_EQ(resolved[pxl], colors[pxl]);
+				continue;
+			}
+
+			//Round half up, as (sum + 2) / 4 per channel
+			uint32_t expected{};
+			for (int channel{}; channel < 4; ++channel)
+			{
+				uint32_t sum{};
+				for (const uint32_t sample : edges[edgeIndices[pxl]].samples)
+					sum += (sample >> (channel * 8)) & 0xFF;
+				expected |= ((sum + 2) / 4) << (channel * 8);
+			}
+			EXPECT_EQ(resolved[pxl], expected);
+		}
+		EXPECT_EQ(MsaaResolve::ResolveEdgePixel(edges[0]), 0xFFFFFFFFu);
+		EXPECT_EQ(MsaaResolve::ResolveEdgePixel(edges[1]), 0x01010101u);
+	}
+
+	TEST(Upscaler, BilinearKeepsEdgesAndBlendsCenters) {
+		//Same size is a plain copy
+		const std::vector<uint32_t> source{ 0x00000000, 0x00C80064, 0xFF102030, 0x80FF00FF };
+		std::vector<uint32_t> copy(4);
+		Upscaler::UpscaleBilinear(source.data(), 2, 2, copy.data(), 2, 2, 2);
+		EXPECT_EQ(copy, source);
+
+		//2x2 to 4x4: the outer centers clamp onto the source pixels, the inner ones are 1/4 and 3/4 between them
+		const int stride{ 5 };
+		std::vector<uint32_t> upscaled(stride * 4, 0xDEADBEEF);
+		Upscaler::UpscaleBilinear(source.data(), 2, 2, upscaled.data(), 4, 4, stride);
+		EXPECT_EQ(upscaled[0], source[0]);
+		EXPECT_EQ(upscaled[3], source[1]);
+		EXPECT_EQ(upscaled[3 * stride], source[2]);
+		EXPECT_EQ(upscaled[3 + 3 * stride], source[3]);
+		EXPECT_EQ(upscaled[1], 0x00320019u);
+		EXPECT_EQ(upscaled[2], 0x0096004Bu);
+		for (int y{}; y < 4; ++y)
+			EXPECT_EQ(upscaled[4 + y * stride], 0xDEADBEEFu);
+
+		//The center 4 blend all source pixels, every channel within rounding off the float bilinear filter
+		for (const int pxl : { 1 + stride, 2 + stride, 1 + 2 * stride, 2 + 2 * stride })
+		{
+			const float u{ (pxl % stride == 1) ? 0.25f : 0.75f };
+			const float v{ (pxl / stride == 1) ? 0.25f : 0.75f };
+			for (int channel{}; channel < 4; ++channel)
+			{
+				const auto get = [channel](uint32_t color) { return float((color >> (channel * 8)) & 0xFF); };
+				const float expected{ (get(source[0]) * (1 - u) + get(source[1]) * u) * (1 - v) + (get(source[2]) * (1 - u) + get(source[3]) * u) * v };
+				EXPECT_NEAR(get(upscaled[pxl]), expected, 2.f);
+			}
+		}
+	}
+
+	TEST(FrameTracker, DirtiesMovedMeshesAndRedrawsChangedStates) {
+		//Same shape as the Renderer's frame state, defaulted operator== over every setting
+		struct FrameState
+		{
+			Matrix viewMatrix{};
+			int lightMode{};
+			bool useShadows{};
+			int width{};
+
+			bool operator==(const FrameState& other) const = default;
+		};
+		const int width{ 640 }, height{ 480 };
+		const Matrix projection{ Matrix::CreatePerspectiveFovLH(1.f, float(width) / height, 0.1f, 100.f) };
+		const FrameState state{ Matrix::CreateTranslation(0.f, 0.f, 0.f), 0, false, width };
+		EXPECT_EQ(state, (FrameState{ Matrix::CreateTranslation(0.f, 0.f, 0.f), 0, false, width }));
+		EXPECT_NE(state, (FrameState{ Matrix::CreateTranslation(0.f, 0.f, 1.f), 0, false, width }));
+		EXPECT_NE(state, (FrameState{ Matrix::CreateTranslation(0.f, 0.f, 0.f), 1, false, width }));
+		EXPECT_NE(state, (FrameState{ Matrix::CreateTranslation(0.f, 0.f, 0.f), 0, true, width }));
+
+		//Two small boxes left and right in front off the camera
+		std::vector<Mesh> meshes(2);
+		for (Mesh& mesh : meshes)
+		{
+			mesh.minBounds = { -0.5f, -0.5f, -0.5f };
+			mesh.maxBounds = { 0.5f, 0.5f, 0.5f };
+		}
+		meshes[0].worldMatrix = Matrix::CreateTranslation(-2.f, 0.f, 10.f);
+		meshes[1].worldMatrix = Matrix::CreateTranslation(2.f, 0.f, 10.f);
+		std::vector<Light> lights{ Light{ LightType::Directional, {}, { 0.f, -1.f, 0.f } } };
+
+		FrameTracker<FrameState> tracker{};
+		const ScreenRect fullRect{ 0, 0, width, height };
+		const auto update = [&](const FrameState& frameState, bool forceFullFrame = false, bool movesAffectAllMeshes = false)
+			{
+				return tracker.Update(frameState, lights, meshes, projection, 0.1f, width, height, forceFullFrame, movesAffectAllMeshes);
+			};
+		EXPECT_EQ(update(state), fullRect);
+		EXPECT_TRUE(update(state).IsEmpty());
+
+		//A moved mesh dirties where it was and where it is, the other mesh stays out
+		const ScreenRect before{ CalculateScreenRect(meshes[0], meshes[0].worldMatrix * projection, 0.1f, width, height) };
+		meshes[0].worldMatrix = Matrix::CreateTranslation(-2.f, 1.f, 10.f);
+		const ScreenRect after{ CalculateScreenRect(meshes[0], meshes[0].worldMatrix * projection, 0.1f, width, height) };
+		const ScreenRect other{ CalculateScreenRect(meshes[1], meshes[1].worldMatrix * projection, 0.1f, width, height) };
+		ASSERT_FALSE(before.IsEmpty());
+		EXPECT_LT(before.right, width / 2);
+		EXPECT_GT(other.left, width / 2);
+		EXPECT_EQ(update(state), before.Union(after));
+		EXPECT_TRUE(update(state).IsEmpty());
+
+		//Shadows widen the rect over every mesh
+		meshes[0].worldMatrix = Matrix::CreateTranslation(-2.f, 0.f, 10.f);
+		EXPECT_EQ(update(state, false, true), after.Union(before).Union(other));
+		EXPECT_TRUE(update(state, false, true).IsEmpty());
+
+		//Any state, light or mesh count change, a forced or a requested frame redraws everything
+		EXPECT_EQ(update(FrameState{ Matrix::CreateTranslation(0.f, 0.f, 0.f), 1, false, width }), fullRect);
+		EXPECT_EQ(update(state), fullRect);
+		lights[0].intensity *= 2.f;
+		EXPECT_EQ(update(state), fullRect);
+		meshes.pop_back();
+		EXPECT_EQ(update(state), fullRect);
+		EXPECT_EQ(update(state, true), fullRect);
+		tracker.RequestFullFrame();
+		EXPECT_EQ(update(state), fullRect);
+		EXPECT_TRUE(update(state).IsEmpty());
+
+		//A box behind the camera has no projection, so it dirties everything
+		meshes[0].worldMatrix = Matrix::CreateTranslation(0.f, 0.f, -10.f);
+		EXPECT_EQ(update(state), fullRect);
+	}
+
+	TEST(LightCulling, CullsLightsOutsideTheTileFrustum) {
+		//64x64 screen with a 90 degree fov, the 16 pixel tile in the middle spans x and y in [-z / 4, z / 4] and depths 9 to 11
+		const Matrix projection{ Matrix::CreatePerspectiveFovLH(1.f, 1.f, 0.1f, 100.f) };
+		const TileFrustum center{ LightCulling::CreateTileFrustum(projection, 24, 24, 40, 40, 64, 64, 9.f, 11.f) };
+		const auto createLight = [](const Vector3& position, float range)
+			{
+				Light light{};
+				light.position = position;
+				light.range    = range;
+				return light;
+			};
+
+		EXPECT_TRUE(LightCulling::IntersectsTile(createLight({ 0.f, 0.f, 10.f }, 1.f), center));
+		EXPECT_TRUE(LightCulling::IntersectsTile(createLight({ 3.f, 0.f, 10.f }, 1.f), center));
+		EXPECT_FALSE(LightCulling::IntersectsTile(createLight({ 5.f, 0.f, 10.f }, 1.f), center));
+		EXPECT_FALSE(LightCulling::IntersectsTile(createLight({ 0.f, -5.f, 10.f }, 1.f), center));
+
+		//Inside the side planes, but in front off or behind the visible surfaces
+		EXPECT_FALSE(LightCulling::IntersectsTile(createLight({ 0.f, 0.f, 14.f }, 2.f), center));
+		EXPECT_FALSE(LightCulling::IntersectsTile(createLight({ 0.f, 0.f, 5.f }, 2.f), center));
+		EXPECT_TRUE(LightCulling::IntersectsTile(createLight({ 0.f, 0.f, 12.5f }, 2.f), center));
+
+		//A tile without surfaces gets no lights
+		const TileFrustum empty{ LightCulling::CreateTileFrustum(projection, 24, 24, 40, 40, 64, 64, std::numeric_limits<float>::max(), 0.f) };
+		EXPECT_FALSE(LightCulling::IntersectsTile(createLight({ 0.f, 0.f, 10.f }, 1.f), empty));
+
+		//The top left tile lies at negative x and positive y
+		const TileFrustum topLeft{ LightCulling::CreateTileFrustum(projection, 0, 0, 16, 16, 64, 64, 9.f, 11.f) };
+		EXPECT_TRUE(LightCulling::IntersectsTile(createLight({ -7.f, 7.f, 10.f }, 0.5f), topLeft));
+		EXPECT_FALSE(LightCulling::IntersectsTile(createLight({ 7.f, 7.f, 10.f }, 0.5f), topLeft));
+		EXPECT_FALSE(LightCulling::IntersectsTile(createLight({ -7.f, -7.f, 10.f }, 0.5f), topLeft));
+
+		//A spot light in front off the tile only reaches it when it faces it
+		Light spot{ createLight({ 0.f, 0.f, 3.f }, 7.f) };
+		spot.type      = LightType::Spot;
+		spot.direction = { 0.f, 0.f, 1.f };
+		EXPECT_TRUE(LightCulling::IntersectsTile(spot, center));
+		spot.direction = { 0.f, 0.f, -1.f };
+		EXPECT_FALSE(LightCulling::IntersectsTile(spot, center));
+		spot.direction = { 1.f, 0.f, 0.f };
+		EXPECT_FALSE(LightCulling::IntersectsTile(spot, center));
+	}
+
+	TEST(TileLightGrid, VerticesNearATileEdgeGetEveryLocalLight) {
+		//64x64 screen with 16 pixel tiles, the surface in the columns 32 to 48 is at depth 10, the rest off the screen at 20
+		const int size{ 64 };
+		const Matrix view{ Matrix::CreateTranslation(0.f, 0.f, 0.f) };
+		const Matrix projection{ Matrix::CreatePerspectiveFovLH(1.f, 1.f, 0.1f, 100.f) };
+		std::vector<float> depth(size * size, 20.f);
+		for (int py{}; py < size; ++py)
+			std::fill_n(depth.begin() + (32 + py * size), 16, 10.f);
+
+		//A light just right off the tile edge at x = 0, a light behind everything and a directional light
+		std::vector<Light> lights(3);
+		lights[0].type     = LightType::Directional;
+		lights[1].position = { 0.5f, 0.f, 10.f };
+		lights[1].range    = 1.f;
+		lights[2].position = { 0.f, 0.f, 50.f };
+		lights[2].range    = 1.f;
+
+		TileLightGrid grid{ 16 };
+		grid.Cull(lights, view, projection, 0.1f, depth.data(), size, size, { 0, 0, size, size });
+		EXPECT_EQ(grid.GetDirectionalLights(), std::vector<int>{ 0 });
+		EXPECT_EQ(grid.GetPixelLights(40.f, 32.f), std::vector<int>{ 1 });
+
+		//The vertex projects to pixel 31, into a tile whose visible surface is too far away for the light
+		const Vector3 vertexPosition{ -0.3f, 0.f, 10.f };
+		const Vector3 vertexNormal{ 1.f, 0.f, 0.f };
+		const Vector4 clip{ projection.TransformPoint(Vector4{ vertexPosition.x, vertexPosition.y, vertexPosition.z, 1.f }) };
+		const float vertexX{ (clip.x / clip.w + 1.f) * 0.5f * size };
+		ASSERT_EQ(int(vertexX) / 16, 1);
+		EXPECT_TRUE(grid.GetPixelLights(vertexX, 32.f).empty());
+
+		//Lit by the vertex list exactly like by every local light
+		const auto shadeVertex = [&](const std::vector<int>& lightIndices)
+			{
+				float irradiance{};
+				for (const int lightIndex : lightIndices)
+				{
+					Vector3 lightDirection{};
+					const float attenuation{ CalculateAttenuation(lights[lightIndex], vertexPosition, lightDirection) };
+					irradiance += attenuation * std::max(Vector3::Dot(-lightDirection, vertexNormal), 0.f);
+				}
+				return irradiance;
+			};
+		EXPECT_EQ(grid.GetVertexLights(), (std::vector<int>{ 1, 2 }));
+		EXPECT_GT(shadeVertex(grid.GetVertexLights()), 0.f);
+		EXPECT_EQ(shadeVertex(grid.GetVertexLights()), shadeVertex({ 1, 2 }));
+		EXPECT_EQ(shadeVertex(grid.GetPixelLights(vertexX, 32.f)), 0.f);
+	}
+
+	TEST(BlockCompression, BC1RoundTripsTwoColorBlock) {
+		const uint32_t red{ 0xFF0000FF }, blue{ 0xFFFF0000 };
+		uint32_t texels[16]{};
+		for (int i{}; i < 16; ++i)
+			texels[i] = (i % 3 == 0) ? red : blue;
+
+		uint32_t decoded[16]{};
+		BlockCompression::DecodeBC1(BlockCompression::EncodeBC1(texels), decoded);
+		for (int i{}; i < 16; ++i)
+			EXPECT_EQ(decoded[i], texels[i]);
+	}
+
+	TEST(BlockCompression, BC4StaysWithinPaletteStep) {
+		uint8_t values[16]{};
+		for (int i{}; i < 16; ++i)
+			values[i] = uint8_t(40 + i * 9);
+
+		uint8_t decoded[16]{};
+		BlockCompression::DecodeBC4(BlockCompression::EncodeBC4(values), decoded);
+		EXPECT_EQ(decoded[0], values[0]);
+		EXPECT_EQ(decoded[15], values[15]);
+		for (int i{}; i < 16; ++i)
+			EXPECT_LE(std::abs(int(decoded[i]) - int(values[i])), (135 + 13) / 14);
+	}
+
+	TEST(PhongLut, StaysWithinMeasuredError) {
+		const PhongLut lut{ 25.f };
+		EXPECT_LT(lut.GetMaxError(), 0.005f);
+		for (int i{}; i < 1000; ++i)
+		{
+			const float cosAlpha{ (i % 97 + 1) / 97.f };
+			const float exponent{ (i % 101) / 100.f * 25.f };
+			EXPECT_NEAR(lut.Evaluate(cosAlpha, exponent), std::pow(cosAlpha, exponent), lut.GetMaxError() + 1e-6f);
+		}
+		EXPECT_EQ(lut.Evaluate(-0.5f, 10.f), 0.f);
+	}
+
+	TEST(ShadowMap, OccluderShadowsGroundBelowIt) {
+		//Ground quad with a smaller quad floating above its center, lit from straight above
+		auto createQuad = [](float halfSize, float height)
+			{
+				Mesh quad{};
+				quad.primitiveTopology = PrimitiveTopology::TriangleList;
+				quad.vertices = { { { -halfSize, height, -halfSize } }, { { halfSize, height, -halfSize } },
+								  { { halfSize, height, halfSize } }, { { -halfSize, height, halfSize } } };
+				quad.indices = { 0, 1, 2, 0, 2, 3 };
+				return quad;
+			};
+		const std::vector<Mesh> meshes{ createQuad(10.f, 0.f), createQuad(2.f, 2.f) };
+
+		ShadowMap shadowMap{ 256 };
+		EXPECT_TRUE(shadowMap.Update({ 0.f, -1.f, 0.f }, meshes));
+		EXPECT_FALSE(shadowMap.Update({ 0.f, -1.f, 0.f }, meshes));
+		EXPECT_EQ(shadowMap.GetRenderCount(), 1);
+
+		const Vector3 up{ 0.f, 1.f, 0.f };
+		EXPECT_EQ(shadowMap.SampleVisibility({ 0.f, 0.f, 0.f }, up), 0.f);
+		EXPECT_EQ(shadowMap.SampleVisibility({ 6.f, 0.f, -6.f }, up), 1.f);
+		EXPECT_EQ(shadowMap.SampleVisibility({ 1.f, 2.f, 1.f }, up), 1.f);
+	}
+
+	TEST(SplitSumLut, IntegratesOnceAndLoadsFromCache) {
+		const std::string cachePath{ "SplitSumLut_test.bin" };
+		std::remove(cachePath.c_str());
+		const SplitSumLut integrated{ cachePath, 16, 128 };
+		const SplitSumLut cached{ cachePath, 16, 128 };
+		EXPECT_FALSE(integrated.IsLoadedFromCache());
+		EXPECT_TRUE(cached.IsLoadedFromCache());
+
+		//A mirror seen head on reflects exactly f0
+		EXPECT_NEAR(integrated.Evaluate(1.f, 0.f).x, 1.f, 0.01f);
+		EXPECT_NEAR(integrated.Evaluate(1.f, 0.f).y, 0.f, 0.01f);
+		for (int i{}; i < 100; ++i)
+		{
+			const Vector2 value{ integrated.Evaluate((i % 10) / 9.f, (i / 10) / 9.f) };
+			EXPECT_EQ(value, cached.Evaluate((i % 10) / 9.f, (i / 10) / 9.f));
+			EXPECT_LE(value.x + value.y, 1.01f);
+		}
+		std::remove(cachePath.c_str());
+	}
+
+	TEST(SphericalHarmonics, GradientIrradianceMatchesCosineConvolution) {
+		//Radiance 0.5 + 0.5 y, its irradiance is PI * (0.5 + y / 3) for every normal
+		const int width{ 64 }, height{ 32 };
+		std::vector<ColorRGB> radiance(width * height);
+		for (int y{}; y < height; ++y)
+			for (int x{}; x < width; ++x)
+				radiance[y * width + x] = ColorRGB{ 0.5f, 0.5f, 0.5f } * (1.f + std::cos(PI * (y + 0.5f) / height));
+
+		SphericalHarmonics environment{};
+		environment.ProjectEquirectangular(radiance, width, height);
+		for (const Vector3& normal : { Vector3{ 0.f, 1.f, 0.f }, Vector3{ 0.f, -1.f, 0.f }, Vector3{ 0.6f, 0.f, 0.8f } })
+		{
+			EXPECT_NEAR(environment.EvaluateIrradiance(normal).g, PI * (0.5f + normal.y / 3.f), 0.01f);
+			EXPECT_NEAR(environment.EvaluateRadiance(normal, 0.f).g, 0.5f + 0.5f * normal.y, 0.01f);
+		}
+		EXPECT_FALSE(environment.LoadFromHdr("missing.hdr"));
+	}
+
+	TEST(Texture, DecodesEveryFormatOnce) {
+		//4x2 texels with r in the lowest byte, every channel different
+		const int width{ 4 }, height{ 2 };
+		std::vector<uint32_t> texels(width * height);
+		for (int i{}; i < width * height; ++i)
+			texels[i] = uint32_t(i * 30) | uint32_t(255 - i * 20) << 8 | uint32_t(i * 7 + 3) << 16 | 0xFF000000u;
+		const auto getChannel = [](uint32_t texel, int channel) { return ((texel >> (channel * 8)) & 0xFF) / 255.f; };
+		const auto getCenter = [=](int i) { return Vector2{ (i % width + 0.5f) / width, (i / width + 0.5f) / height }; };
+
+		Texture* pColor{ Texture::CreateFromPixels(width, height, texels.data(), TextureFormat::RGBA8) };
+		Texture* pSingle{ Texture::CreateFromPixels(width, height, texels.data(), TextureFormat::R8) };
+		Texture* pNormal{ Texture::CreateFromPixels(width, height, texels.data(), TextureFormat::Normal) };
+		for (int i{}; i < width * height; ++i)
+		{
+			const ColorRGB color{ pColor->Sample(getCenter(i)) };
+			EXPECT_FLOAT_EQ(color.r, getChannel(texels[i], 0));
+			EXPECT_FLOAT_EQ(color.g, getChannel(texels[i], 1));
+			EXPECT_FLOAT_EQ(color.b, getChannel(texels[i], 2));
+
+			//The single channel format keeps r
+			EXPECT_FLOAT_EQ(pSingle->SampleFloat(getCenter(i)), getChannel(texels[i], 0));
+
+			//Normals are expanded to [-1, 1] once at load
+			const Vector3 normal{ pNormal->SampleNormal(getCenter(i)) };
+			EXPECT_NEAR(normal.x, getChannel(texels[i], 0) * 2.f - 1.f, 1e-6f);
+			EXPECT_NEAR(normal.y, getChannel(texels[i], 1) * 2.f - 1.f, 1e-6f);
+			EXPECT_NEAR(normal.z, getChannel(texels[i], 2) * 2.f - 1.f, 1e-6f);
+		}
+
+		//4, 1 and 12 bytes per texel over 4x2, 2x1 and 1x1
+		const size_t texelCount{ 8 + 2 + 1 };
+		EXPECT_EQ(pColor->GetMemorySize(), texelCount * 4);
+		EXPECT_EQ(pSingle->GetMemorySize(), texelCount * 1);
+		EXPECT_EQ(pNormal->GetMemorySize(), texelCount * sizeof(Vector3));
+		EXPECT_EQ(pColor->GetFormat(), TextureFormat::RGBA8);
+		EXPECT_FALSE(pNormal->IsBlockCompressed());
+
+		delete pNormal;
+		delete pSingle;
+		delete pColor;
+	}
+
+	TEST(Texture, BoxFiltersMipChainAndSelectsLod) {
+		//8x4 checkerboard off black and white, every 2x2 footprint averages to 128
+		const int width{ 8 }, height{ 4 };
+		std::vector<uint32_t> texels(width * height);
+		for (int i{}; i < width * height; ++i)
+			texels[i] = ((i % width + i / width) % 2) ? 0xFFFFFFFFu : 0xFF000000u;
+		Texture* pTexture{ Texture::CreateFromPixels(width, height, texels.data()) };
+
+		//8x4, 4x2, 2x1, 1x1
+		ASSERT_EQ(pTexture->GetLevelCount(), 4);
+		const float grey{ 128 / 255.f };
+		for (float lod : { 1.f, 2.f, 3.f })
+			EXPECT_FLOAT_EQ(pTexture->SampleNearestMip({ 0.3f, 0.6f }, lod).r, grey);
+		EXPECT_FLOAT_EQ(pTexture->SampleNearestMip({ 1.5f / width, 0.5f / height }, 0.4f).r, 1.f);
+
+		//Trilinear blends the white texel with the grey level above it
+		EXPECT_NEAR(pTexture->SampleTrilinear({ 1.5f / width, 0.5f / height }, 0.25f).r, 0.75f + 0.25f * grey, 1e-5f);
+
+		//One texel per pixel is level 0, 4 texels per pixel along the longest axis is level 2, the level count caps it
+		EXPECT_FLOAT_EQ(pTexture->CalculateLod({ 1.f / width, 0.f }, { 0.f, 1.f / height }), 0.f);
+		EXPECT_FLOAT_EQ(pTexture->CalculateLod({ 0.25f / width, 0.f }, { 0.f, 0.25f / height }), 0.f);
+		EXPECT_FLOAT_EQ(pTexture->CalculateLod({ 4.f / width, 0.f }, { 0.f, 1.f / height }), 2.f);
+		EXPECT_FLOAT_EQ(pTexture->CalculateLod({ 0.f, 2.f / height }, { 1.f / width, 0.f }), 1.f);
+		EXPECT_FLOAT_EQ(pTexture->CalculateLod({ 64.f / width, 0.f }, { 0.f, 64.f / height }), 3.f);
+		delete pTexture;
+
+		//Odd sizes round down and repeat their last row: 3x1 has a 1x1 level averaging its first 2 texels
+		const std::vector<uint32_t> row{ 0xFF000000u, 0xFF0000C8u, 0xFF0000FFu };
+		pTexture = Texture::CreateFromPixels(3, 1, row.data());
+		ASSERT_EQ(pTexture->GetLevelCount(), 2);
+		EXPECT_FLOAT_EQ(pTexture->SampleNearestMip({ 0.5f, 0.5f }, 1.f).r, 100 / 255.f);
+		delete pTexture;
+	}
+
+	TEST(Texture, BilinearBatchMatchesScalarFixedPoint) {
+		//A single uv always takes the scalar fixed point path, longer batches go through the gathers when the CPU has AVX2
+		std::mt19937 random{ 35 };
+		std::uniform_real_distribution<float> uvDistribution{ -1.5f, 2.5f };
+		for (const auto [width, height] : { std::pair{ 16, 16 }, std::pair{ 12, 6 } })
+		{
+			std::vector<uint32_t> texels(width * height);
+			for (uint32_t& texel : texels)
+				texel = random() | 0xFF000000u;
+
+			std::vector<Vector2> uvs(13);
+			for (Vector2& uv : uvs)
+				uv = { uvDistribution(random), uvDistribution(random) };
+
+			for (const TextureAddressMode addressMode : { TextureAddressMode::Clamp, TextureAddressMode::Wrap })
+			{
+				Texture* pLinear{ Texture::CreateFromPixels(width, height, texels.data()) };
+				std::vector<ColorRGB> expected(uvs.size());
+				for (size_t i{}; i < uvs.size(); ++i)
+					pLinear->SampleBilinearBatch(&uvs[i], &expected[i], 1, 0.f, addressMode);
+				delete pLinear;
+
+				for (const TextureLayout layout : { TextureLayout::Linear, TextureLayout::Tiled4x4, TextureLayout::Morton })
+				{
+					Texture* pTexture{ Texture::CreateFromPixels(width, height, texels.data()) };
+					pTexture->SetLayout(layout);
+					for (const int count : { 1, 7, 8, 13 })
+					{
+						std::vector<ColorRGB> colors(count);
+						pTexture->SampleBilinearBatch(uvs.data(), colors.data(), count, 0.f, addressMode);
+						for (int i{}; i < count; ++i)
+						{
+							EXPECT_EQ(colors[i].r, expected[i].r) << width << "x" << height << " layout " << int(layout) << " count " << count << " uv " << i;
+							EXPECT_EQ(colors[i].g, expected[i].g) << width << "x" << height << " layout " << int(layout) << " count " << count << " uv " << i;
+							EXPECT_EQ(colors[i].b, expected[i].b) << width << "x" << height << " layout " << int(layout) << " count " << count << " uv " << i;
+						}
+					}
+					delete pTexture;
+				}
+			}
+		}
+	}
+
+	TEST(ThreadPool, SubmitReturnsResultsAndExceptionsThroughFutures) {
+		std::vector<std::future<int>> squares{};
+		std::atomic<int> jobsRun{};
+		{
+			ThreadPool threadPool{ 3 };
+			EXPECT_EQ(threadPool.GetThreadCount(), 3);
+			for (int i{}; i < 64; ++i)
+				squares.push_back(threadPool.Submit([i, &jobsRun]() { ++jobsRun; return i * i; }));
+			for (int i{}; i < 64; ++i)
+				EXPECT_EQ(squares[i].get(), i * i);
+
+			//Move only captures work, std::function only ever sees the shared task
+			std::future<int> moved{ threadPool.Submit([pValue = std::make_unique<int>(7)]() { return *pValue; }) };
+			EXPECT_EQ(moved.get(), 7);
+
+			std::future<void> failing{ threadPool.Submit([]() { throw std::runtime_error{ "job failed" }; }) };
+			EXPECT_THROW(failing.get(), std::runtime_error);
+
+			//Jobs still queued when the pool is destroyed run before the workers are joined
+			for (int i{}; i < 16; ++i)
+				threadPool.Submit([&jobsRun]() { std::this_thread::sleep_for(std::chrono::milliseconds{ 1 }); ++jobsRun; });
+		}
+		EXPECT_EQ(jobsRun, 80);
+	}
+
+	TEST(AssetManager, SharesOneTexturePerPathAndFormat) {
+		//Red and white above blue and green
+		const std::string path{ "AssetManager_test.bmp" };
+		const uint32_t texels[4]{ 0x0000FF, 0xFFFFFF, 0xFF0000, 0x00FF00 };
+		WriteBmp(path, 2, 2, [&texels](int x, int y) { return texels[x + y * 2]; });
+
+		AssetManager& assetManager{ AssetManager::GetInstance() };
+		{
+			//Two loads racing for the same path end up with one texture
+			std::shared_ptr<Texture> pFirst{}, pSecond{};
+			std::thread first{ [&]() { pFirst = assetManager.GetTexture(path); } };
+			std::thread second{ [&]() { pSecond = assetManager.GetTexture(path); } };
+			first.join();
+			second.join();
+			ASSERT_NE(pFirst, nullptr);
+			EXPECT_EQ(pFirst, pSecond);
+			EXPECT_EQ(pFirst->GetWidth(), 2);
+			EXPECT_EQ(pFirst->Sample({ 0.25f, 0.25f }).r, 1.f);
+			EXPECT_EQ(pFirst->Sample({ 0.25f, 0.75f }).b, 1.f);
+
+			//Requests while the texture is resident and while it is loading share it too
+			EXPECT_EQ(assetManager.GetTexture(path), pFirst);
+			EXPECT_EQ(assetManager.GetTextureAsync(path).get(), pFirst);
+			TextureHandle handle{ path };
+			EXPECT_EQ(handle.Get(), pFirst.get());
+
+			//Another format is another texture
+			const std::shared_ptr<Texture> pGloss{ assetManager.GetTexture(path, TextureFormat::R8) };
+			ASSERT_NE(pGloss, nullptr);
+			EXPECT_NE(pGloss, pFirst);
+			EXPECT_EQ(pGloss->GetFormat(), TextureFormat::R8);
+		}
+
+		//The cache does not keep a texture alive once its owners are gone
+		//The worker drops its copy off the result right after the future is ready
+		std::weak_ptr<Texture> pReleased{ assetManager.GetTexture(path) };
+		const auto releaseStart{ std::chrono::steady_clock::now() };
+		while (!pReleased.expired() && std::chrono::steady_clock::now() - releaseStart < std::chrono::seconds{ 1 })
+			std::this_thread::yield();
+		EXPECT_TRUE(pReleased.expired());
+		EXPECT_NE(assetManager.GetTexture(path), nullptr);
+
+		EXPECT_EQ(assetManager.GetTexture("AssetManager_missing.bmp"), nullptr);
+		std::remove(path.c_str());
+	}
+
+	TEST(TextureStreamer, StreamsRequestedLevelsWithinBudget) {
+		//1 texel checkerboards, the finest level is black and white and every coarser one gray
+		//Levels up to 128x128 stay resident, the 512 texture streams 2 levels off 128 KB and 32 KB, the 256 texture 1 off 32 KB
+		const std::string largePath{ "TextureStreamer_large.bmp" }, smallPath{ "TextureStreamer_small.bmp" };
+		const auto checker = [](int x, int y) { return (x + y) % 2 == 0 ? 0xFFFFFFu : 0u; };
+		WriteBmp(largePath, 512, 512, checker);
+		WriteBmp(smallPath, 256, 256, checker);
+		{
+			const std::shared_ptr<Texture> pLarge{ Texture::LoadStreamed(largePath, TextureFormat::BC1) };
+			const std::shared_ptr<Texture> pSmall{ Texture::LoadStreamed(smallPath, TextureFormat::BC1) };
+			ASSERT_NE(pLarge, nullptr);
+			ASSERT_NE(pSmall, nullptr);
+			ASSERT_TRUE(pLarge->IsStreamed());
+			EXPECT_EQ(pLarge->GetResidentLevel(), 2);
+			EXPECT_EQ(pSmall->GetResidentLevel(), 1);
+
+			//Asking for a level that is not resident samples the finest one that is
+			const Vector2 uv{ 0.5f / 512, 0.5f / 512 };
+			EXPECT_NEAR(pLarge->SampleNearestMip(uv, 0.f).r, 0.5f, 0.05f);
+			EXPECT_EQ(pLarge->SampleNearestMip(uv, 0.f).r, pLarge->SampleNearestMip(uv, 2.f).r);
+
+			ThreadPool threadPool{ 2 };
+			TextureStreamer streamer{ threadPool, 160 * 1024 };
+			streamer.Register(pLarge);
+			streamer.Register(pSmall);
+			//The checks sample too, a frame that is not rendered drops their requests
+			streamer.Update(false);
+			//Frames sample the textures at their lod, a negative lod leaves it unused, until all reads are committed
+			const auto renderFrames = [&](float largeLod, float smallLod)
+				{
+					for (int frame{}; frame < 1000; ++frame)
+					{
+						if (largeLod >= 0.f)
+							pLarge->SampleNearestMip(uv, largeLod);
+						if (smallLod >= 0.f)
+							pSmall->SampleNearestMip(uv, smallLod);
+						if (!streamer.Update(true) && streamer.GetPendingCount() == 0)
+							return;
+						std::this_thread::sleep_for(std::chrono::milliseconds{ 1 });
+					}
+				};
+
+			renderFrames(1.f, 0.f);
+			EXPECT_EQ(pLarge->GetResidentLevel(), 1);
+			EXPECT_EQ(pSmall->GetResidentLevel(), 0);
+			EXPECT_EQ(streamer.GetStreamedSize(), size_t(64 * 1024));
+			EXPECT_EQ(pSmall->SampleNearestMip(uv, 0.f).r, 1.f);
+			streamer.Update(false);
+
+			//The finest large level only fits once the unused small level is evicted
+			renderFrames(0.f, -1.f);
+			EXPECT_EQ(pLarge->GetResidentLevel(), 0);
+			EXPECT_EQ(pSmall->GetResidentLevel(), 1);
+			EXPECT_EQ(streamer.GetStreamedSize(), size_t(160 * 1024));
+			EXPECT_EQ(pLarge->SampleNearestMip(uv, 0.f).r, 1.f);
+			EXPECT_EQ(pLarge->SampleNearestMip({ 1.5f / 512, 0.5f / 512 }, 0.f).r, 0.f);
+			EXPECT_NEAR(pSmall->SampleNearestMip(uv, 0.f).r, 0.5f, 0.05f);
+		}
+		for (const std::string& path : { largePath, smallPath })
+		{
+			std::remove(path.c_str());
+			std::remove((path + ".bc1").c_str());
+		}
+	}
+
+	TEST(Material, BatchMatchesSinglePixelBilinear) {
+		const int size{ 16 };
+		std::mt19937 random{ 34 };
+		std::vector<uint32_t> texels(size * size);
+		for (uint32_t& texel : texels)
+			texel = random() | 0xFF000000u;
+		Texture* pColor{ Texture::CreateFromPixels(size, size, texels.data()) };
+		Texture* pGloss{ Texture::CreateFromPixels(size, size, texels.data(), TextureFormat::R8) };
+		Texture* pNormal{ Texture::CreateFromPixels(size, size, texels.data(), TextureFormat::Normal) };
+		Material* pMaterial{ Material::CreateFromTextures(pColor, pColor, pGloss, pNormal) };
+		ASSERT_NE(pMaterial, nullptr);
+
+		const int count{ 7 };
+		std::uniform_real_distribution<float> uvDistribution{ -0.1f, 1.1f };
+		Vector2 uvs[count]{};
+		for (Vector2& uv : uvs)
+			uv = { uvDistribution(random), uvDistribution(random) };
+		for (const float lod : { 0.f, 1.f, 2.f })
+		{
+			MaterialSample samples[count]{};
+			pMaterial->SampleBilinearBatch(uvs, samples, count, lod);
+			for (int i{}; i < count; ++i)
+			{
+				const MaterialSample expected{ pMaterial->SampleTrilinear(uvs[i], lod) };
+				EXPECT_EQ(samples[i].diffuse.r, expected.diffuse.r);
+				EXPECT_EQ(samples[i].specular.b, expected.specular.b);
+				EXPECT_EQ(samples[i].gloss, expected.gloss);
+				EXPECT_EQ(samples[i].normal, expected.normal);
+			}
+		}
+
+		delete pMaterial;
+		delete pNormal;
+		delete pGloss;
+		delete pColor;
+	}
+
+	TEST(NormalMapBaker, MatchesTangentFrameRotation) {
+		//Tangent space map tilted towards the tangent, on a quad facing +y with its tangent along +x
+		const int size{ 16 };
+		const std::vector<uint32_t> texels(size * size, 0xFF000000u | (230u << 16) | (128u << 8) | 204u);
+		Texture* pTangentSpaceMap{ Texture::CreateFromPixels(size, size, texels.data(), TextureFormat::Normal) };
+
+		Mesh quad{};
+		quad.primitiveTopology = PrimitiveTopology::TriangleList;
+		quad.vertices = { { { 0.f, 0.f, 0.f } }, { { 1.f, 0.f, 0.f } }, { { 1.f, 0.f, 1.f } }, { { 0.f, 0.f, 1.f } } };
+		for (Vertex& vertex : quad.vertices)
+		{
+			vertex.normal  = { 0.f, 1.f, 0.f };
+			vertex.tangent = { 1.f, 0.f, 0.f };
+			vertex.uv      = { vertex.position.x, vertex.position.z };
+		}
+		quad.indices = { 0, 1, 2, 0, 2, 3 };
+
+		NormalMapBaker::Report report{};
+		Texture* pObjectSpaceMap{ NormalMapBaker::BakeObjectSpace(*pTangentSpaceMap, quad, &report) };
+		ASSERT_NE(pObjectSpaceMap, nullptr);
+		//Texels on the shared diagonal are not an overlap
+		EXPECT_EQ(report.coveredTexels, size_t(size * size));
+		EXPECT_EQ(report.overlappingTexels, size_t(0));
+		const Vector3 tangentSpace{ pTangentSpaceMap->SampleNormal({ 0.5f, 0.5f }) };
+		const Vector3 expected{ Vector3{ 1.f, 0.f, 0.f } * tangentSpace.x + Vector3{ 0.f, 0.f, -1.f } * tangentSpace.y + Vector3{ 0.f, 1.f, 0.f } * tangentSpace.z };
+		const Vector3 baked{ NormalMapBaker::DecodeNormal(pObjectSpaceMap->Sample({ 0.5f, 0.5f })) };
+		EXPECT_NEAR(baked.x, expected.x, 0.01f);
+		EXPECT_NEAR(baked.y, expected.y, 0.01f);
+		EXPECT_NEAR(baked.z, expected.z, 0.01f);
+
+		delete pObjectSpaceMap;
+		delete pTangentSpaceMap;
+	}
+
+	TEST(NormalMapBaker, ReportsOverlappingUvs) {
+		//Two mirrored triangles facing +y and -y, mapped onto overlapping halves off the uv square
+		const int size{ 16 };
+		const std::vector<uint32_t> texels(size * size, 0xFF000000u | (255u << 16) | (128u << 8) | 128u);
+		Texture* pTangentSpaceMap{ Texture::CreateFromPixels(size, size, texels.data(), TextureFormat::Normal) };
+
+		Mesh mirrored{};
+		mirrored.primitiveTopology = PrimitiveTopology::TriangleList;
+		mirrored.vertices = { { { 0.f, 0.f, 0.f } }, { { 1.f, 0.f, 0.f } }, { { 0.f, 0.f, 1.f } }, { { 0.f, 0.f, 0.f } }, { { 1.f, 0.f, 0.f } }, { { 1.f, 0.f, 1.f } } };
+		for (int i{}; i < 6; ++i)
+		{
+			Vertex& vertex{ mirrored.vertices[i] };
+			vertex.normal  = { 0.f, i < 3 ? 1.f : -1.f, 0.f };
+			vertex.tangent = { 1.f, 0.f, 0.f };
+			vertex.uv      = { vertex.position.x, vertex.position.z };
+		}
+		mirrored.indices = { 0, 1, 2, 3, 5, 4 };
+
+		//The triangles overlap in the uv triangle between (0, 0), (0.5, 0.5) and (1, 0), a quarter off the square
+		NormalMapBaker::Report report{};
+		Texture* pObjectSpaceMap{ NormalMapBaker::BakeObjectSpace(*pTangentSpaceMap, mirrored, &report) };
+		ASSERT_NE(pObjectSpaceMap, nullptr);
+		EXPECT_EQ(report.coveredTexels, size_t(size * size * 3 / 4 + size / 2));
+		EXPECT_GT(report.overlappingTexels, size_t(size * size / 4 - size));
+		EXPECT_LE(report.overlappingTexels, size_t(size * size / 4));
+
+		delete pObjectSpaceMap;
+		delete pTangentSpaceMap;
+	}
+
+	TEST(TextureSpaceCache, ShadesVisibleTexelsOnceUntilInvalidated) {
+		//Triangle over the lower left half off the uv square, the other half is never shaded
+		Mesh triangle{};
+		triangle.primitiveTopology = PrimitiveTopology::TriangleList;
+		triangle.vertices = { { { 0.f, 0.f, 0.f } }, { { 1.f, 0.f, 0.f } }, { { 0.f, 0.f, 1.f } } };
+		for (Vertex& vertex : triangle.vertices)
+		{
+			vertex.normal  = { 0.f, 1.f, 0.f };
+			vertex.tangent = { 1.f, 0.f, 0.f };
+			vertex.uv      = { vertex.position.x, vertex.position.z };
+		}
+		triangle.indices = { 0, 1, 2 };
+
+		const int size{ 32 };
+		TextureSpaceCache cache{ triangle, size, size };
+		EXPECT_GT(cache.GetCoveredTexelCount(), size_t(size * size / 2));
+		EXPECT_LT(cache.GetCoveredTexelCount(), size_t(size * size));
+
+		//The surface position is the lighting, so a cached sample is the interpolated position
+		int shadeCalls{};
+		const auto shadePosition = [&](const Vertex& surface) { ++shadeCalls; return ColorRGB{ surface.position.x, surface.position.y, surface.position.z }; };
+		const ColorRGB color{ cache.Sample({ 0.25f, 0.25f }, shadePosition) };
+		EXPECT_NEAR(color.r, 0.25f, 0.01f);
+		EXPECT_NEAR(color.g, 0.f, 0.01f);
+		EXPECT_NEAR(color.b, 0.25f, 0.01f);
+		EXPECT_EQ(shadeCalls, 4);
+
+		cache.Sample({ 0.25f, 0.25f }, shadePosition);
+		EXPECT_EQ(shadeCalls, 4);
+		cache.Sample({ 0.9f, 0.9f }, shadePosition);
+		EXPECT_EQ(shadeCalls, 4);
+
+		cache.Invalidate();
+		cache.Sample({ 0.25f, 0.25f }, shadePosition);
+		EXPECT_EQ(shadeCalls, 8);
+		EXPECT_EQ(cache.GetShadedTexelCount(), size_t(8));
+	}
+
+	TEST(TextureSpaceCache, CountsTexelsSharedByOverlappingUvs) {
+		//A quad split along its diagonal shares no texel, a mirrored copy off one off its triangles shares half the square
+		Mesh quad{};
+		quad.primitiveTopology = PrimitiveTopology::TriangleList;
+		quad.vertices = { { { 0.f, 0.f, 0.f } }, { { 1.f, 0.f, 0.f } }, { { 1.f, 0.f, 1.f } }, { { 0.f, 0.f, 1.f } } };
+		for (Vertex& vertex : quad.vertices)
+			vertex.uv = { vertex.position.x, vertex.position.z };
+		quad.indices = { 0, 1, 2, 0, 2, 3 };
+
+		const int size{ 32 };
+		const TextureSpaceCache separate{ quad, size, size };
+		EXPECT_EQ(separate.GetCoveredTexelCount(), size_t(size * size));
+		EXPECT_EQ(separate.GetOverlappingTexelCount(), size_t(0));
+
+		Mesh mirrored{ quad };
+		mirrored.indices.insert(mirrored.indices.end(), { 2, 1, 0 });
+		const TextureSpaceCache overlapping{ mirrored, size, size };
+		EXPECT_GT(overlapping.GetOverlappingTexelCount(), size_t(size * size / 2 - size));
+		EXPECT_LE(overlapping.GetOverlappingTexelCount(), size_t(size * size / 2));
+	}
+
+	TEST(ObjParser, FlipsAxisAndWindingPerCorner) {
+		const std::string obj{ "# quad half\nv 0 0 1\nv 1 0 1\r\nv 0 1 1\nvt 0 0\nvt 1 0\nvt 0 1\nvn 0 0 -1\nf 1/1/1 2/2/1 3/3/1\n" };
+		std::vector<Vertex> vertices{};
+		std::vector<uint32_t> indices{};
+		ASSERT_TRUE(ObjParser::Parse(obj.data(), obj.size(), vertices, indices));
+		ASSERT_EQ(vertices.size(), size_t(3));
+		EXPECT_EQ(indices, (std::vector<uint32_t>{ 0, 2, 1 }));
+		EXPECT_EQ(vertices[1].position, (Vector3{ 1.f, 0.f, -1.f }));
+		EXPECT_EQ(vertices[1].normal, (Vector3{ 0.f, 0.f, 1.f }));
+		EXPECT_NEAR(vertices[2].uv.y, 0.f, 1e-6f);
+		EXPECT_NEAR(vertices[0].tangent.x, 1.f, 1e-5f);
+
+		const std::string missingPosition{ "v 0 0 0\nf 1 2 3\n" };
+		EXPECT_FALSE(ObjParser::Parse(missingPosition.data(), missingPosition.size(), vertices, indices));
+	}
+
+	TEST(MeshPack, MapsWrittenMeshesBack) {
+		const std::string packPath{ "MeshPack_test.pack" };
+		Mesh quad{};
+		quad.primitiveTopology = PrimitiveTopology::TriangleStrip;
+		quad.vertices  = { { { 0.f, 0.f, 0.f } }, { { 1.f, 0.f, 0.f } }, { { 0.f, 1.f, 0.f } }, { { 1.f, 1.f, 0.f } } };
+		quad.vertices[3].tangent = { 1.f, 0.f, 0.f };
+		quad.indices   = { 0, 1, 2, 3 };
+		quad.maxBounds = { 1.f, 1.f, 0.f };
+		Mesh triangle{ quad };
+		triangle.primitiveTopology = PrimitiveTopology::TriangleList;
+		triangle.indices.pop_back();
+		ASSERT_TRUE(MeshPack::Write(packPath, { quad, triangle }));
+
+		{
+			const MeshPack pack{ packPath };
+			ASSERT_TRUE(pack.IsLoaded());
+			ASSERT_EQ(pack.GetMeshCount(), size_t(2));
+			EXPECT_EQ(pack.GetIndices(1).size(), size_t(3));
+			const Mesh loaded{ pack.GetMesh(0) };
+			EXPECT_EQ(loaded.primitiveTopology, PrimitiveTopology::TriangleStrip);
+			EXPECT_EQ(loaded.indices, quad.indices);
+			ASSERT_EQ(loaded.vertices.size(), quad.vertices.size());
+			EXPECT_EQ(loaded.vertices[3].position, quad.vertices[3].position);
+			EXPECT_EQ(loaded.vertices[3].tangent, quad.vertices[3].tangent);
+			EXPECT_EQ(loaded.maxBounds, quad.maxBounds);
+		}
+
+		//A truncated pack is rejected instead of read past its end
+		std::filesystem::resize_file(packPath, std::filesystem::file_size(packPath) - 4);
+		EXPECT_FALSE(MeshPack{ packPath }.IsLoaded());
+		std::remove(packPath.c_str());
+	}
+
+	TEST(MeshOptimizer, WeldsAndReordersShuffledGrid) {
+		//OBJ style grid, one vertex per corner and the triangles in random order
+		constexpr int quads{ 16 };
+		Mesh grid{};
+		grid.primitiveTopology = PrimitiveTopology::TriangleList;
+		std::vector<std::array<Vector3, 3>> triangles{};
+		for (int y{}; y < quads; ++y)
+		{
+			for (int x{}; x < quads; ++x)
+			{
+				const Vector3 p0{ float(x), float(y), 0.f }, p1{ x + 1.f, float(y), 0.f }, p2{ float(x), y + 1.f, 0.f }, p3{ x + 1.f, y + 1.f, 0.f };
+				triangles.push_back({ p0, p1, p2 });
+				triangles.push_back({ p2, p1, p3 });
+			}
+		}
+		std::shuffle(triangles.begin(), triangles.end(), std::mt19937{ 7 });
+		for (const auto& triangle : triangles)
+		{
+			for (const Vector3& position : triangle)
+			{
+				grid.indices.push_back(uint32_t(grid.vertices.size()));
+				grid.vertices.push_back({ position, colors::White, {}, { 0.f, 0.f, -1.f }, { 1.f, 0.f, 0.f } });
+			}
+		}
+
+		//Every triangle is still there with its winding, identified by its center
+		const auto getCenters = [](const Mesh& mesh)
+			{
+				std::vector<std::pair<float, float>> centers{};
+				for (size_t i{}; i < mesh.indices.size(); i += 3)
+				{
+					const Vector3& p0{ mesh.vertices[mesh.indices[i]].position };
+					const Vector3& p1{ mesh.vertices[mesh.indices[i + 1]].position };
+					const Vector3& p2{ mesh.vertices[mesh.indices[i + 2]].position };
+					EXPECT_GT(Vector3::Cross(p1 - p0, p2 - p0).z, 0.f);
+					centers.emplace_back(p0.x + p1.x + p2.x, p0.y + p1.y + p2.y);
+				}
+				std::ranges::sort(centers);
+				return centers;
+			};
+		const auto centers{ getCenters(grid) };
+
+		MeshOptimizer::Report report{};
+		MeshOptimizer::Optimize(grid, &report);
+		EXPECT_EQ(report.vertexCountBefore, size_t(quads * quads * 6));
+		EXPECT_EQ(grid.vertices.size(), size_t((quads + 1) * (quads + 1)));
+		EXPECT_FLOAT_EQ(report.acmrBefore, 3.f);
+		EXPECT_LT(report.acmrAfter, 1.f);
+		EXPECT_EQ(getCenters(grid), centers);
+
+		//First use order
+		uint32_t nextVertex{};
+		for (const uint32_t index : grid.indices)
+		{
+			ASSERT_LE(index, nextVertex);
+			if (index == nextVertex)
+				++nextVertex;
+		}
+	}
 }